@@ -54,34 +54,61 @@ namespace BioFVM{
 
 std::vector<Basic_Agent*> all_basic_agents(0); 
 
+static int max_basic_agent_ID = 0; 
+
+int get_next_basic_agent_ID( void )
+{ return max_basic_agent_ID; }
+
+void set_next_basic_agent_ID( int ID )
+{
+	max_basic_agent_ID = ID; 
+	return; 
+}
+
 Basic_Agent::Basic_Agent()
+{
+	// link into the microenvironment, if one is defined 
+	secretion_rates= &own_secretion_rates;
+	uptake_rates= &own_uptake_rates;
+	saturation_densities= &own_saturation_densities;
+	// extern Microenvironment* default_microenvironment;
+	// register_microenvironment( default_microenvironment ); 
+
+	internalized_substrates = &own_internalized_substrates; // 
+	fraction_released_at_death = &own_fraction_released_at_death; 
+	fraction_transferred_when_ingested = &own_fraction_transferred_when_ingested; 
+
+	reset(); 
+	
+	// these are done in register_microenvironment
+	// internalized_substrates.assign( get_default_microenvironment()->number_of_densities() , 0.0 ); 
+	
+	return;	
+}
+
+void Basic_Agent::reset( void )
 {
 	//give the agent a unique ID  
-	static int max_basic_agent_ID = 0; 
-	ID = max_basic_agent_ID; // 
-	max_basic_agent_ID++; 
+	// agents may be created in parallel (batched cell division) 
+	#pragma omp atomic capture 
+	ID = max_basic_agent_ID++; 
 	// initialize position and velocity
 	is_active=true;
 	
 	volume = 1.0; 
+	volume_is_changed = true; 
 	
 	position.assign( 3 , 0.0 ); 
 	velocity.assign( 3 , 0.0 );
 	previous_velocity.assign( 3 , 0.0 ); 
-	// link into the microenvironment, if one is defined 
-	secretion_rates= new std::vector<double>(0);
-	uptake_rates= new std::vector<double>(0);
-	saturation_densities= new std::vector<double>(0);
-	// extern Microenvironment* default_microenvironment;
-	// register_microenvironment( default_microenvironment ); 
 
-	internalized_substrates = new std::vector<double>(0); // 
-	fraction_released_at_death = new std::vector<double>(0); 
-	fraction_transferred_when_ingested = new std::vector<double>(0); 
 	register_microenvironment( get_default_microenvironment() );
-	
-	// these are done in register_microenvironment
-	// internalized_substrates.assign( get_default_microenvironment()->number_of_densities() , 0.0 ); 
+
+	// register_microenvironment only resizes these; a reused agent 
+	// needs the values of a new one 
+	cell_source_sink_solver_temp1.assign( cell_source_sink_solver_temp1.size() , 0.0 ); 
+	cell_source_sink_solver_temp2.assign( cell_source_sink_solver_temp2.size() , 1.0 ); 
+	total_extracellular_substrate_change.assign( total_extracellular_substrate_change.size() , 1.0 ); 
 	
 	return;	
 }
@@ -159,6 +186,28 @@ void Basic_Agent::set_internal_uptake_constants( double dt )
 	return; 
 }
 
+void Basic_Agent::get_checkpoint_state( Vec3& previous_velocity_out , bool& is_active_out , bool& volume_is_changed_out , 
+	std::vector<double>& temp1 , std::vector<double>& temp2 )
+{
+	previous_velocity_out = previous_velocity; 
+	is_active_out = is_active; 
+	volume_is_changed_out = volume_is_changed; 
+	temp1 = cell_source_sink_solver_temp1; 
+	temp2 = cell_source_sink_solver_temp2; 
+	return; 
+}
+
+void Basic_Agent::set_checkpoint_state( Vec3& previous_velocity_in , bool is_active_in , bool volume_is_changed_in , 
+	std::vector<double>& temp1 , std::vector<double>& temp2 )
+{
+	previous_velocity = previous_velocity_in; 
+	is_active = is_active_in; 
+	volume_is_changed = volume_is_changed_in; 
+	cell_source_sink_solver_temp1 = temp1; 
+	cell_source_sink_solver_temp2 = temp2; 
+	return; 
+}
+
 void Basic_Agent::register_microenvironment( Microenvironment* microenvironment_in )
 {
 	microenvironment = microenvironment_in; 	
@@ -263,7 +312,7 @@ std::vector<double>& Basic_Agent::nearest_density_vector( void )
 
 
 // directly access the gradient of substrate n nearest to the cell 
-std::vector<double>& Basic_Agent::nearest_gradient( int substrate_index )
+gradient& Basic_Agent::nearest_gradient( int substrate_index )
 {
 	return microenvironment->gradient_vector(current_voxel_index)[substrate_index]; 
 }
@@ -316,4 +365,18 @@ void Basic_Agent::simulate_secretion_and_uptake( Microenvironment* pS, double dt
 	return; 
 }
 
+void Basic_Agent::add_source_sink_rates( double* sources , double* uptakes )
+{
+	if(!is_active)
+	{ return; }
+	
+	double volume_fraction = volume / ( (microenvironment->voxels(current_voxel_index)).volume ); 
+	for( unsigned int i=0; i < (*secretion_rates).size(); i++ )
+	{
+		sources[i] += volume_fraction * (*secretion_rates)[i] * (*saturation_densities)[i]; 
+		uptakes[i] += volume_fraction * ( (*secretion_rates)[i] + (*uptake_rates)[i] ); 
+	}
+	return; 
+}
+
 };
\ No newline at end of file
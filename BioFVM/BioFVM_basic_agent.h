@@ -71,11 +71,20 @@ class Basic_Agent
  protected:
 	std::vector<double> cell_source_sink_solver_temp1;
 	std::vector<double> cell_source_sink_solver_temp2;
-	std::vector<double> previous_velocity; 
+	Vec3 previous_velocity; 
 	bool is_active;
 	
 	std::vector<double> total_extracellular_substrate_change; 
 	
+	// what the rate pointers below start out pointing at (a Cell points 
+	// them at its phenotype's vectors instead), kept inline 
+	std::vector<double> own_secretion_rates; 
+	std::vector<double> own_saturation_densities; 
+	std::vector<double> own_uptake_rates; 
+	std::vector<double> own_internalized_substrates; 
+	std::vector<double> own_fraction_released_at_death; 
+	std::vector<double> own_fraction_transferred_when_ingested; 
+	
  public:
 	std::vector<double> * secretion_rates; 
 	std::vector<double> * saturation_densities; 
@@ -102,15 +111,19 @@ class Basic_Agent
 	bool assign_position(double x, double y, double z);
 	bool assign_position(std::vector<double> new_position);
 	
-	std::vector<double> position;  
-	std::vector<double> velocity; 
+	Vec3 position;  
+	Vec3 velocity; 
 	void update_position( double dt );
 	
 	Basic_Agent(); 
+	void reset( void ); // back to the state of a new agent (with a new ID), keeping the allocated storage 
 
 	// simulate secretion and uptake at the nearest voxel at the indicated microenvironment.
 	// if no microenvironment indicated, use the currently selected microenvironment. 
 	void simulate_secretion_and_uptake( Microenvironment* M, double dt ); 
+	// the same secretion and uptake as rates in the agent's voxel (for the quasi-steady solver): 
+	// adds (V_cell/V_voxel)*S*T to sources[] and (V_cell/V_voxel)*(S+U) to uptakes[] 
+	void add_source_sink_rates( double* sources , double* uptakes ); 
 
 	int get_current_voxel_index( void ); 
 	// directly access the substrate vector at the nearest voxel at the indicated microenvironment 
@@ -118,9 +131,15 @@ class Basic_Agent
 	std::vector<double>& nearest_density_vector( void );
 	
 	// directly access the gradient of substrate n nearest to the cell 
-	std::vector<double>& nearest_gradient( int substrate_index );
+	gradient& nearest_gradient( int substrate_index );
 	// directly access a vector of gradients, one gradient per substrate 
 	std::vector<gradient>& nearest_gradient_vector( void ); 
+	
+	// for checkpoints: the state that the public members do not expose 
+	void get_checkpoint_state( Vec3& previous_velocity_out , bool& is_active_out , bool& volume_is_changed_out , 
+		std::vector<double>& temp1 , std::vector<double>& temp2 ); 
+	void set_checkpoint_state( Vec3& previous_velocity_in , bool is_active_in , bool volume_is_changed_in , 
+		std::vector<double>& temp1 , std::vector<double>& temp2 ); 
 };
 
 extern std::vector<Basic_Agent*> all_basic_agents; 
@@ -130,6 +149,10 @@ void delete_basic_agent( int );
 void delete_basic_agent( Basic_Agent* ); 
 void save_all_basic_agents_to_matlab( std::string filename ); 
 
+// the ID of the next new agent (for checkpoints) 
+int get_next_basic_agent_ID( void ); 
+void set_next_basic_agent_ID( int ID ); 
+
 };
 
 #endif
@@ -878,6 +878,9 @@ void Cartesian_Mesh::resize_uniform( double x_start, double x_end, double y_star
 { return resize( x_start, x_end, y_start, y_end, z_start, z_end , dx_new, dx_new , dx_new ); }
 
 int Cartesian_Mesh::nearest_voxel_index( std::vector<double>& position )
+{ return nearest_voxel_index( Vec3( position ) ); }
+
+int Cartesian_Mesh::nearest_voxel_index( const Vec3& position )
 {
 	unsigned int i = (unsigned int) floor( (position[0]-bounding_box[0])/dx ); 
 	unsigned int j = (unsigned int) floor( (position[1]-bounding_box[1])/dy ); 
@@ -898,6 +901,9 @@ int Cartesian_Mesh::nearest_voxel_index( std::vector<double>& position )
 }
 
 std::vector<unsigned int> Cartesian_Mesh::nearest_cartesian_indices( std::vector<double>& position )
+{ return nearest_cartesian_indices( Vec3( position ) ); }
+
+std::vector<unsigned int> Cartesian_Mesh::nearest_cartesian_indices( const Vec3& position )
 {
 	std::vector<unsigned int> out; 
 	out.assign(3, 0 ); 
@@ -922,6 +928,9 @@ std::vector<unsigned int> Cartesian_Mesh::nearest_cartesian_indices( std::vector
 Voxel& Cartesian_Mesh::nearest_voxel( std::vector<double>& position )
 { return voxels[ nearest_voxel_index( position ) ]; }
 
+Voxel& Cartesian_Mesh::nearest_voxel( const Vec3& position )
+{ return voxels[ nearest_voxel_index( position ) ]; }
+
 void Cartesian_Mesh::display_information( std::ostream& os )
 {
 	os << std::endl << "Mesh information: " << std::endl;
@@ -53,6 +53,7 @@
 #include <vector> 
 
 #include "BioFVM_matlab.h"
+#include "BioFVM_vector.h"
 
 namespace BioFVM{
 
@@ -199,9 +200,12 @@ class Cartesian_Mesh : public General_Mesh
 	void resize_uniform( double x_start, double x_end, double y_start, double y_end, double z_start, double z_end , double dx ); 
 	
 	int nearest_voxel_index( std::vector<double>& position );   
+	int nearest_voxel_index( const Vec3& position );   
 	int nearest_voxel_face_index( std::vector<double>& position );  
 	std::vector<unsigned int> nearest_cartesian_indices( std::vector<double>& position ); 
+	std::vector<unsigned int> nearest_cartesian_indices( const Vec3& position ); 
 	Voxel& nearest_voxel( std::vector<double>& position ); 
+	Voxel& nearest_voxel( const Vec3& position ); 
 	
 	void display_information( std::ostream& os ); 
 	
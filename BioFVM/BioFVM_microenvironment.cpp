@@ -50,6 +50,7 @@
 #include "BioFVM_solvers.h"
 #include "BioFVM_vector.h"
 #include <cmath>
+#include <algorithm>
 
 #include "BioFVM_basic_agent.h"
 
@@ -93,6 +94,18 @@ void one_function( Microenvironment* pMicroenvironment, int voxel_index, std::ve
 	return; 
 }
 
+void standard_agent_source_sink_function( Basic_Agent* pAgent, Microenvironment* pMicroenvironment, double dt )
+{
+	pAgent->simulate_secretion_and_uptake( pMicroenvironment , dt ); 
+	return; 
+}
+
+void standard_agent_source_sink_rates_function( Basic_Agent* pAgent, Microenvironment* pMicroenvironment, double dt , double* sources , double* uptakes )
+{
+	pAgent->add_source_sink_rates( sources , uptakes ); 
+	return; 
+}
+
 void empty_diffusion_solver( Microenvironment& S, double dt )
 {
 	static bool setup_done = false; 
@@ -114,6 +127,9 @@ Microenvironment::Microenvironment()
 	bulk_source_sink_solver_setup_done = false; 
 	thomas_setup_done = false; 
 	diffusion_solver_setup_done = false; 
+	thomas_stride = 1; 
+	thomas_block_width = 1; 
+	dirichlet_blocks_out_of_date = true; 
 
 	diffusion_decay_solver = empty_diffusion_solver;
 	diffusion_decay_solver = diffusion_decay_solver__constant_coefficients_LOD_3D; 
@@ -133,11 +149,22 @@ Microenvironment::Microenvironment()
 		gradient_vectors[k].resize( 1 ); 
 		(gradient_vectors[k])[0].resize( 3, 0.0 );
 	}
-	gradient_vector_computed.resize( mesh.voxels.size() , false ); 
+	clear_gradient_cache(); 
 
 	bulk_supply_rate_function = zero_function; 
 	bulk_supply_target_densities_function = zero_function; 
 	bulk_uptake_rate_function = zero_function; 
+	agent_source_sink_function = standard_agent_source_sink_function; 
+	agent_source_sink_rates_function = standard_agent_source_sink_rates_function; 
+	solver_applied_cell_sources_and_sinks = false; 
+	quasi_steady_state_interval = 0.1; 
+	quasi_steady_state_tolerance = 1e-6; 
+	multigrid_elapsed_time = 0.0; 
+	amr_ratio = 0; 
+	amr_refinement_ratio = 4; 
+	amr_buffer_distance = 100.0; 
+	coefficient_fields_out_of_date = true; 
+	thomas_line_dt = 0.0; 
 
 	density_names.assign( 1 , "unnamed" ); 
 	density_units.assign( 1 , "none" ); 
@@ -151,14 +178,12 @@ Microenvironment::Microenvironment()
 	one_third = one; 
 	one_third /= 3.0;
 
-/*	
 	dirichlet_indices.clear();
-	dirichlet_value_vectors.clear();
-	
+	dirichlet_values.clear();
 	dirichlet_node_map.assign( mesh.voxels.size() , -1 ); 
-*/
-	dirichlet_value_vectors.assign( mesh.voxels.size(), one ); 
+	agent_counts_by_voxel.assign( mesh.voxels.size() , 0 ); 
 	dirichlet_activation_vector.assign( 1 , true ); 
+	gradient_activation_vector.assign( 1 , true ); 
 	
 	if(default_microenvironment==NULL)
 	{ default_microenvironment=this; }
@@ -177,50 +202,36 @@ Microenvironment::Microenvironment(std::string name)
 void Microenvironment::add_dirichlet_node( int voxel_index, std::vector<double>& value )
 {
 	mesh.voxels[voxel_index].is_Dirichlet=true;
-	/*
-	dirichlet_indices.push_back( voxel_index );
-	dirichlet_value_vectors.push_back( value ); 
-	*/
 	
-	dirichlet_value_vectors[voxel_index] = value; // .assign( mesh.voxels.size(), one ); 
+	int m = dirichlet_node_map[voxel_index]; 
+	if( m < 0 )
+	{
+		m = dirichlet_indices.size(); 
+		dirichlet_node_map[voxel_index] = m; 
+		dirichlet_indices.push_back( voxel_index ); 
+		dirichlet_values.resize( dirichlet_values.size() + number_of_densities() , 1.0 ); 
+		dirichlet_blocks_out_of_date = true; 
+	}
+	
+	for( unsigned int s=0; s < number_of_densities() && s < value.size(); s++ )
+	{ dirichlet_values[ m*number_of_densities() + s ] = value[s]; }
 	
 	return; 
 }
 
 void Microenvironment::update_dirichlet_node( int voxel_index , std::vector<double>& new_value )
 {
-/*
-	if( mesh.voxels[voxel_index].is_Dirichlet == false )
-	{ 
-		std::cout << "BioFVM Warning: No Dirichlet condition previously specified at voxel " << voxel_index << "! Creating a new one now ... " << std::endl; 
-		add_dirichlet_node( voxel_index , new_value ); 
-		return; 
-	}
-	
-	int n = 0; 
-	while( dirichlet_indices[n] != voxel_index && n < dirichlet_indices.size() )
-	{ n++; }
-		
-	if( n == dirichlet_indices.size() )
-	{ 
-		std::cout << "BioFVM Warning: No Dirichlet condition previously specified at voxel " << voxel_index << "! Creating a new one now ... " << std::endl; 
-		add_dirichlet_node( voxel_index , new_value ); 
-		return; 
-	}
-
-	dirichlet_value_vectors[n] = new_value; 
-	*/
-	
-	mesh.voxels[voxel_index].is_Dirichlet = true; 
-	dirichlet_value_vectors[voxel_index] = new_value; 
-	
+	add_dirichlet_node( voxel_index , new_value ); 
 	return; 
 }
 
 void Microenvironment::update_dirichlet_node( int voxel_index , int substrate_index , double new_value )
 {
-	mesh.voxels[voxel_index].is_Dirichlet = true; 
-	dirichlet_value_vectors[voxel_index][substrate_index] = new_value; 
+	// a new node starts with all its values at 1 
+	if( dirichlet_node_map[voxel_index] < 0 )
+	{ add_dirichlet_node( voxel_index , one ); }
+	
+	dirichlet_values[ dirichlet_node_map[voxel_index]*number_of_densities() + substrate_index ] = new_value; 
 	return; 
 }
 
@@ -228,37 +239,29 @@ void Microenvironment::remove_dirichlet_node( int voxel_index )
 {
 	mesh.voxels[voxel_index].is_Dirichlet = false; 
 	
-/*	
-	if( mesh.voxels[voxel_index].is_Dirichlet == false )
-	{ 
-		std::cout << "BioFVM Warning: No Dirichlet condition previously specified at voxel " << voxel_index << "! Nothing to remove!" << std::endl; 
-		return; 
-	}	
+	int m = dirichlet_node_map[voxel_index]; 
+	if( m < 0 )
+	{ return; }
 	
-	int n = 0; 
-	mesh.voxels[voxel_index].is_Dirichlet=false;
-	while( dirichlet_indices[n] != voxel_index && n < dirichlet_indices.size() )
-	{  n++; }
+	// move the final node into its place 
+	int last = dirichlet_indices.size()-1; 
+	int n = number_of_densities(); 
+	dirichlet_indices[m] = dirichlet_indices[last]; 
+	dirichlet_node_map[ dirichlet_indices[m] ] = m; 
+	for( int s=0; s < n; s++ )
+	{ dirichlet_values[ m*n + s ] = dirichlet_values[ last*n + s ]; }
 	
-	if( n == dirichlet_indices.size() )
-	{ 
-		std::cout << "BioFVM Warning: No Dirichlet condition previously specified at voxel " << voxel_index << "! Nothing to remove!" << std::endl; 
-		return; 
-	}
-	
-	// swap with the final node and then remove it 	
-	dirichlet_indices[n] = dirichlet_indices[ dirichlet_indices.size()-1 ]; 
-	dirichlet_value_vectors[n] = dirichlet_value_vectors[ dirichlet_value_vectors.size()-1 ]; 
 	dirichlet_indices.pop_back();
-	dirichlet_value_vectors.pop_back();
-*/
+	dirichlet_values.resize( last*n ); 
+	dirichlet_node_map[voxel_index] = -1; 
+	dirichlet_blocks_out_of_date = true; 
 	
 	return; 
 }
 
-bool& Microenvironment::is_dirichlet_node( int voxel_index )
+bool Microenvironment::is_dirichlet_node( int voxel_index )
 {
-	return mesh.voxels[voxel_index].is_Dirichlet; 
+	return dirichlet_node_map[voxel_index] >= 0; 
 }
 
 void Microenvironment::set_substrate_dirichlet_activation( int substrate_index , bool new_value )
@@ -272,31 +275,411 @@ double Microenvironment::get_substrate_dirichlet_activation( int substrate_index
 	return dirichlet_activation_vector[substrate_index]; 
 }
 
+void Microenvironment::set_substrate_gradient_activation( int substrate_index , bool new_value )
+{
+	if( gradient_activation_vector[substrate_index] == new_value )
+	{ return; }
+	gradient_activation_vector[substrate_index] = new_value; 
+	
+	// inactive substrates report a zero gradient 
+	for( unsigned int n=0; n < gradient_vectors.size() ; n++ )
+	{ gradient_vectors[n][substrate_index] = gradient(); }
+	invalidate_gradient_vectors(); 
+	return; 
+}
+
+bool Microenvironment::get_substrate_gradient_activation( int substrate_index )
+{
+	return gradient_activation_vector[substrate_index]; 
+}
+
 void Microenvironment::apply_dirichlet_conditions( void )
 {
-	/*
+	int n = number_of_densities(); 
 	#pragma omp parallel for 
-	for( unsigned int i=0 ; i < dirichlet_indices.size() ; i++ )
-	{ density_vector( dirichlet_indices[i] ) = dirichlet_value_vectors[i]; }
-	*/
+	for( unsigned int m=0 ; m < dirichlet_indices.size() ; m++ )
+	{
+		std::vector<double>& density = density_vector( dirichlet_indices[m] ); 
+		for( int s=0; s < n; s++ )
+		{
+			if( dirichlet_activation_vector[s] == true )
+			{ density[s] = dirichlet_values[ m*n + s ]; }
+		}
+	}
+	return; 
+}
 
-	#pragma omp parallel for 
-	for( unsigned int i=0 ; i < mesh.voxels.size() ;i++ )
+// repeat each solved substrate's coefficient across the lanes of a block 
+static void fill_block_coefficients( aligned_vector& block , std::vector< std::vector<double> >& coefficients , 
+	std::vector<int>& substrates , int stride , int block_width , double padding_value )
+{
+	block.assign( coefficients.size() * block_width , padding_value ); 
+	for( unsigned int i=0; i < coefficients.size(); i++ )
+	{
+		for( int lane=0; lane < block_width; lane++ )
+		{
+			int s = lane % stride; 
+			if( s < (int) substrates.size() )
+			{ block[ i*block_width + lane ] = coefficients[i][ substrates[s] ]; }
+		}
+	}
+	return; 
+}
+
+bool Microenvironment::substrate_is_inert( int substrate_index )
+{
+	// with coefficient fields, the substrate must be inert in every voxel
+	if( diffusion_coefficient_field.size() == number_of_voxels() && decay_rate_field.size() == number_of_voxels() &&
+		number_of_voxels() > 0 && diffusion_coefficient_field[0].size() == number_of_densities() )
+	{
+		for( unsigned int n=0; n < number_of_voxels(); n++ )
+		{
+			if( diffusion_coefficient_field[n][substrate_index] != 0.0 || decay_rate_field[n][substrate_index] != 0.0 )
+			{ return false; }
+		}
+		return true; 
+	}
+	return diffusion_coefficients[substrate_index] == 0.0 && decay_rates[substrate_index] == 0.0; 
+}
+
+void Microenvironment::setup_solver_buffer( void )
+{
+	// Inert substrates (no diffusion, no decay) are left out of the solve: 
+	// their LOD systems are the identity, and only Dirichlet nodes change them. 
+	solver_substrates.clear(); 
+	inert_substrates.clear(); 
+	for( unsigned int s=0; s < number_of_densities(); s++ )
+	{
+		if( substrate_is_inert( s ) )
+		{
+			inert_substrates.push_back( s ); 
+			std::cout << "Skipping diffusion and decay for inert substrate " << density_names[s] 
+				<< " (diffusion coefficient and decay rate are 0)" << std::endl; 
+		}
+		else
+		{ solver_substrates.push_back( s ); }
+	}
+	if( solver_substrates.size() == 0 )
+	{ std::cout << "All substrates are inert: the diffusion solver only applies Dirichlet conditions" << std::endl << std::endl; }
+
+	// one or two substrates are not padded; more are padded to whole 4-wide lanes 
+	int number_of_substrates = solver_substrates.size(); 
+	thomas_stride = number_of_substrates; 
+	if( thomas_stride < 1 )
+	{ thomas_stride = 1; }
+	if( number_of_substrates > 2 )
+	{ thomas_stride = 4*( (number_of_substrates+3)/4 ); }
+
+	// about 32 doubles (four cache lines) per block of lines 
+	int lines_per_block = 32 / thomas_stride; 
+	if( lines_per_block < 1 )
+	{ lines_per_block = 1; }
+	thomas_block_width = lines_per_block * thomas_stride; 
+
+	thomas_densities.assign( mesh.voxels.size() * thomas_stride , 0.0 ); 
+
+	// (empty for the variable-coefficient solvers, which have their own tables)
+	std::vector< std::vector<double> > constant1; 
+	if( thomas_constant1.size() > 0 )
+	{ constant1.assign( 1 , thomas_constant1 ); }
+	fill_block_coefficients( thomas_block_constant1 , constant1 , solver_substrates , thomas_stride , thomas_block_width , 0.0 ); 
+	fill_block_coefficients( thomas_block_denomx , thomas_denomx , solver_substrates , thomas_stride , thomas_block_width , 1.0 ); 
+	fill_block_coefficients( thomas_block_cx , thomas_cx , solver_substrates , thomas_stride , thomas_block_width , 0.0 ); 
+	fill_block_coefficients( thomas_block_denomy , thomas_denomy , solver_substrates , thomas_stride , thomas_block_width , 1.0 ); 
+	fill_block_coefficients( thomas_block_cy , thomas_cy , solver_substrates , thomas_stride , thomas_block_width , 0.0 ); 
+	fill_block_coefficients( thomas_block_denomz , thomas_denomz , solver_substrates , thomas_stride , thomas_block_width , 1.0 ); 
+	fill_block_coefficients( thomas_block_cz , thomas_cz , solver_substrates , thomas_stride , thomas_block_width , 0.0 ); 
+
+	// the block layout may have changed 
+	dirichlet_blocks_out_of_date = true; 
+	return; 
+}
+
+void Microenvironment::initialize_coefficient_fields( void )
+{
+	if( diffusion_coefficient_field.size() == number_of_voxels() && decay_rate_field.size() == number_of_voxels() &&
+		( number_of_voxels() == 0 || ( diffusion_coefficient_field[0].size() == number_of_densities() &&
+		decay_rate_field[0].size() == number_of_densities() ) ) )
+	{ return; }
+	
+	diffusion_coefficient_field.assign( number_of_voxels() , diffusion_coefficients ); 
+	decay_rate_field.assign( number_of_voxels() , decay_rates ); 
+	coefficient_fields_out_of_date = true; 
+	return; 
+}
+
+void Microenvironment::coefficient_fields_changed( void )
+{
+	coefficient_fields_out_of_date = true; 
+	return; 
+}
+
+void Microenvironment::set_diffusion_coefficient( int voxel_index , int substrate_index , double new_value )
+{
+	initialize_coefficient_fields(); 
+	diffusion_coefficient_field[voxel_index][substrate_index] = new_value; 
+	coefficient_fields_out_of_date = true; 
+	return; 
+}
+
+void Microenvironment::set_decay_rate( int voxel_index , int substrate_index , double new_value )
+{
+	initialize_coefficient_fields(); 
+	decay_rate_field[voxel_index][substrate_index] = new_value; 
+	coefficient_fields_out_of_date = true; 
+	return; 
+}
+
+// diffusion coefficient on the face between two voxels: the harmonic mean,
+// so that a voxel with D = 0 blocks the flux (and equal values are exact)
+static double face_diffusion_coefficient( double D1 , double D2 )
+{
+	if( D1 == D2 )
+	{ return D1; }
+	if( D1 + D2 <= 0.0 )
+	{ return 0.0; }
+	return 2.0*D1*D2 / ( D1 + D2 ); 
+}
+
+// Thomas factorization of one line of the variable-coefficient LOD system
+//   ( 1 + K(i-1/2) + K(i+1/2) + dt*lambda(i)/dimensions ) u(i) - K(i-1/2) u(i-1) - K(i+1/2) u(i+1) = b(i),
+// K = dt*D/dx^2 on the faces (0 past the ends: no flux), for one substrate in
+// voxels first_voxel + i*voxel_jump. Step i's lower and 1/denom go to [ i*table_jump ]
+// (the solver forms c(i) = -lower(i+1)/denom(i) from them).
+// With uniform coefficients this reproduces the constant-coefficient factorization.
+static void factor_variable_coefficient_line( std::vector< std::vector<double> >& D , std::vector< std::vector<double> >& lambda ,
+	int substrate , int first_voxel , int voxel_jump , int length , double dt , double dx , int dimensions ,
+	double* lower , double* inverse_denom , int table_jump )
+{
+	double K_minus = 0.0; 
+	double c_previous = 0.0; 
+	for( int i=0; i < length; i++ )
 	{
-		/*
-		if( mesh.voxels[i].is_Dirichlet == true )
-		{ density_vector(i) = dirichlet_value_vectors[i]; }
-		*/
-		if( mesh.voxels[i].is_Dirichlet == true )
+		int n = first_voxel + i*voxel_jump; 
+		double K_plus = 0.0; 
+		if( i < length-1 )
+		{ K_plus = face_diffusion_coefficient( D[n][substrate] , D[n+voxel_jump][substrate] ) * dt / dx / dx; }
+		
+		double denominator = 1.0 + K_minus + K_plus + lambda[n][substrate] * dt / (double) dimensions; 
+		denominator += K_minus * c_previous; 
+		
+		lower[ i*table_jump ] = K_minus; 
+		inverse_denom[ i*table_jump ] = 1.0 / denominator; 
+		c_previous = -K_plus / denominator; 
+		K_minus = K_plus; 
+	}
+	return; 
+}
+
+void Microenvironment::setup_variable_coefficient_factorizations( double dt , int dimensions )
+{
+	initialize_coefficient_fields(); 
+	
+	// the fields decide which substrates are inert
+	bool layout_changed = ( thomas_densities.size() != number_of_voxels() * thomas_stride ); 
+	std::vector<int> active; 
+	for( unsigned int s=0; s < number_of_densities(); s++ )
+	{
+		if( !substrate_is_inert( s ) )
+		{ active.push_back( s ); }
+	}
+	if( layout_changed || active != solver_substrates )
+	{ setup_solver_buffer(); }
+	
+	int nx = mesh.x_coordinates.size(); 
+	int ny = mesh.y_coordinates.size(); 
+	int nz = mesh.z_coordinates.size(); 
+	int stride = thomas_stride; 
+	int width = thomas_block_width; 
+	int lines_per_block = width / stride; 
+	int number_of_substrates = solver_substrates.size(); 
+	
+	// x: each block of lines (adjacent in y) interleaved, as in the x-sweep; 
+	// padding lanes keep lower = 0, 1/denom = 1
+	int y_blocks = ( ny + lines_per_block - 1 ) / lines_per_block; 
+	thomas_line_lowerx.assign( nz*y_blocks*nx*width , 0.0 ); 
+	thomas_line_inverse_denomx.assign( nz*y_blocks*nx*width , 1.0 ); 
+	#pragma omp parallel for
+	for( int b=0; b < nz*y_blocks; b++ )
+	{
+		int k = b / y_blocks; 
+		int j = ( b % y_blocks ) * lines_per_block; 
+		int lines = std::min( lines_per_block , ny - j ); 
+		for( int line=0; line < lines; line++ )
 		{
-			for( unsigned int j=0; j < dirichlet_value_vectors[i].size(); j++ )
+			for( int s=0; s < number_of_substrates; s++ )
 			{
-				if( dirichlet_activation_vector[j] == true )
-				{
-					density_vector(i)[j] = dirichlet_value_vectors[i][j]; 
-				}
+				int offset = b*nx*width + line*stride + s; 
+				factor_variable_coefficient_line( diffusion_coefficient_field , decay_rate_field , solver_substrates[s] ,
+					voxel_index(0,j+line,k) , 1 , nx , dt , mesh.dx , dimensions ,
+					thomas_line_lowerx.data() + offset , thomas_line_inverse_denomx.data() + offset , width ); 
 			}
+		}
+	}
 	
+	// y and z: in the layout of thomas_densities
+	thomas_line_lowery.assign( number_of_voxels()*stride , 0.0 ); 
+	thomas_line_inverse_denomy.assign( number_of_voxels()*stride , 1.0 ); 
+	#pragma omp parallel for
+	for( int line=0; line < nx*nz; line++ )
+	{
+		int n = voxel_index( line % nx , 0 , line / nx ); 
+		for( int s=0; s < number_of_substrates; s++ )
+		{
+			int offset = n*stride + s; 
+			factor_variable_coefficient_line( diffusion_coefficient_field , decay_rate_field , solver_substrates[s] ,
+				n , nx , ny , dt , mesh.dy , dimensions ,
+				thomas_line_lowery.data() + offset , thomas_line_inverse_denomy.data() + offset , nx*stride ); 
+		}
+	}
+	
+	thomas_line_lowerz.clear(); 
+	thomas_line_inverse_denomz.clear(); 
+	if( dimensions == 3 )
+	{
+		thomas_line_lowerz.assign( number_of_voxels()*stride , 0.0 ); 
+		thomas_line_inverse_denomz.assign( number_of_voxels()*stride , 1.0 ); 
+		#pragma omp parallel for
+		for( int line=0; line < nx*ny; line++ )
+		{
+			int n = line; // voxel ( i, j, 0 )
+			for( int s=0; s < number_of_substrates; s++ )
+			{
+				int offset = n*stride + s; 
+				factor_variable_coefficient_line( diffusion_coefficient_field , decay_rate_field , solver_substrates[s] ,
+					n , nx*ny , nz , dt , mesh.dz , dimensions ,
+					thomas_line_lowerz.data() + offset , thomas_line_inverse_denomz.data() + offset , nx*ny*stride ); 
+			}
+		}
+	}
+	
+	coefficient_fields_out_of_date = false; 
+	thomas_line_dt = dt; 
+	return; 
+}
+
+void Microenvironment::copy_densities_to_solver_buffer( void )
+{
+	int number_of_substrates = solver_substrates.size(); 
+	#pragma omp parallel for 
+	for( unsigned int n=0; n < mesh.voxels.size(); n++ )
+	{
+		double* pBuffer = &thomas_densities[ n*thomas_stride ]; 
+		std::vector<double>& density = (*p_density_vectors)[n]; 
+		for( int s=0; s < number_of_substrates; s++ )
+		{ pBuffer[s] = density[ solver_substrates[s] ]; }
+	}
+	return; 
+}
+
+void Microenvironment::copy_densities_from_solver_buffer( void )
+{
+	int number_of_substrates = solver_substrates.size(); 
+	#pragma omp parallel for 
+	for( unsigned int n=0; n < mesh.voxels.size(); n++ )
+	{
+		double* pBuffer = &thomas_densities[ n*thomas_stride ]; 
+		std::vector<double>& density = (*p_density_vectors)[n]; 
+		for( int s=0; s < number_of_substrates; s++ )
+		{ density[ solver_substrates[s] ] = pBuffer[s]; }
+	}
+	return; 
+}
+
+// Dirichlet node m, on the solved substrates in the flat buffer 
+void Microenvironment::apply_dirichlet_node_to_solver_buffer( int m )
+{
+	int n = number_of_densities(); 
+	double* pBuffer = &thomas_densities[ dirichlet_indices[m]*thomas_stride ]; 
+	for( unsigned int j=0; j < solver_substrates.size(); j++ )
+	{
+		int s = solver_substrates[j]; 
+		if( dirichlet_activation_vector[s] == true )
+		{ pBuffer[j] = dirichlet_values[ m*n + s ]; }
+	}
+	return; 
+}
+
+void Microenvironment::apply_dirichlet_conditions_to_solver_buffer( void )
+{
+	#pragma omp parallel for 
+	for( unsigned int m=0 ; m < dirichlet_indices.size() ; m++ )
+	{ apply_dirichlet_node_to_solver_buffer( m ); }
+	return; 
+}
+
+void Microenvironment::apply_dirichlet_conditions_to_solver_block( int direction , int block )
+{
+	std::vector<int>& start = dirichlet_block_start[direction]; 
+	std::vector<int>& nodes = dirichlet_nodes_by_block[direction]; 
+	for( int i=start[block]; i < start[block+1]; i++ )
+	{ apply_dirichlet_node_to_solver_buffer( nodes[i] ); }
+	return; 
+}
+
+void Microenvironment::sort_dirichlet_nodes_by_block( void )
+{
+	int lines_per_block = thomas_block_width / thomas_stride; 
+	int nx = mesh.x_coordinates.size(); 
+	int ny = mesh.y_coordinates.size(); 
+	int nz = mesh.z_coordinates.size(); 
+	int x_blocks = ( nx + lines_per_block - 1 ) / lines_per_block; 
+	int y_blocks = ( ny + lines_per_block - 1 ) / lines_per_block; 
+	
+	// blocks, as numbered by the solvers: x-lines by ( k, j-block ), 
+	// y-lines by ( k, i-block ), z-lines by ( j, i-block ) 
+	int number_of_blocks[3] = { nz*y_blocks , nz*x_blocks , ny*x_blocks }; 
+	std::vector<int> node_block[3]; 
+	for( int d=0; d < 3; d++ )
+	{ node_block[d].resize( dirichlet_indices.size() ); }
+	for( unsigned int m=0; m < dirichlet_indices.size(); m++ )
+	{
+		int n = dirichlet_indices[m]; 
+		int i = n % nx; 
+		int j = ( n / nx ) % ny; 
+		int k = n / ( nx*ny ); 
+		node_block[0][m] = k*y_blocks + j/lines_per_block; 
+		node_block[1][m] = k*x_blocks + i/lines_per_block; 
+		node_block[2][m] = j*x_blocks + i/lines_per_block; 
+	}
+	
+	// counting sort of the nodes by block 
+	dirichlet_block_start.resize( 3 ); 
+	dirichlet_nodes_by_block.resize( 3 ); 
+	for( int d=0; d < 3; d++ )
+	{
+		std::vector<int>& start = dirichlet_block_start[d]; 
+		start.assign( number_of_blocks[d]+1 , 0 ); 
+		for( unsigned int m=0; m < dirichlet_indices.size(); m++ )
+		{ start[ node_block[d][m]+1 ]++; }
+		for( int b=0; b < number_of_blocks[d]; b++ )
+		{ start[b+1] += start[b]; }
+		
+		std::vector<int> next( start.begin() , start.end()-1 ); 
+		dirichlet_nodes_by_block[d].resize( dirichlet_indices.size() ); 
+		for( unsigned int m=0; m < dirichlet_indices.size(); m++ )
+		{ dirichlet_nodes_by_block[d][ next[ node_block[d][m] ]++ ] = m; }
+	}
+	
+	dirichlet_blocks_out_of_date = false; 
+	return; 
+}
+
+void Microenvironment::apply_dirichlet_conditions_to_inert_substrates( void )
+{
+	if( inert_substrates.size() == 0 )
+	{ return; }
+
+	int n = number_of_densities(); 
+	#pragma omp parallel for 
+	for( unsigned int m=0 ; m < dirichlet_indices.size() ; m++ )
+	{
+		std::vector<double>& density = density_vector( dirichlet_indices[m] ); 
+		for( unsigned int j=0; j < inert_substrates.size(); j++ )
+		{
+			int s = inert_substrates[j]; 
+			if( dirichlet_activation_vector[s] == true )
+			{ density[s] = dirichlet_values[ m*n + s ]; }
 		}
 	}
 	return; 
@@ -325,9 +708,13 @@ void Microenvironment::resize_voxels( int new_number_of_voxes )
 			(gradient_vectors[k])[i].resize( 3, 0.0 );
 		}
 	}
-	gradient_vector_computed.resize( mesh.voxels.size() , false ); 	
+	clear_gradient_cache(); 
 	
-	dirichlet_value_vectors.assign( mesh.voxels.size(), one ); 
+	dirichlet_indices.clear(); 
+	dirichlet_values.clear(); 
+	dirichlet_node_map.assign( mesh.voxels.size() , -1 ); 
+	agent_counts_by_voxel.assign( mesh.voxels.size() , 0 ); 
+	dirichlet_blocks_out_of_date = true; 
 	
 	return; 
 }
@@ -349,9 +736,13 @@ void Microenvironment::resize_space( int x_nodes, int y_nodes, int z_nodes )
 			(gradient_vectors[k])[i].resize( 3, 0.0 );
 		}
 	}
-	gradient_vector_computed.resize( mesh.voxels.size() , false ); 	
+	clear_gradient_cache(); 
 	
-	dirichlet_value_vectors.assign( mesh.voxels.size(), one ); 
+	dirichlet_indices.clear(); 
+	dirichlet_values.clear(); 
+	dirichlet_node_map.assign( mesh.voxels.size() , -1 ); 
+	agent_counts_by_voxel.assign( mesh.voxels.size() , 0 ); 
+	dirichlet_blocks_out_of_date = true; 
 
 	return;  
 }
@@ -372,9 +763,13 @@ void Microenvironment::resize_space( double x_start, double x_end, double y_star
 			(gradient_vectors[k])[i].resize( 3, 0.0 );
 		}
 	}
-	gradient_vector_computed.resize( mesh.voxels.size() , false ); 	
+	clear_gradient_cache(); 
 
-	dirichlet_value_vectors.assign( mesh.voxels.size(), one ); 
+	dirichlet_indices.clear(); 
+	dirichlet_values.clear(); 
+	dirichlet_node_map.assign( mesh.voxels.size() , -1 ); 
+	agent_counts_by_voxel.assign( mesh.voxels.size() , 0 ); 
+	dirichlet_blocks_out_of_date = true; 
 	
 	return;  
 }
@@ -395,9 +790,13 @@ void Microenvironment::resize_space( double x_start, double x_end, double y_star
 			(gradient_vectors[k])[i].resize( 3, 0.0 );
 		}
 	}
-	gradient_vector_computed.resize( mesh.voxels.size() , false ); 	
+	clear_gradient_cache(); 
 	
-	dirichlet_value_vectors.assign( mesh.voxels.size(), one ); 
+	dirichlet_indices.clear(); 
+	dirichlet_values.clear(); 
+	dirichlet_node_map.assign( mesh.voxels.size() , -1 ); 
+	agent_counts_by_voxel.assign( mesh.voxels.size() , 0 ); 
+	dirichlet_blocks_out_of_date = true; 
 	
 	return;  
 }
@@ -423,7 +822,7 @@ void Microenvironment::resize_densities( int new_size )
 			(gradient_vectors[k])[i].resize( 3, 0.0 );
 		}
 	}
-	gradient_vector_computed.resize( mesh.voxels.size() , false ); 	
+	clear_gradient_cache(); 
 	
 	diffusion_coefficients.assign( new_size , 0.0 ); 
 	decay_rates.assign( new_size , 0.0 ); 
@@ -437,11 +836,15 @@ void Microenvironment::resize_densities( int new_size )
 	one_third = one; 
 	one_third /= 3.0; 
 	
-	dirichlet_value_vectors.assign( mesh.voxels.size(), one ); 
+	// the Dirichlet nodes stay, with their values reset to 1 
+	dirichlet_values.assign( dirichlet_indices.size() * one.size() , 1.0 ); 
+	dirichlet_blocks_out_of_date = true; 
 	dirichlet_activation_vector.assign( new_size, true ); 
+	gradient_activation_vector.assign( new_size, true ); 
 
 	default_microenvironment_options.Dirichlet_condition_vector.assign( new_size , 1.0 );  
 	default_microenvironment_options.Dirichlet_activation_vector.assign( new_size, true ); 
+	default_microenvironment_options.gradient_activation_vector.assign( new_size, true ); 
 	
 	default_microenvironment_options.initial_condition_vector.assign( new_size , 1.0 ); 
 	
@@ -482,7 +885,7 @@ void Microenvironment::add_density( void )
 		}
 	}
 
-	gradient_vector_computed.resize( mesh.voxels.size() , false ); 	
+	clear_gradient_cache(); 
 	
 	one_half = one; 
 	one_half *= 0.5; 
@@ -490,12 +893,16 @@ void Microenvironment::add_density( void )
 	one_third = one; 
 	one_third /= 3.0; 
 	
-	dirichlet_value_vectors.assign( mesh.voxels.size(), one ); 
+	// the Dirichlet nodes stay, with their values reset to 1 
+	dirichlet_values.assign( dirichlet_indices.size() * one.size() , 1.0 ); 
+	dirichlet_blocks_out_of_date = true; 
 	dirichlet_activation_vector.assign( number_of_densities(), true ); 
+	gradient_activation_vector.assign( number_of_densities(), true ); 
 	
 	// Fixes in PhysiCell preview November 2017
 	default_microenvironment_options.Dirichlet_condition_vector.push_back( 1.0 ); //  = one; 
 	default_microenvironment_options.Dirichlet_activation_vector.push_back( true ); // assign( number_of_densities(), true ); 
+	default_microenvironment_options.gradient_activation_vector.push_back( true ); 
 	
 	default_microenvironment_options.initial_condition_vector.push_back( 1.0 ); 
 	
@@ -535,7 +942,7 @@ void Microenvironment::add_density( std::string name , std::string units )
 			(gradient_vectors[k])[i].resize( 3, 0.0 );
 		}
 	}
-	gradient_vector_computed.resize( mesh.voxels.size() , false ); 	
+	clear_gradient_cache(); 
 
 	one_half = one; 
 	one_half *= 0.5; 
@@ -543,12 +950,16 @@ void Microenvironment::add_density( std::string name , std::string units )
 	one_third = one; 
 	one_third /= 3.0; 
 	
-	dirichlet_value_vectors.assign( mesh.voxels.size(), one ); 
+	// the Dirichlet nodes stay, with their values reset to 1 
+	dirichlet_values.assign( dirichlet_indices.size() * one.size() , 1.0 ); 
+	dirichlet_blocks_out_of_date = true; 
 	dirichlet_activation_vector.assign( number_of_densities(), true ); 
+	gradient_activation_vector.assign( number_of_densities(), true ); 
 	
 	// fix in PhysiCell preview November 2017 
 	default_microenvironment_options.Dirichlet_condition_vector.push_back( 1.0 ); //  = one; 
 	default_microenvironment_options.Dirichlet_activation_vector.push_back( true ); // assign( number_of_densities(), true ); 
+	default_microenvironment_options.gradient_activation_vector.push_back( true ); 
 
 	default_microenvironment_options.initial_condition_vector.push_back( 1.0 ); 
 	
@@ -588,7 +999,7 @@ void Microenvironment::add_density( std::string name , std::string units, double
 			(gradient_vectors[k])[i].resize( 3, 0.0 );
 		}
 	}
-	gradient_vector_computed.resize( mesh.voxels.size() , false ); 	
+	clear_gradient_cache(); 
 
 	one_half = one; 
 	one_half *= 0.5; 
@@ -596,12 +1007,16 @@ void Microenvironment::add_density( std::string name , std::string units, double
 	one_third = one; 
 	one_third /= 3.0; 
 	
-	dirichlet_value_vectors.assign( mesh.voxels.size(), one ); 
+	// the Dirichlet nodes stay, with their values reset to 1 
+	dirichlet_values.assign( dirichlet_indices.size() * one.size() , 1.0 ); 
+	dirichlet_blocks_out_of_date = true; 
 	dirichlet_activation_vector.assign( number_of_densities(), true ); 
+	gradient_activation_vector.assign( number_of_densities(), true ); 
 	
 	// fix in PhysiCell preview November 2017 
 	default_microenvironment_options.Dirichlet_condition_vector.push_back( 1.0 ); // = one; 
 	default_microenvironment_options.Dirichlet_activation_vector.push_back( true ); // assign( number_of_densities(), true ); 
+	default_microenvironment_options.gradient_activation_vector.push_back( true ); 
 	
 	default_microenvironment_options.initial_condition_vector.push_back( 1.0 ); 
 	
@@ -652,18 +1067,30 @@ std::vector<unsigned int> Microenvironment::cartesian_indices( int n )
 int Microenvironment::nearest_voxel_index( std::vector<double>& position )
 { return mesh.nearest_voxel_index( position ); }
 
+int Microenvironment::nearest_voxel_index( const Vec3& position )
+{ return mesh.nearest_voxel_index( position ); }
+
 Voxel& Microenvironment::voxels( int voxel_index )
 { return mesh.voxels[voxel_index]; }
 
 std::vector<unsigned int> Microenvironment::nearest_cartesian_indices( std::vector<double>& position )
 { return mesh.nearest_cartesian_indices( position ); }
  
+std::vector<unsigned int> Microenvironment::nearest_cartesian_indices( const Vec3& position )
+{ return mesh.nearest_cartesian_indices( position ); }
+ 
 Voxel& Microenvironment::nearest_voxel( std::vector<double>& position )
 { return mesh.nearest_voxel( position ); }
 
+Voxel& Microenvironment::nearest_voxel( const Vec3& position )
+{ return mesh.nearest_voxel( position ); }
+
 std::vector<double>& Microenvironment::nearest_density_vector( std::vector<double>& position )
 { return (*p_density_vectors)[ mesh.nearest_voxel_index( position ) ]; }
 
+std::vector<double>& Microenvironment::nearest_density_vector( const Vec3& position )
+{ return (*p_density_vectors)[ mesh.nearest_voxel_index( position ) ]; }
+
 std::vector<double>& Microenvironment::nearest_density_vector( int voxel_index )
 { return (*p_density_vectors)[ voxel_index ]; }
 
@@ -687,8 +1114,12 @@ std::vector<double>& Microenvironment::density_vector( int n )
 
 void Microenvironment::simulate_diffusion_decay( double dt )
 {
+	solver_applied_cell_sources_and_sinks = false; 
 	if( diffusion_decay_solver )
-	{ diffusion_decay_solver( *this, dt ); }
+	{
+		diffusion_decay_solver( *this, dt ); 
+		invalidate_gradient_vectors(); 
+	}
 	else
 	{
 		std::cout << "Warning: diffusion-reaction-source/sink solver not set for Microenvironment object at " << this << ". Nothing happened!" << std::endl; 
@@ -808,13 +1239,72 @@ void Microenvironment::simulate_bulk_sources_and_sinks( double dt )
 	return; 
 }
 
+void Microenvironment::sort_agents_by_voxel( std::vector<Basic_Agent*>& basic_agent_list )
+{
+	std::vector<int>& counts = agent_counts_by_voxel;
+	agents_outside_mesh.clear();
+	occupied_voxels.clear();
+
+	// count the agents in each voxel, and list the occupied voxels
+	for( unsigned int i=0 ; i < basic_agent_list.size() ; i++ )
+	{
+		int n = basic_agent_list[i]->get_current_voxel_index();
+		if( n < 0 || n >= (int) number_of_voxels() )
+		{ agents_outside_mesh.push_back( i ); }
+		else
+		{
+			if( counts[n] == 0 )
+			{ occupied_voxels.push_back( n ); }
+			counts[n]++;
+		}
+	}
+	std::sort( occupied_voxels.begin() , occupied_voxels.end() );
+
+	// starting offsets of the occupied voxels
+	agents_by_voxel_start.clear();
+	int offset = 0;
+	for( unsigned int m=0 ; m < occupied_voxels.size() ; m++ )
+	{
+		int n = occupied_voxels[m];
+		agents_by_voxel_start.push_back( offset );
+		offset += counts[n];
+		// reuse counts as the write position for this voxel
+		counts[n] = agents_by_voxel_start.back();
+	}
+	agents_by_voxel_start.push_back( offset );
+
+	// place the agents (preserving list order within each voxel)
+	agents_by_voxel.resize( offset );
+	for( unsigned int i=0 ; i < basic_agent_list.size() ; i++ )
+	{
+		int n = basic_agent_list[i]->get_current_voxel_index();
+		if( n >= 0 && n < (int) number_of_voxels() )
+		{
+			agents_by_voxel[ counts[n] ] = i;
+			counts[n]++;
+		}
+	}
+
+	// leave the counts at zero for the next sort
+	for( unsigned int m=0 ; m < occupied_voxels.size() ; m++ )
+	{ counts[ occupied_voxels[m] ] = 0; }
+
+	return;
+}
+
 void Microenvironment::simulate_cell_sources_and_sinks( std::vector<Basic_Agent*>& basic_agent_list , double dt )
 {
+	// group the agents by voxel so that each density vector has one writer
+	sort_agents_by_voxel( basic_agent_list );
+
 	#pragma omp parallel for
-	for( unsigned int i=0 ; i < basic_agent_list.size() ; i++ )
+	for( unsigned int n=0 ; n < occupied_voxels.size() ; n++ )
 	{		
-		basic_agent_list[i]->simulate_secretion_and_uptake( this , dt ); 
+		for( int i=agents_by_voxel_start[n] ; i < agents_by_voxel_start[n+1] ; i++ )
+		{ basic_agent_list[ agents_by_voxel[i] ]->simulate_secretion_and_uptake( this , dt ); }
 	}
+
+	// agents outside the mesh are inactive, and do not secrete or uptake.
 	
 	return; 
 }
@@ -824,6 +1314,62 @@ void Microenvironment::simulate_cell_sources_and_sinks( double dt )
 	simulate_cell_sources_and_sinks(all_basic_agents, dt);
 }
 
+void Microenvironment::apply_fused_sources_and_sinks( double dt , bool copy_from_solver_buffer )
+{
+	sort_agents_by_voxel( all_basic_agents ); 
+	bool bulk_sources_and_sinks = ( uptake_rates.size() == number_of_voxels() ); 
+	
+	// each thread takes a chunk of voxels, and walks the (increasing) list of 
+	// occupied voxels alongside it 
+	int chunk_size = 1024; 
+	int number_of_voxels = mesh.voxels.size(); 
+	int number_of_chunks = ( number_of_voxels + chunk_size - 1 ) / chunk_size; 
+	int number_of_substrates = solver_substrates.size(); 
+	
+	#pragma omp parallel for 
+	for( int c=0; c < number_of_chunks; c++ )
+	{
+		int first = c*chunk_size; 
+		int last = std::min( first + chunk_size , number_of_voxels ); 
+		int m = std::lower_bound( occupied_voxels.begin() , occupied_voxels.end() , first ) - occupied_voxels.begin(); 
+		
+		for( int n=first; n < last; n++ )
+		{
+			std::vector<double>& density = (*p_density_vectors)[n]; 
+			if( copy_from_solver_buffer )
+			{
+				double* pBuffer = &thomas_densities[ n*thomas_stride ]; 
+				for( int s=0; s < number_of_substrates; s++ )
+				{ density[ solver_substrates[s] ] = pBuffer[s]; }
+			}
+			
+			// bulk: p = ( p + dt*S*T ) / ( 1 + dt*(U+S) ), as in simulate_bulk_sources_and_sinks 
+			if( bulk_sources_and_sinks )
+			{
+				for( unsigned int s=0; s < density.size(); s++ )
+				{
+					density[s] += dt * supply_target_densities_times_supply_rates[n][s]; 
+					density[s] /= 1.0 + dt*( uptake_rates[n][s] + supply_rates[n][s] ); 
+				}
+			}
+			
+			if( m < (int) occupied_voxels.size() && occupied_voxels[m] == n )
+			{
+				for( int i=agents_by_voxel_start[m] ; i < agents_by_voxel_start[m+1] ; i++ )
+				{ agent_source_sink_function( all_basic_agents[ agents_by_voxel[i] ] , this , dt ); }
+				m++; 
+			}
+		}
+	}
+	
+	// agents outside the mesh are inactive, but still get the call (e.g., to sync their rates) 
+	for( unsigned int i=0 ; i < agents_outside_mesh.size() ; i++ )
+	{ agent_source_sink_function( all_basic_agents[ agents_outside_mesh[i] ] , this , dt ); }
+	
+	solver_applied_cell_sources_and_sinks = true; 
+	return; 
+}
+
 void Microenvironment::update_rates( void )
 {
 	if( supply_target_densities_times_supply_rates.size() != number_of_voxels() )
@@ -847,10 +1393,15 @@ void Microenvironment::update_rates( void )
 	return; 
 }
 
+// the states in gradient_vector_computed 
+static const char gradient_stale = 0; 
+static const char gradient_computing = 1; 
+static const char gradient_current = 2; 
+
 std::vector<gradient>& Microenvironment::gradient_vector(int i, int j, int k)
 {
 	int n = voxel_index(i,j,k);
-	if( gradient_vector_computed[n] == false )
+	if( gradient_vector_computed[n].load( std::memory_order_acquire ) != gradient_current )
 	{
 		compute_gradient_vector( n );
 	}
@@ -861,7 +1412,7 @@ std::vector<gradient>& Microenvironment::gradient_vector(int i, int j, int k)
 std::vector<gradient>& Microenvironment::gradient_vector(int i, int j )
 {
 	int n = voxel_index(i,j,0);
-	if( gradient_vector_computed[n] == false )
+	if( gradient_vector_computed[n].load( std::memory_order_acquire ) != gradient_current )
 	{
 		compute_gradient_vector( n );
 	}
@@ -872,7 +1423,7 @@ std::vector<gradient>& Microenvironment::gradient_vector(int i, int j )
 std::vector<gradient>& Microenvironment::gradient_vector(int n )
 {
 	// if the gradient has not yet been computed, then do it!
-	if( gradient_vector_computed[n] == false )
+	if( gradient_vector_computed[n].load( std::memory_order_acquire ) != gradient_current )
 	{
 		compute_gradient_vector( n );
 	}
@@ -882,9 +1433,12 @@ std::vector<gradient>& Microenvironment::gradient_vector(int n )
 }
 	
 std::vector<gradient>& Microenvironment::nearest_gradient_vector( std::vector<double>& position )
+{ return nearest_gradient_vector( Vec3( position ) ); }
+
+std::vector<gradient>& Microenvironment::nearest_gradient_vector( const Vec3& position )
 {
 	int n = nearest_voxel_index( position );
-	if( gradient_vector_computed[n] == false )
+	if( gradient_vector_computed[n].load( std::memory_order_acquire ) != gradient_current )
 	{
 		compute_gradient_vector( n );
 	}
@@ -894,17 +1448,14 @@ std::vector<gradient>& Microenvironment::nearest_gradient_vector( std::vector<do
 
 void Microenvironment::compute_all_gradient_vectors( void )
 {
-	static double two_dx = mesh.dx; 
-	static double two_dy = mesh.dy; 
-	static double two_dz = mesh.dz; 
-	static bool gradient_constants_defined = false; 
-	if( gradient_constants_defined == false )
-	{
-		two_dx *= 2.0; 
-		two_dy *= 2.0; 
-		two_dz *= 2.0;
-		gradient_constants_defined = true; 
-	}
+	double two_dx = 2.0 * mesh.dx; 
+	double two_dy = 2.0 * mesh.dy; 
+	double two_dz = 2.0 * mesh.dz; 
+	
+	// (the solvers' thomas_i_jump etc. may not be set up yet) 
+	int i_jump = 1; 
+	int j_jump = mesh.x_coordinates.size(); 
+	int k_jump = mesh.x_coordinates.size() * mesh.y_coordinates.size(); 
 	
 	#pragma omp parallel for 
 	for( unsigned int k=0; k < mesh.z_coordinates.size() ; k++ )
@@ -916,13 +1467,13 @@ void Microenvironment::compute_all_gradient_vectors( void )
 			{
 				for( unsigned int q=0; q < number_of_densities() ; q++ )
 				{
+					if( gradient_activation_vector[q] == false )
+					{ continue; }
 					int n = voxel_index(i,j,k);
 					// x-derivative of qth substrate at voxel n
-					gradient_vectors[n][q][0] = (*p_density_vectors)[n+thomas_i_jump][q]; 
-					gradient_vectors[n][q][0] -= (*p_density_vectors)[n-thomas_i_jump][q]; 
+					gradient_vectors[n][q][0] = (*p_density_vectors)[n+i_jump][q]; 
+					gradient_vectors[n][q][0] -= (*p_density_vectors)[n-i_jump][q]; 
 					gradient_vectors[n][q][0] /= two_dx; 
-					
-					gradient_vector_computed[n] = true; 
  				}
 			}
 			
@@ -939,12 +1490,13 @@ void Microenvironment::compute_all_gradient_vectors( void )
 			{
 				for( unsigned int q=0; q < number_of_densities() ; q++ )
 				{
+					if( gradient_activation_vector[q] == false )
+					{ continue; }
 					int n = voxel_index(i,j,k);
 					// y-derivative of qth substrate at voxel n
-					gradient_vectors[n][q][1] = (*p_density_vectors)[n+thomas_j_jump][q]; 
-					gradient_vectors[n][q][1] -= (*p_density_vectors)[n-thomas_j_jump][q]; 
+					gradient_vectors[n][q][1] = (*p_density_vectors)[n+j_jump][q]; 
+					gradient_vectors[n][q][1] -= (*p_density_vectors)[n-j_jump][q]; 
 					gradient_vectors[n][q][1] /= two_dy; 
-					gradient_vector_computed[n] = true; 
 				}
 			}
 			
@@ -961,77 +1513,102 @@ void Microenvironment::compute_all_gradient_vectors( void )
 			{
 				for( unsigned int q=0; q < number_of_densities() ; q++ )
 				{
+					if( gradient_activation_vector[q] == false )
+					{ continue; }
 					int n = voxel_index(i,j,k);
-					// y-derivative of qth substrate at voxel n
-					gradient_vectors[n][q][2] = (*p_density_vectors)[n+thomas_k_jump][q]; 
-					gradient_vectors[n][q][2] -= (*p_density_vectors)[n-thomas_k_jump][q]; 
+					// z-derivative of qth substrate at voxel n
+					gradient_vectors[n][q][2] = (*p_density_vectors)[n+k_jump][q]; 
+					gradient_vectors[n][q][2] -= (*p_density_vectors)[n-k_jump][q]; 
 					gradient_vectors[n][q][2] /= two_dz; 
-					gradient_vector_computed[n] = true; 
 				}
 			}
 			
 		}
 	}
 
+	// every voxel is now current 
+	gradient_voxels_computed.resize( mesh.voxels.size() ); 
+	for( unsigned int n=0; n < mesh.voxels.size() ; n++ )
+	{
+		gradient_vector_computed[n].store( gradient_current , std::memory_order_release ); 
+		gradient_voxels_computed[n] = n; 
+	}
+
 	return; 
 }
 
 void Microenvironment::compute_gradient_vector( int n )
 {
-	static double two_dx = mesh.dx; 
-	static double two_dy = mesh.dy; 
-	static double two_dz = mesh.dz; 
-	static bool gradient_constants_defined = false; 
-	std::vector<unsigned int> indices(3,0);
-	
-	if( gradient_constants_defined == false )
-	{
-		two_dx *= 2.0; 
-		two_dy *= 2.0; 
-		two_dz *= 2.0;
-		gradient_constants_defined = true; 
-	}	
-	
-	indices = cartesian_indices( n );
-	
-	// d/dx 
-	if( indices[0] > 0 && indices[0] < mesh.x_coordinates.size()-1 )
+	// agents query gradients from parallel loops: the first thread to get here 
+	// computes the voxel, and the others wait for it 
+	char state = gradient_stale; 
+	if( gradient_vector_computed[n].compare_exchange_strong( state , gradient_computing , std::memory_order_acquire ) == false )
 	{
-		for( unsigned int q=0; q < number_of_densities() ; q++ )
-		{
-			gradient_vectors[n][q][0] = (*p_density_vectors)[n+thomas_i_jump][q]; 
-			gradient_vectors[n][q][0] -= (*p_density_vectors)[n-thomas_i_jump][q]; 
-			gradient_vectors[n][q][0] /= two_dx; 
-			gradient_vector_computed[n] = true; 
-		}
+		while( state != gradient_current )
+		{ state = gradient_vector_computed[n].load( std::memory_order_acquire ); }
+		return; 
 	}
 	
-	// d/dy 
-	if( indices[1] > 0 && indices[1] < mesh.y_coordinates.size()-1 )
+	double two_dx = 2.0 * mesh.dx; 
+	double two_dy = 2.0 * mesh.dy; 
+	double two_dz = 2.0 * mesh.dz; 
+	
+	int nx = mesh.x_coordinates.size(); 
+	int ny = mesh.y_coordinates.size(); 
+	int nz = mesh.z_coordinates.size(); 
+	int i = n % nx; 
+	int j = ( n / nx ) % ny; 
+	int k = n / ( nx*ny ); 
+	int i_jump = 1; 
+	int j_jump = nx; 
+	int k_jump = nx*ny; 
+	
+	std::vector<double>& density_left_x = (*p_density_vectors)[ i > 0 ? n-i_jump : n ]; 
+	std::vector<double>& density_right_x = (*p_density_vectors)[ i < nx-1 ? n+i_jump : n ]; 
+	std::vector<double>& density_left_y = (*p_density_vectors)[ j > 0 ? n-j_jump : n ]; 
+	std::vector<double>& density_right_y = (*p_density_vectors)[ j < ny-1 ? n+j_jump : n ]; 
+	std::vector<double>& density_left_z = (*p_density_vectors)[ k > 0 ? n-k_jump : n ]; 
+	std::vector<double>& density_right_z = (*p_density_vectors)[ k < nz-1 ? n+k_jump : n ]; 
+	
+	for( unsigned int q=0; q < number_of_densities() ; q++ )
 	{
-		for( unsigned int q=0; q < number_of_densities() ; q++ )
-		{
-			gradient_vectors[n][q][1] = (*p_density_vectors)[n+thomas_j_jump][q]; 
-			gradient_vectors[n][q][1] -= (*p_density_vectors)[n-thomas_j_jump][q]; 
-			gradient_vectors[n][q][1] /= two_dy; 
-			gradient_vector_computed[n] = true; 
-		}
-	}
+		if( gradient_activation_vector[q] == false )
+		{ continue; }
+		
+		// centered differences in the interior (boundary components are left at 0) 
+		if( i > 0 && i < nx-1 )
+		{ gradient_vectors[n][q][0] = ( density_right_x[q] - density_left_x[q] ) / two_dx; }
+		if( j > 0 && j < ny-1 )
+		{ gradient_vectors[n][q][1] = ( density_right_y[q] - density_left_y[q] ) / two_dy; }
+		if( k > 0 && k < nz-1 )
+		{ gradient_vectors[n][q][2] = ( density_right_z[q] - density_left_z[q] ) / two_dz; }
+	}	
 	
-	// d/dz 
-	if( indices[2] > 0 && indices[2] < mesh.z_coordinates.size()-1 )
-	{
-		for( unsigned int q=0; q < number_of_densities() ; q++ )
-		{
-			gradient_vectors[n][q][2] = (*p_density_vectors)[n+thomas_k_jump][q]; 
-			gradient_vectors[n][q][2] -= (*p_density_vectors)[n-thomas_k_jump][q]; 
-			gradient_vectors[n][q][2] /= two_dz; 
-			gradient_vector_computed[n] = true; 
-		}
-	}
+	#pragma omp critical(gradient_vector_cache)
+	{ gradient_voxels_computed.push_back( n ); }
+	gradient_vector_computed[n].store( gradient_current , std::memory_order_release ); 
 	
 	return; 
 }
+	
+void Microenvironment::invalidate_gradient_vectors( void )
+{
+	for( unsigned int m=0; m < gradient_voxels_computed.size() ; m++ )
+	{ gradient_vector_computed[ gradient_voxels_computed[m] ].store( gradient_stale , std::memory_order_relaxed ); }
+	gradient_voxels_computed.clear(); 
+	return; 
+}
+
+void Microenvironment::clear_gradient_cache( void )
+{
+	// (std::atomic can't be copied, so make a new vector rather than assign) 
+	std::vector< std::atomic<char> > states( mesh.voxels.size() ); 
+	for( unsigned int n=0; n < states.size() ; n++ )
+	{ states[n].store( gradient_stale , std::memory_order_relaxed ); }
+	gradient_vector_computed.swap( states ); 
+	gradient_voxels_computed.clear(); 
+	return; 
+}
 
 void Microenvironment::reset_all_gradient_vectors( void )
 {
@@ -1042,7 +1619,7 @@ void Microenvironment::reset_all_gradient_vectors( void )
 			(gradient_vectors[k])[i].resize( 3, 0.0 );
 		}
 	}
-	gradient_vector_computed.assign( mesh.voxels.size() , false ); 	
+	clear_gradient_cache(); 
 }
 
 
@@ -1072,6 +1649,7 @@ Microenvironment_Options::Microenvironment_Options()
 	outer_Dirichlet_conditions = false; 
 	Dirichlet_condition_vector.assign( pMicroenvironment->number_of_densities() , 1.0 ); 
 	Dirichlet_activation_vector.assign( pMicroenvironment->number_of_densities() , true ); 
+	gradient_activation_vector.assign( pMicroenvironment->number_of_densities() , true ); 
 	
 	initial_condition_vector.resize(0); //  = Dirichlet_condition_vector; 
 	
@@ -1093,6 +1671,17 @@ Microenvironment_Options::Microenvironment_Options()
 	
 	track_internalized_substrates_in_each_agent = false; 
 	
+	fuse_sources_and_sinks = false; 
+	
+	quasi_steady_state_solver = false; 
+	quasi_steady_state_interval = 0.1; 
+	
+	adaptive_mesh_refinement = false; 
+	amr_refinement_ratio = 4; 
+	amr_buffer_distance = 100.0; 
+	
+	variable_coefficients = false; 
+	
 	return; 
 }
 
@@ -1106,10 +1695,34 @@ void initialize_microenvironment( void )
 	if( default_microenvironment_options.simulate_2D == true )
 	{
 		microenvironment.diffusion_decay_solver = diffusion_decay_solver__constant_coefficients_LOD_2D; 
+		if( default_microenvironment_options.fuse_sources_and_sinks == true )
+		{ microenvironment.diffusion_decay_solver = diffusion_decay_source_sink_solver__constant_coefficients_LOD_2D; }
 	}
 	else
 	{
 		microenvironment.diffusion_decay_solver = diffusion_decay_solver__constant_coefficients_LOD_3D; 
+		if( default_microenvironment_options.fuse_sources_and_sinks == true )
+		{ microenvironment.diffusion_decay_solver = diffusion_decay_source_sink_solver__constant_coefficients_LOD_3D; }
+	}
+	if( default_microenvironment_options.variable_coefficients == true )
+	{
+		microenvironment.diffusion_decay_solver = diffusion_decay_solver__variable_coefficients_LOD_3D; 
+		if( default_microenvironment_options.simulate_2D == true )
+		{ microenvironment.diffusion_decay_solver = diffusion_decay_solver__variable_coefficients_LOD_2D; }
+		default_microenvironment_options.fuse_sources_and_sinks = false; 
+	}
+	if( default_microenvironment_options.adaptive_mesh_refinement == true )
+	{
+		microenvironment.diffusion_decay_solver = diffusion_decay_solver__adaptive_mesh_refinement; 
+		microenvironment.amr_refinement_ratio = default_microenvironment_options.amr_refinement_ratio; 
+		microenvironment.amr_buffer_distance = default_microenvironment_options.amr_buffer_distance; 
+		// the levels are solved separately, so the sources and sinks stay in their own step 
+		default_microenvironment_options.fuse_sources_and_sinks = false; 
+	}
+	if( default_microenvironment_options.quasi_steady_state_solver == true )
+	{
+		microenvironment.diffusion_decay_solver = diffusion_decay_solver__quasi_steady_state_multigrid; 
+		microenvironment.quasi_steady_state_interval = default_microenvironment_options.quasi_steady_state_interval; 
 	}
 	
 	// set the default substrate to oxygen (with typical units of mmHg)
@@ -1193,6 +1806,12 @@ void initialize_microenvironment( void )
 		microenvironment.set_substrate_dirichlet_activation( i , default_microenvironment_options.Dirichlet_activation_vector[i] ); 
 	}
 	
+	// and the substrates that need gradients 
+	for( unsigned int i=0 ; i < default_microenvironment_options.gradient_activation_vector.size(); i++ )
+	{
+		microenvironment.set_substrate_gradient_activation( i , default_microenvironment_options.gradient_activation_vector[i] ); 
+	}
+	
 	microenvironment.display_information( std::cout );
 	return;
 }
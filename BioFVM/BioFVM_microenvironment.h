@@ -49,14 +49,17 @@
 #ifndef __BioFVM_microenvironment_h__
 #define __BioFVM_microenvironment_h__
 
+#include <atomic>
+
 #include "BioFVM_mesh.h"
+#include "BioFVM_vector.h"
 #include "BioFVM_agent_container.h"
 #include "BioFVM_MultiCellDS.h"
 
 namespace BioFVM{
 
 /* and now some gradients */ 
-typedef std::vector<double> gradient; 
+typedef Vec3 gradient; 
 
 /*! /brief   */
 
@@ -82,8 +85,19 @@ class Microenvironment
 	/*! stores pointer to current density solutions. Access via operator() functions. */ 
 	std::vector< std::vector<double> >* p_density_vectors; 
 	
+	/*! gradients are computed on demand, the first time a voxel is queried 
+	    after the densities change. gradient_vector_computed holds the state of 
+	    each voxel (gradient_stale, gradient_computing or gradient_current), so 
+	    that agents can query gradients from parallel loops: one thread claims 
+	    the voxel and computes it, and the others wait until it is current. 
+	    gradient_voxels_computed lists the voxels that are current, so that 
+	    invalidate_gradient_vectors() only resets those. Substrates with 
+	    gradient_activation_vector[q] == false are skipped (their gradient is 0). */ 
 	std::vector< std::vector<gradient> > gradient_vectors; 
-	std::vector<bool> gradient_vector_computed; 
+	std::vector< std::atomic<char> > gradient_vector_computed; 
+	std::vector<int> gradient_voxels_computed; 
+	std::vector<bool> gradient_activation_vector; 
+	void clear_gradient_cache( void ); 
 
 	
 	/*! helpful for solvers -- resize these whenever adding/removing substrates */ 
@@ -118,15 +132,94 @@ class Microenvironment
 	std::vector< std::vector<double> > thomas_cz;
 	bool diffusion_solver_setup_done; 
 	
+	/*! flat copy of the densities for the LOD solvers: voxel-major, with each 
+	    voxel's substrates padded to thomas_stride doubles. The y- and z-sweeps 
+	    solve blocks of adjacent lines together, thomas_block_width doubles at a 
+	    time, so they stream through contiguous memory. */ 
+	aligned_vector thomas_densities; 
+	int thomas_stride; 
+	int thomas_block_width; 
+	/*! substrates the LOD solvers update (thomas_densities lane j is substrate 
+	    solver_substrates[j]), and the inert ones (diffusion coefficient and 
+	    decay rate 0) that they skip */ 
+	std::vector<int> solver_substrates; 
+	std::vector<int> inert_substrates; 
+	/*! Thomas coefficients repeated across a block, [ i*thomas_block_width + lane ]. 
+	    Padding lanes have constant1 = 0, denom = 1, c = 0, so they stay 0. */ 
+	aligned_vector thomas_block_constant1; 
+	aligned_vector thomas_block_denomx; 
+	aligned_vector thomas_block_cx; 
+	aligned_vector thomas_block_denomy; 
+	aligned_vector thomas_block_cy; 
+	aligned_vector thomas_block_denomz; 
+	aligned_vector thomas_block_cz; 
+	void setup_solver_buffer( void ); // call after the thomas_denom* / thomas_c* are set 
+	bool substrate_is_inert( int substrate_index ); // no diffusion or decay anywhere
+	
+	/*! Thomas factorizations for the variable-coefficient LOD solvers: for
+	    each step of each line, lower = dt*D/dx^2 on the face before the step,
+	    and 1/denom (the solvers form c from the next step's lower). The y- and
+	    z-tables have the layout of thomas_densities; 
+	    the x-table has the interleaved layout the x-sweep solves in,
+	    [ ( block*nx + i )*thomas_block_width + lane ]. They are recomputed only
+	    when the coefficient fields (or dt) change. */
+	aligned_vector thomas_line_lowerx; 
+	aligned_vector thomas_line_inverse_denomx; 
+	aligned_vector thomas_line_lowery; 
+	aligned_vector thomas_line_inverse_denomy; 
+	aligned_vector thomas_line_lowerz; 
+	aligned_vector thomas_line_inverse_denomz; 
+	bool coefficient_fields_out_of_date; 
+	double thomas_line_dt; // time step of the current factorizations
+	void setup_variable_coefficient_factorizations( double dt , int dimensions ); 
+	
+	/*! for the quasi-steady multigrid solver: per level (0 is the mesh itself), 
+	    the size { nx, ny, nz }, voxel spacing, unknowns, right-hand sides, 
+	    reaction coefficients, residuals and fixed (Dirichlet) voxels of the 
+	    substrate being solved. The agents' secretion and uptake rates are packed 
+	    as [ voxel*number_of_densities() + substrate ]. */ 
+	std::vector< std::vector<int> > multigrid_sizes; 
+	std::vector< std::vector<double> > multigrid_spacings; 
+	std::vector< std::vector<double> > multigrid_u; 
+	std::vector< std::vector<double> > multigrid_f; 
+	std::vector< std::vector<double> > multigrid_c; 
+	std::vector< std::vector<double> > multigrid_r; 
+	std::vector< std::vector<char> > multigrid_pinned; 
+	std::vector<double> multigrid_cell_sources; 
+	std::vector<double> multigrid_cell_uptakes; 
+	double multigrid_elapsed_time; 
+	
+	/*! for the adaptive mesh refinement solver: the coarse level has amr_ratio 
+	    voxels (per direction, but not in z in 2-D) in each coarse voxel, and the 
+	    patch is the coarse voxels in amr_patch_box = { i_min, j_min, k_min, 
+	    i_max, j_max, k_max }, at full resolution. Both keep the substrates of 
+	    each voxel together. */ 
+	int amr_ratio; 
+	std::vector<double> amr_coarse_densities; 
+	std::vector<double> amr_patch_densities; 
+	std::vector<int> amr_patch_box; 
+	
 	// on "resize density" type operations, need to extend all of these 
 	
-	/*
+	/*! Dirichlet nodes: their voxel indices, node m's values packed at 
+	    dirichlet_values[ m*number_of_densities() + substrate ], and a map from 
+	    voxel index to m (-1 if not a Dirichlet node). Maintained by 
+	    add_dirichlet_node(), update_dirichlet_node() and remove_dirichlet_node(). */ 
 	std::vector<int> dirichlet_indices; 
-	std::vector< std::vector<double> > dirichlet_value_vectors; 
-	std::vector<bool> dirichlet_node_map; 
-	*/
-	std::vector< std::vector<double> > dirichlet_value_vectors; 
+	std::vector<double> dirichlet_values; 
+	std::vector<int> dirichlet_node_map; 
 	std::vector<bool> dirichlet_activation_vector; 	
+	
+	/*! Dirichlet nodes grouped by the LOD solver block that contains them, for 
+	    each sweep direction (0: x, 1: y, 2: z), so that each block applies its 
+	    own nodes just before it is solved: the nodes of block b in direction d 
+	    are dirichlet_nodes_by_block[d][ dirichlet_block_start[d][b] ] through 
+	    dirichlet_nodes_by_block[d][ dirichlet_block_start[d][b+1]-1 ]. */ 
+	std::vector< std::vector<int> > dirichlet_block_start; 
+	std::vector< std::vector<int> > dirichlet_nodes_by_block; 
+	bool dirichlet_blocks_out_of_date; 
+	void sort_dirichlet_nodes_by_block( void ); 
+	void apply_dirichlet_node_to_solver_buffer( int m ); 
  public:
 	
 	/*! The mesh for the diffusing quantities */ 
@@ -144,6 +237,17 @@ class Microenvironment
 	std::vector< double > diffusion_coefficients; 
 	std::vector< double > decay_rates; 
 	
+	/*! spatially varying coefficients for the variable-coefficient solvers,
+	    [voxel][substrate]. If they do not match the mesh and substrates, the
+	    solver fills them from diffusion_coefficients and decay_rates. After
+	    changing them directly, call coefficient_fields_changed(). */
+	std::vector< std::vector<double> > diffusion_coefficient_field; 
+	std::vector< std::vector<double> > decay_rate_field; 
+	void initialize_coefficient_fields( void ); // no-op if they already match
+	void coefficient_fields_changed( void ); 
+	void set_diffusion_coefficient( int voxel_index , int substrate_index , double new_value ); 
+	void set_decay_rate( int voxel_index , int substrate_index , double new_value ); 
+	
 	std::vector< std::vector<double> > supply_target_densities_times_supply_rates; 
 	std::vector< std::vector<double> > supply_rates; 
 	std::vector< std::vector<double> > uptake_rates; 
@@ -188,10 +292,14 @@ class Microenvironment
 	std::vector<unsigned int> cartesian_indices( int n ); 
 	
 	int nearest_voxel_index( std::vector<double>& position ); 
+	int nearest_voxel_index( const Vec3& position ); 
 	std::vector<unsigned int> nearest_cartesian_indices( std::vector<double>& position ); 
+	std::vector<unsigned int> nearest_cartesian_indices( const Vec3& position ); 
 	Voxel& nearest_voxel( std::vector<double>& position ); 
+	Voxel& nearest_voxel( const Vec3& position ); 
 	Voxel& voxels( int voxel_index );
 	std::vector<double>& nearest_density_vector( std::vector<double>& position );  
+	std::vector<double>& nearest_density_vector( const Vec3& position );  
 	std::vector<double>& nearest_density_vector( int voxel_index );  
 
 	/*! access the density vector at  [ X(i),Y(j),Z(k) ] */
@@ -206,10 +314,16 @@ class Microenvironment
 	std::vector<gradient>& gradient_vector(int n );  
 	
 	std::vector<gradient>& nearest_gradient_vector( std::vector<double>& position ); 
+	std::vector<gradient>& nearest_gradient_vector( const Vec3& position ); 
 
 	void compute_all_gradient_vectors( void ); 
 	void compute_gradient_vector( int n );  
 	void reset_all_gradient_vectors( void ); 
+	// mark all gradients as out of date (called whenever the solvers change the densities) 
+	void invalidate_gradient_vectors( void ); 
+	
+	void set_substrate_gradient_activation( int substrate_index , bool new_value ); 
+	bool get_substrate_gradient_activation( int substrate_index ); 
 	
 	/*! access the density vector at  [ X(i),Y(j),Z(k) ] */
 	std::vector<double>& density_vector( int i, int j, int k ); 
@@ -229,6 +343,41 @@ class Microenvironment
 	// use the global list of cells 
 	void simulate_cell_sources_and_sinks( double dt ); 
 	
+	/*! fused source/sink step, used by the diffusion_decay_source_sink_solver__ 
+	    solvers: one pass over the voxels that copies the solution back from the 
+	    solver buffer (if copy_from_solver_buffer), then applies the bulk supply / 
+	    uptake precomputed by update_rates() (if it has been called), then calls 
+	    agent_source_sink_function on each agent in the voxel, in list order. */ 
+	void apply_fused_sources_and_sinks( double dt , bool copy_from_solver_buffer ); 
+	/*! true if the last simulate_diffusion_decay() call already applied the agents' 
+	    sources and sinks (set by the solver that did it, so a solver that returns 
+	    early, or a custom solver, leaves it false and the caller does it instead) */ 
+	bool solver_applied_cell_sources_and_sinks; 
+	void (*agent_source_sink_function)( Basic_Agent* pAgent, Microenvironment* pMicroenvironment, double dt ); 
+
+	/*! for the quasi-steady solver: adds each agent's secretion and uptake, as 
+	    rates in its voxel, to sources[] and uptakes[] (one entry per substrate) */ 
+	void (*agent_source_sink_rates_function)( Basic_Agent* pAgent, Microenvironment* pMicroenvironment, double dt , double* sources , double* uptakes ); 
+	double quasi_steady_state_interval; // time between steady-state solves 
+	double quasi_steady_state_tolerance; // on the residual, relative to the largest term 
+
+	// for the adaptive mesh refinement solver 
+	int amr_refinement_ratio; // voxels per coarse voxel, in each direction 
+	double amr_buffer_distance; // resolved distance around the agents 
+	
+	/*! agents grouped by their current voxel (stable counting sort). Agents in
+	    voxel occupied_voxels[n] are agents_by_voxel[ agents_by_voxel_start[n] ]
+	    through agents_by_voxel[ agents_by_voxel_start[n+1]-1 ], in list order.
+	    Threads that each own a voxel can then write to the density vectors
+	    without races, and get the same answer as a serial run. The sort's 
+	    per-voxel counts are sized with the mesh, and are zero between sorts. */
+	std::vector<int> occupied_voxels;
+	std::vector<int> agents_by_voxel_start;
+	std::vector<int> agents_by_voxel;
+	std::vector<int> agents_outside_mesh;
+	std::vector<int> agent_counts_by_voxel;
+	void sort_agents_by_voxel( std::vector<Basic_Agent*>& basic_agent_list );
+	
 	void display_information( std::ostream& os ); 
 	
 	void add_dirichlet_node( int voxel_index, std::vector<double>& value ); 
@@ -237,16 +386,29 @@ class Microenvironment
 	void remove_dirichlet_node( int voxel_index ); 
 	void apply_dirichlet_conditions( void ); 
 
+	// move the densities to / from the flat buffer used by the LOD solvers 
+	void copy_densities_to_solver_buffer( void ); 
+	void copy_densities_from_solver_buffer( void ); 
+	void apply_dirichlet_conditions_to_solver_buffer( void ); 
+	void apply_dirichlet_conditions_to_solver_block( int direction , int block ); 
+	void apply_dirichlet_conditions_to_inert_substrates( void ); 
+
 	void set_substrate_dirichlet_activation( int substrate_index , bool new_value ); 
 	double get_substrate_dirichlet_activation( int substrate_index ); 
 	
-	bool& is_dirichlet_node( int voxel_index ); 
+	bool is_dirichlet_node( int voxel_index ); // to change it, use add_ / remove_dirichlet_node 
 
 	friend void diffusion_decay_solver__constant_coefficients_explicit( Microenvironment& S, double dt ); 
 	friend void diffusion_decay_solver__constant_coefficients_explicit_uniform_mesh( Microenvironment& S, double dt ); 
 
 	friend void diffusion_decay_solver__constant_coefficients_LOD_3D( Microenvironment& S, double dt ); 
 	friend void diffusion_decay_solver__constant_coefficients_LOD_2D( Microenvironment& S, double dt ); 
+	friend void constant_coefficients_LOD_3D( Microenvironment& S, double dt , bool fused_sources_and_sinks ); 
+	friend void constant_coefficients_LOD_2D( Microenvironment& S, double dt , bool fused_sources_and_sinks ); 
+	friend void variable_coefficients_LOD( Microenvironment& S, double dt , int dimensions ); 
+	friend void LOD_sweeps( Microenvironment& S, double* densities , int dimensions , bool variable_coefficients ); 
+	friend void diffusion_decay_solver__quasi_steady_state_multigrid( Microenvironment& S, double dt ); 
+	friend void diffusion_decay_solver__adaptive_mesh_refinement( Microenvironment& S, double dt ); 
 	
 	friend void diffusion_decay_explicit_uniform_rates( Microenvironment& M, double dt );
 	
@@ -273,11 +435,16 @@ extern void diffusion_decay_solver__variable_coefficients_LOD_3D( Microenvironme
 extern void diffusion_decay_solver__variable_coefficients_LOD_2D( Microenvironment& S, double dt ); 
 
 extern void diffusion_decay_source_sink_solver__constant_coefficients_LOD_3D( Microenvironment& S, double dt );
+extern void diffusion_decay_source_sink_solver__constant_coefficients_LOD_2D( Microenvironment& S, double dt );
 
 void zero_function( std::vector<double>& position, std::vector<double>& input , std::vector<double>* destination );
 void one_function( std::vector<double>& position, std::vector<double>& input , std::vector<double>* destination );
 
 void zero_function( Microenvironment* pMicroenvironment, int voxel_index, std::vector<double>* write_destination );
+// default agent_source_sink_function: Basic_Agent::simulate_secretion_and_uptake 
+void standard_agent_source_sink_function( Basic_Agent* pAgent, Microenvironment* pMicroenvironment, double dt ); 
+// default agent_source_sink_rates_function: Basic_Agent::add_source_sink_rates 
+void standard_agent_source_sink_rates_function( Basic_Agent* pAgent, Microenvironment* pMicroenvironment, double dt , double* sources , double* uptakes ); 
 void one_function( Microenvironment* pMicroenvironment, int voxel_index, std::vector<double>* write_destination );
 
 void set_default_microenvironment( Microenvironment* M );
@@ -310,11 +477,27 @@ class Microenvironment_Options
 	
 	Microenvironment_Options(); 
 	
-	bool calculate_gradients; 
+	bool calculate_gradients; // no longer needed: gradients are computed on demand 
+	std::vector<bool> gradient_activation_vector; 
 	
 	bool use_oxygen_as_first_field;
 	
 	bool track_internalized_substrates_in_each_agent; 	
+	
+	// use the fused diffusion-decay-source/sink LOD solvers 
+	bool fuse_sources_and_sinks; 
+	
+	// use the quasi-steady multigrid solver, re-solved every quasi_steady_state_interval 
+	bool quasi_steady_state_solver; 
+	double quasi_steady_state_interval; 
+	
+	// use the adaptive mesh refinement solver 
+	bool adaptive_mesh_refinement; 
+	int amr_refinement_ratio; 
+	double amr_buffer_distance; 
+	
+	// use the variable-coefficient LOD solvers (spatially varying diffusion and decay)
+	bool variable_coefficients; 
 };
 
 extern Microenvironment_Options default_microenvironment_options; 
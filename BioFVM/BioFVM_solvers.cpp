@@ -48,12 +48,216 @@
 
 #include "BioFVM_solvers.h" 
 #include "BioFVM_vector.h" 
+#include "BioFVM_basic_agent.h" 
 
 #include <iostream>
+#include <algorithm>
+#include <cmath>
 #include <omp.h>
 
 namespace BioFVM{
 
+// Thomas algorithm (with the pre-computed LOD coefficients) on "lanes" 
+// independent tridiagonal systems. Entry ( step, lane ) is at 
+// d[ step*jump + lane ], and its coefficients at [ step*table_width + lane ]. 
+// A block of adjacent y- or z-lines has all their substrates as lanes, so 
+// each step updates one contiguous run of memory. 
+static void thomas_solve_generic_lines( double* d , int length , int jump , int lanes , int table_width , 
+	const double* constant1 , const double* denom , const double* c )
+{
+	// remaining part of forward elimination, using pre-computed quantities 
+	for( int lane=0; lane < lanes; lane++ )
+	{ d[lane] /= denom[lane]; }
+
+	for( int step=1; step < length; step++ )
+	{
+		double* d_step = d + step*jump; 
+		const double* d_previous = d_step - jump; 
+		const double* denom_step = denom + step*table_width; 
+		for( int lane=0; lane < lanes; lane++ )
+		{ d_step[lane] = ( d_step[lane] + constant1[lane]*d_previous[lane] ) / denom_step[lane]; }
+	}
+
+	// back substitution 
+	for( int step=length-2; step >= 0; step-- )
+	{
+		double* d_step = d + step*jump; 
+		const double* d_next = d_step + jump; 
+		const double* c_step = c + step*table_width; 
+		for( int lane=0; lane < lanes; lane++ )
+		{ d_step[lane] -= c_step[lane]*d_next[lane]; }
+	}
+	return; 
+}
+
+// The same for a full block, where the lane count is a compile-time constant 
+// equal to the table width. The values carried from step to step stay in a 
+// local array (registers), and each step is a fixed number of whole SIMD 
+// vectors (four with AVX-512, eight with AVX2), with no remainder loop and no 
+// runtime alias checks. 
+template <int LANES> 
+static void thomas_solve_full_block( double* d , int length , int jump , 
+	const double* constant1 , const double* denom , const double* c )
+{
+	double carried[LANES]; 
+
+	for( int lane=0; lane < LANES; lane++ )
+	{
+		carried[lane] = d[lane] / denom[lane]; 
+		d[lane] = carried[lane]; 
+	}
+
+	for( int step=1; step < length; step++ )
+	{
+		double* d_step = d + step*jump; 
+		const double* denom_step = denom + step*LANES; 
+		for( int lane=0; lane < LANES; lane++ )
+		{
+			carried[lane] = ( d_step[lane] + constant1[lane]*carried[lane] ) / denom_step[lane]; 
+			d_step[lane] = carried[lane]; 
+		}
+	}
+
+	// back substitution: carried holds the last step 
+	for( int step=length-2; step >= 0; step-- )
+	{
+		double* d_step = d + step*jump; 
+		const double* c_step = c + step*LANES; 
+		for( int lane=0; lane < LANES; lane++ )
+		{
+			carried[lane] = d_step[lane] - c_step[lane]*carried[lane]; 
+			d_step[lane] = carried[lane]; 
+		}
+	}
+	return; 
+}
+
+static void thomas_solve_lines( double* d , int length , int jump , int lanes , int table_width , 
+	const double* constant1 , const double* denom , const double* c )
+{
+	if( lanes == 32 && table_width == 32 )
+	{ thomas_solve_full_block<32>( d , length , jump , constant1 , denom , c ); }
+	else
+	{ thomas_solve_generic_lines( d , length , jump , lanes , table_width , constant1 , denom , c ); }
+	return; 
+}
+
+// The same with coefficients that vary along the lines and from line to line
+// (variable-coefficient LOD): entry ( step, lane ) has its own lower and
+// 1/denom, at [ step*table_jump + lane ]. The upper coefficient c of a step is
+// -lower( step+1 ) / denom( step ), formed in the back substitution. 
+static void thomas_solve_variable_generic_lines( double* d , int length , int jump , int lanes , int table_jump , 
+	const double* lower , const double* inverse_denom )
+{
+	for( int lane=0; lane < lanes; lane++ )
+	{ d[lane] *= inverse_denom[lane]; }
+
+	for( int step=1; step < length; step++ )
+	{
+		double* d_step = d + step*jump; 
+		const double* d_previous = d_step - jump; 
+		const double* lower_step = lower + step*table_jump; 
+		const double* inverse_denom_step = inverse_denom + step*table_jump; 
+		for( int lane=0; lane < lanes; lane++ )
+		{ d_step[lane] = ( d_step[lane] + lower_step[lane]*d_previous[lane] ) * inverse_denom_step[lane]; }
+	}
+
+	for( int step=length-2; step >= 0; step-- )
+	{
+		double* d_step = d + step*jump; 
+		const double* d_next = d_step + jump; 
+		const double* lower_next = lower + (step+1)*table_jump; 
+		const double* inverse_denom_step = inverse_denom + step*table_jump; 
+		for( int lane=0; lane < lanes; lane++ )
+		{ d_step[lane] += lower_next[lane]*inverse_denom_step[lane]*d_next[lane]; }
+	}
+	return; 
+}
+
+template <int LANES> 
+static void thomas_solve_variable_full_block( double* d , int length , int jump , int table_jump , 
+	const double* lower , const double* inverse_denom )
+{
+	double carried[LANES]; 
+
+	for( int lane=0; lane < LANES; lane++ )
+	{
+		carried[lane] = d[lane] * inverse_denom[lane]; 
+		d[lane] = carried[lane]; 
+	}
+
+	for( int step=1; step < length; step++ )
+	{
+		double* d_step = d + step*jump; 
+		const double* lower_step = lower + step*table_jump; 
+		const double* inverse_denom_step = inverse_denom + step*table_jump; 
+		for( int lane=0; lane < LANES; lane++ )
+		{
+			carried[lane] = ( d_step[lane] + lower_step[lane]*carried[lane] ) * inverse_denom_step[lane]; 
+			d_step[lane] = carried[lane]; 
+		}
+	}
+
+	for( int step=length-2; step >= 0; step-- )
+	{
+		double* d_step = d + step*jump; 
+		const double* lower_next = lower + (step+1)*table_jump; 
+		const double* inverse_denom_step = inverse_denom + step*table_jump; 
+		for( int lane=0; lane < LANES; lane++ )
+		{
+			carried[lane] = d_step[lane] + lower_next[lane]*inverse_denom_step[lane]*carried[lane]; 
+			d_step[lane] = carried[lane]; 
+		}
+	}
+	return; 
+}
+
+static void thomas_solve_variable_lines( double* d , int length , int jump , int lanes , int table_jump , 
+	const double* lower , const double* inverse_denom )
+{
+	if( lanes == 32 )
+	{ thomas_solve_variable_full_block<32>( d , length , jump , table_jump , lower , inverse_denom ); }
+	else
+	{ thomas_solve_variable_generic_lines( d , length , jump , lanes , table_jump , lower , inverse_denom ); }
+	return; 
+}
+
+// x-lines are contiguous, so adjacent ones are far apart. Copy a block of 
+// lines (first_voxel, first_voxel + line_jump, ... ) into scratch, interleaved 
+// as [ i*width + line*stride + substrate ], and back. 
+static void copy_x_block_to_scratch( const double* densities , double* scratch , int first_voxel , int lines , int line_jump , 
+	int length , int stride , int width )
+{
+	for( int line=0; line < lines; line++ )
+	{
+		const double* pLine = densities + ( first_voxel + line*line_jump )*stride; 
+		double* pScratch = scratch + line*stride; 
+		for( int i=0; i < length; i++ )
+		{
+			for( int s=0; s < stride; s++ )
+			{ pScratch[ i*width + s ] = pLine[ i*stride + s ]; }
+		}
+	}
+	return; 
+}
+
+static void copy_x_block_from_scratch( double* densities , const double* scratch , int first_voxel , int lines , int line_jump , 
+	int length , int stride , int width )
+{
+	for( int line=0; line < lines; line++ )
+	{
+		double* pLine = densities + ( first_voxel + line*line_jump )*stride; 
+		const double* pScratch = scratch + line*stride; 
+		for( int i=0; i < length; i++ )
+		{
+			for( int s=0; s < stride; s++ )
+			{ pLine[ i*stride + s ] = pScratch[ i*width + s ]; }
+		}
+	}
+	return; 
+}
+
+
 // do I even need this? 
 void diffusion_decay_solver__constant_coefficients_explicit( Microenvironment& M, double dt )
 {
@@ -93,7 +297,107 @@ void diffusion_decay_solver__constant_coefficients_explicit_uniform_mesh( Microe
 	return; 
 }
 
-void diffusion_decay_solver__constant_coefficients_LOD_3D( Microenvironment& M, double dt )
+// The sweeps of the LOD solvers on the flat buffer (densities is 
+// M.thomas_densities), with the constant coefficients' block tables, or each line's own 
+// factorization (variable_coefficients). In 2-D there is no z-sweep. 
+
+void LOD_sweeps( Microenvironment& M, double* densities , int dimensions , bool variable_coefficients )
+{
+	int nx = M.mesh.x_coordinates.size(); 
+	int ny = M.mesh.y_coordinates.size(); 
+	int nz = M.mesh.z_coordinates.size(); 
+	int stride = M.thomas_stride; 
+	int width = M.thomas_block_width; 
+	int lines_per_block = width / stride; 
+	int x_blocks = ( nx + lines_per_block - 1 ) / lines_per_block; 
+	int y_blocks = ( ny + lines_per_block - 1 ) / lines_per_block; 
+	
+	#pragma omp parallel 
+	{
+		aligned_vector scratch( nx * width ); 
+		
+		// x-diffusion: blocks of lines that are adjacent in y, gathered into the 
+		// (double) scratch. Each block first applies the Dirichlet nodes it contains. 
+		
+		#pragma omp for 
+		for( int b=0; b < nz * y_blocks ; b++ )
+		{
+			int k = b / y_blocks; 
+			int j = ( b % y_blocks ) * lines_per_block; 
+			int lines = std::min( lines_per_block , ny - j ); 
+			M.apply_dirichlet_conditions_to_solver_block( 0 , b ); 
+			copy_x_block_to_scratch( densities , scratch.data() , M.voxel_index(0,j,k) , lines , M.thomas_j_jump , nx , stride , width ); 
+			if( variable_coefficients )
+			{
+				int offset = b*nx*width; 
+				thomas_solve_variable_lines( scratch.data() , nx , width , lines*stride , width , 
+					M.thomas_line_lowerx.data() + offset , M.thomas_line_inverse_denomx.data() + offset ); 
+			}
+			else
+			{
+				thomas_solve_lines( scratch.data() , nx , width , lines*stride , width , 
+					M.thomas_block_constant1.data() , M.thomas_block_denomx.data() , M.thomas_block_cx.data() ); 
+			}
+			copy_x_block_from_scratch( densities , scratch.data() , M.voxel_index(0,j,k) , lines , M.thomas_j_jump , nx , stride , width ); 
+		}
+		
+		// y-diffusion: blocks of lines that are adjacent in x 
+		
+		#pragma omp for 
+		for( int b=0; b < nz * x_blocks ; b++ )
+		{
+			int k = b / x_blocks; 
+			int i = ( b % x_blocks ) * lines_per_block; 
+			int lines = std::min( lines_per_block , nx - i ); 
+			int offset = M.voxel_index(i,0,k)*stride; 
+			M.apply_dirichlet_conditions_to_solver_block( 1 , b ); 
+			if( variable_coefficients )
+			{
+				thomas_solve_variable_lines( densities + offset , ny , M.thomas_j_jump*stride , lines*stride , M.thomas_j_jump*stride ,
+					M.thomas_line_lowery.data() + offset , M.thomas_line_inverse_denomy.data() + offset ); 
+			}
+			else
+			{
+				thomas_solve_lines( densities + offset , ny , M.thomas_j_jump*stride , lines*stride , width ,
+					M.thomas_block_constant1.data() , M.thomas_block_denomy.data() , M.thomas_block_cy.data() ); 
+			}
+		}
+		
+		// z-diffusion: blocks of lines that are adjacent in x 
+		
+		if( dimensions == 3 )
+		{
+			#pragma omp for 
+			for( int b=0; b < ny * x_blocks ; b++ )
+			{
+				int j = b / x_blocks; 
+				int i = ( b % x_blocks ) * lines_per_block; 
+				int lines = std::min( lines_per_block , nx - i ); 
+				int offset = M.voxel_index(i,j,0)*stride; 
+				M.apply_dirichlet_conditions_to_solver_block( 2 , b ); 
+				if( variable_coefficients )
+				{
+					thomas_solve_variable_lines( densities + offset , nz , M.thomas_k_jump*stride , lines*stride , M.thomas_k_jump*stride ,
+						M.thomas_line_lowerz.data() + offset , M.thomas_line_inverse_denomz.data() + offset ); 
+				}
+				else
+				{
+					thomas_solve_lines( densities + offset , nz , M.thomas_k_jump*stride , lines*stride , width ,
+						M.thomas_block_constant1.data() , M.thomas_block_denomz.data() , M.thomas_block_cz.data() ); 
+				}
+			}
+		}
+	}
+	return; 
+}
+
+// The LOD solvers. With fused_sources_and_sinks, the last pass over the mesh 
+// (copying the solution back from the solver buffer) also applies the bulk 
+// and cell sources and sinks; see Microenvironment::apply_fused_sources_and_sinks. 
+// If they return early (e.g., on a non-uniform mesh), nothing is applied, and 
+// solver_applied_cell_sources_and_sinks stays false for the usual pass. 
+
+void constant_coefficients_LOD_3D( Microenvironment& M, double dt , bool fused_sources_and_sinks )
 {
 	if( M.mesh.uniform_mesh == false || M.mesh.Cartesian_mesh == false )
 	{
@@ -188,110 +492,34 @@ void diffusion_decay_solver__constant_coefficients_LOD_3D( Microenvironment& M,
 			M.thomas_cz[i] /= M.thomas_denomz[i]; // the value at  size-1 is not actually used  
 		}	
 
+		M.setup_solver_buffer(); 
 		M.diffusion_solver_setup_done = true; 
 	}
 
-	// x-diffusion 
+	// inert substrates only need their Dirichlet conditions 
 	
-	M.apply_dirichlet_conditions();
-	#pragma omp parallel for 
-	for( unsigned int k=0; k < M.mesh.z_coordinates.size() ; k++ )
+	if( M.solver_substrates.size() == 0 )
 	{
-		for( unsigned int j=0; j < M.mesh.y_coordinates.size() ; j++ )
-		{
-			// Thomas solver, x-direction
-
-			// remaining part of forward elimination, using pre-computed quantities 
-			int n = M.voxel_index(0,j,k);
-			(*M.p_density_vectors)[n] /= M.thomas_denomx[0]; 
-
-			for( unsigned int i=1; i < M.mesh.x_coordinates.size() ; i++ )
-			{
-				n = M.voxel_index(i,j,k); 
-				axpy( &(*M.p_density_vectors)[n] , M.thomas_constant1 , (*M.p_density_vectors)[n-M.thomas_i_jump] ); 
-				(*M.p_density_vectors)[n] /= M.thomas_denomx[i]; 
-			}
-
-			for( int i = M.mesh.x_coordinates.size()-2 ; i >= 0 ; i-- )
-			{
-				n = M.voxel_index(i,j,k); 
-				naxpy( &(*M.p_density_vectors)[n] , M.thomas_cx[i] , (*M.p_density_vectors)[n+M.thomas_i_jump] ); 
-			}
-
-		}
-	}
-
-	// y-diffusion 
-
-	M.apply_dirichlet_conditions();
-	#pragma omp parallel for 
-	for( unsigned int k=0; k < M.mesh.z_coordinates.size() ; k++ )
-	{
-		for( unsigned int i=0; i < M.mesh.x_coordinates.size() ; i++ )
-		{
-   // Thomas solver, y-direction
-
-	// remaining part of forward elimination, using pre-computed quantities 
-
-	int n = M.voxel_index(i,0,k);
-	(*M.p_density_vectors)[n] /= M.thomas_denomy[0]; 
-
-	for( unsigned int j=1; j < M.mesh.y_coordinates.size() ; j++ )
-	{
-		n = M.voxel_index(i,j,k); 
-		axpy( &(*M.p_density_vectors)[n] , M.thomas_constant1 , (*M.p_density_vectors)[n-M.thomas_j_jump] ); 
-		(*M.p_density_vectors)[n] /= M.thomas_denomy[j]; 
-	}
-
-	// back substitution 
-	// n = voxel_index( mesh.x_coordinates.size()-2 ,j,k); 
-
-	for( int j = M.mesh.y_coordinates.size()-2 ; j >= 0 ; j-- )
-	{
-		n = M.voxel_index(i,j,k); 
-		naxpy( &(*M.p_density_vectors)[n] , M.thomas_cy[j] , (*M.p_density_vectors)[n+M.thomas_j_jump] ); 
-	}
-
-  }
- }
-
- // z-diffusion 
-
-	M.apply_dirichlet_conditions();
- #pragma omp parallel for 
- for( unsigned int j=0; j < M.mesh.y_coordinates.size() ; j++ )
- {
-	 
-  for( unsigned int i=0; i < M.mesh.x_coordinates.size() ; i++ )
-  {
-   // Thomas solver, y-direction
-
-	// remaining part of forward elimination, using pre-computed quantities 
-
-	int n = M.voxel_index(i,j,0);
-	(*M.p_density_vectors)[n] /= M.thomas_denomz[0]; 
-
-	// should be an empty loop if mesh.z_coordinates.size() < 2  
-	for( unsigned int k=1; k < M.mesh.z_coordinates.size() ; k++ )
-	{
-		n = M.voxel_index(i,j,k); 
-		axpy( &(*M.p_density_vectors)[n] , M.thomas_constant1 , (*M.p_density_vectors)[n-M.thomas_k_jump] ); 
-		(*M.p_density_vectors)[n] /= M.thomas_denomz[k]; 
-	}
-
-	// back substitution 
-
-	// should be an empty loop if mesh.z_coordinates.size() < 2 
-	for( int k = M.mesh.z_coordinates.size()-2 ; k >= 0 ; k-- )
-	{
-		n = M.voxel_index(i,j,k); 
-		naxpy( &(*M.p_density_vectors)[n] , M.thomas_cz[k] , (*M.p_density_vectors)[n+M.thomas_k_jump] ); 
-		// n -= i_jump; 
+		M.apply_dirichlet_conditions_to_inert_substrates(); 
+		if( fused_sources_and_sinks )
+		{ M.apply_fused_sources_and_sinks( dt , false ); }
+		return; 
 	}
-  }
- }
- 
-	M.apply_dirichlet_conditions();
+	
+	// the sweeps run on the flat copy of the densities 
+	
+	M.copy_densities_to_solver_buffer(); 
+	if( M.dirichlet_blocks_out_of_date )
+	{ M.sort_dirichlet_nodes_by_block(); }
+	
+	LOD_sweeps( M , M.thomas_densities.data() , 3 , false ); 
+
+	M.apply_dirichlet_conditions_to_solver_buffer();
+	M.apply_dirichlet_conditions_to_inert_substrates(); 
+	if( fused_sources_and_sinks )
+	{ M.apply_fused_sources_and_sinks( dt , true ); }
+	else
+	{ M.copy_densities_from_solver_buffer(); }
 	
 	// reset gradient vectors 
 //	M.reset_all_gradient_vectors(); 
@@ -299,7 +527,13 @@ void diffusion_decay_solver__constant_coefficients_LOD_3D( Microenvironment& M,
 	return; 
 }
 
-void diffusion_decay_solver__constant_coefficients_LOD_2D( Microenvironment& M, double dt )
+void diffusion_decay_solver__constant_coefficients_LOD_3D( Microenvironment& M, double dt )
+{ constant_coefficients_LOD_3D( M , dt , false ); }
+
+void diffusion_decay_source_sink_solver__constant_coefficients_LOD_3D( Microenvironment& M, double dt )
+{ constant_coefficients_LOD_3D( M , dt , true ); }
+
+void constant_coefficients_LOD_2D( Microenvironment& M, double dt , bool fused_sources_and_sinks )
 {
 	if( M.mesh.uniform_mesh == false )
 	{
@@ -377,80 +611,99 @@ void diffusion_decay_solver__constant_coefficients_LOD_2D( Microenvironment& M,
 			M.thomas_cy[i] /= M.thomas_denomy[i]; // the value at  size-1 is not actually used  
 		}
 
+		M.setup_solver_buffer(); 
 		M.diffusion_solver_setup_done = true; 
 	}
 
-	// set the pointer
+	// inert substrates only need their Dirichlet conditions 
 	
-	M.apply_dirichlet_conditions();
-
-	// x-diffusion 
-	#pragma omp parallel for 
-	for( unsigned int j=0; j < M.mesh.y_coordinates.size() ; j++ )
+	if( M.solver_substrates.size() == 0 )
 	{
-		// Thomas solver, x-direction
+		M.apply_dirichlet_conditions_to_inert_substrates(); 
+		if( fused_sources_and_sinks )
+		{ M.apply_fused_sources_and_sinks( dt , false ); }
+		return; 
+	}
+	
+	// the sweeps run on the flat copy of the densities 
+	
+	M.copy_densities_to_solver_buffer(); 
+	if( M.dirichlet_blocks_out_of_date )
+	{ M.sort_dirichlet_nodes_by_block(); }
+	
+	LOD_sweeps( M , M.thomas_densities.data() , 2 , false ); 
+
+	M.apply_dirichlet_conditions_to_solver_buffer();
+	M.apply_dirichlet_conditions_to_inert_substrates(); 
+	if( fused_sources_and_sinks )
+	{ M.apply_fused_sources_and_sinks( dt , true ); }
+	else
+	{ M.copy_densities_from_solver_buffer(); }
+	
+	// reset gradient vectors 
+//	M.reset_all_gradient_vectors(); 
+	
+	return; 
+}
 
-		// remaining part of forward elimination, using pre-computed quantities 
-		unsigned int n = M.voxel_index(0,j,0);
-		(*M.p_density_vectors)[n] /= M.thomas_denomx[0]; 
+void diffusion_decay_solver__constant_coefficients_LOD_2D( Microenvironment& M, double dt )
+{ constant_coefficients_LOD_2D( M , dt , false ); }
 
-		n += M.thomas_i_jump; 
-		for( unsigned int i=1; i < M.mesh.x_coordinates.size() ; i++ )
-		{
-			axpy( &(*M.p_density_vectors)[n] , M.thomas_constant1 , (*M.p_density_vectors)[n-M.thomas_i_jump] ); 
-			(*M.p_density_vectors)[n] /= M.thomas_denomx[i]; 
-			n += M.thomas_i_jump; 
-		}
+void diffusion_decay_source_sink_solver__constant_coefficients_LOD_2D( Microenvironment& M, double dt )
+{ constant_coefficients_LOD_2D( M , dt , true ); }
 
-		// back substitution 
-		n = M.voxel_index( M.mesh.x_coordinates.size()-2 ,j,0); 
+// The variable-coefficient LOD solvers: the same sweeps, with each line's own
+// Thomas factorization (see Microenvironment::setup_variable_coefficient_factorizations),
+// recomputed only after the coefficient fields or dt change.
 
-		for( int i = M.mesh.x_coordinates.size()-2 ; i >= 0 ; i-- )
-		{
-			naxpy( &(*M.p_density_vectors)[n] , M.thomas_cx[i] , (*M.p_density_vectors)[n+M.thomas_i_jump] ); 
-			n -= M.thomas_i_jump; 
-		}
+void variable_coefficients_LOD( Microenvironment& M, double dt , int dimensions )
+{
+	if( M.mesh.uniform_mesh == false || M.mesh.Cartesian_mesh == false )
+	{
+		std::cout << "Error: This algorithm is written for uniform Cartesian meshes. Try: other solvers!" << std::endl << std::endl; 
+		return; 
 	}
-
-	// y-diffusion 
-
-	M.apply_dirichlet_conditions();
-	#pragma omp parallel for 
-	for( unsigned int i=0; i < M.mesh.x_coordinates.size() ; i++ )
+	
+	if( !M.diffusion_solver_setup_done )
 	{
-		// Thomas solver, y-direction
-
-		// remaining part of forward elimination, using pre-computed quantities 
-
-		int n = M.voxel_index(i,0,0);
-		(*M.p_density_vectors)[n] /= M.thomas_denomy[0]; 
-
-		n += M.thomas_j_jump; 
-		for( unsigned int j=1; j < M.mesh.y_coordinates.size() ; j++ )
-		{
-			axpy( &(*M.p_density_vectors)[n] , M.thomas_constant1 , (*M.p_density_vectors)[n-M.thomas_j_jump] ); 
-			(*M.p_density_vectors)[n] /= M.thomas_denomy[j]; 
-			n += M.thomas_j_jump; 
-		}
-
-		// back substitution 
-		n = M.voxel_index( i,M.mesh.y_coordinates.size()-2, 0); 
-
-		for( int j = M.mesh.y_coordinates.size()-2 ; j >= 0 ; j-- )
-		{
-			naxpy( &(*M.p_density_vectors)[n] , M.thomas_cy[j] , (*M.p_density_vectors)[n+M.thomas_j_jump] ); 
-			n -= M.thomas_j_jump; 
-		}
+		std::cout << std::endl << "Using method " << __FUNCTION__ << " (implicit " << dimensions
+		<< "-D LOD with Thomas Algorithm, spatially varying coefficients) ... " << std::endl << std::endl; 
+		M.thomas_i_jump = 1; 
+		M.thomas_j_jump = M.mesh.x_coordinates.size(); 
+		M.thomas_k_jump = M.thomas_j_jump * M.mesh.y_coordinates.size(); 
+		M.coefficient_fields_out_of_date = true; 
+		M.diffusion_solver_setup_done = true; 
 	}
+	
+	if( M.coefficient_fields_out_of_date || dt != M.thomas_line_dt )
+	{ M.setup_variable_coefficient_factorizations( dt , dimensions ); }
 
-	M.apply_dirichlet_conditions();
+	// inert substrates only need their Dirichlet conditions
 	
-	// reset gradient vectors 
-//	M.reset_all_gradient_vectors(); 
+	if( M.solver_substrates.size() == 0 )
+	{
+		M.apply_dirichlet_conditions_to_inert_substrates(); 
+		return; 
+	}
+	
+	M.copy_densities_to_solver_buffer(); 
+	if( M.dirichlet_blocks_out_of_date )
+	{ M.sort_dirichlet_nodes_by_block(); }
 	
+	LOD_sweeps( M , M.thomas_densities.data() , dimensions , true ); 
+
+	M.apply_dirichlet_conditions_to_solver_buffer(); 
+	M.apply_dirichlet_conditions_to_inert_substrates(); 
+	M.copy_densities_from_solver_buffer(); 
 	return; 
 }
 
+void diffusion_decay_solver__variable_coefficients_LOD_3D( Microenvironment& M, double dt )
+{ variable_coefficients_LOD( M , dt , 3 ); }
+
+void diffusion_decay_solver__variable_coefficients_LOD_2D( Microenvironment& M, double dt )
+{ variable_coefficients_LOD( M , dt , 2 ); }
+
 void diffusion_decay_explicit_uniform_rates( Microenvironment& M, double dt )
 {
 	using std::vector; 
@@ -521,4 +774,905 @@ void diffusion_decay_explicit_uniform_rates( Microenvironment& M, double dt )
 	return; 
 }
 
+// quasi-steady multigrid solver 
+
+// The steady state of each substrate, with the cells' secretion and uptake (and 
+// the bulk supply / uptake from update_rates(), if it has been called) as rates: 
+//   c*u - sum over faces of w_d*( u_neighbor - u ) = f, 
+// where w_d = D/h_d^2, c = decay rate + uptake rates, f = sources, with zero 
+// flux at the mesh boundary and u fixed at the Dirichlet nodes. Cell-centered 
+// geometric multigrid: each coarser level merges 2 voxels in each direction, 
+// restricts by averaging, and prolongs by injection. 
+
+class Multigrid_Levels
+{
+ public:
+	std::vector< std::vector<double> >& u; 
+	std::vector< std::vector<double> >& f; 
+	std::vector< std::vector<double> >& c; 
+	std::vector< std::vector<double> >& r; 
+	std::vector< std::vector<char> >& pinned; 
+	std::vector< std::vector<int> >& sizes; 
+	std::vector< std::vector<double> > weights; // w_d on each level 
+	
+	Multigrid_Levels( std::vector< std::vector<double> >& u_in , std::vector< std::vector<double> >& f_in , 
+		std::vector< std::vector<double> >& c_in , std::vector< std::vector<double> >& r_in , 
+		std::vector< std::vector<char> >& pinned_in , std::vector< std::vector<int> >& sizes_in ) 
+		: u( u_in ) , f( f_in ) , c( c_in ) , r( r_in ) , pinned( pinned_in ) , sizes( sizes_in ) { }
+};
+
+// red-black Gauss-Seidel 
+static void multigrid_smooth( Multigrid_Levels& L , int level , int sweeps )
+{
+	double* u = L.u[level].data(); 
+	const double* f = L.f[level].data(); 
+	const double* c = L.c[level].data(); 
+	const char* pinned = L.pinned[level].data(); 
+	const double* w = L.weights[level].data(); 
+	int nx = L.sizes[level][0]; 
+	int ny = L.sizes[level][1]; 
+	int nz = L.sizes[level][2]; 
+	
+	for( int sweep=0; sweep < sweeps; sweep++ )
+	{
+		for( int color=0; color < 2; color++ )
+		{
+			#pragma omp parallel for 
+			for( int line=0; line < ny*nz; line++ )
+			{
+				int j = line % ny; 
+				int k = line / ny; 
+				for( int i=(j+k+color)%2; i < nx; i += 2 )
+				{
+					int n = i + nx*line; 
+					if( pinned[n] )
+					{ continue; }
+					double diagonal = c[n]; 
+					double sum = f[n]; 
+					if( i > 0 ) { sum += w[0]*u[n-1]; diagonal += w[0]; }
+					if( i < nx-1 ) { sum += w[0]*u[n+1]; diagonal += w[0]; }
+					if( j > 0 ) { sum += w[1]*u[n-nx]; diagonal += w[1]; }
+					if( j < ny-1 ) { sum += w[1]*u[n+nx]; diagonal += w[1]; }
+					if( k > 0 ) { sum += w[2]*u[n-nx*ny]; diagonal += w[2]; }
+					if( k < nz-1 ) { sum += w[2]*u[n+nx*ny]; diagonal += w[2]; }
+					if( diagonal > 0.0 )
+					{ u[n] = sum / diagonal; }
+				}
+			}
+		}
+	}
+	return; 
+}
+
+// r = f - A*u on the given level. Returns max |r|, and sets scale to max |f| + |diagonal*u| 
+static double multigrid_residual( Multigrid_Levels& L , int level , double& scale )
+{
+	const double* u = L.u[level].data(); 
+	const double* f = L.f[level].data(); 
+	const double* c = L.c[level].data(); 
+	const char* pinned = L.pinned[level].data(); 
+	const double* w = L.weights[level].data(); 
+	double* r = L.r[level].data(); 
+	int nx = L.sizes[level][0]; 
+	int ny = L.sizes[level][1]; 
+	int nz = L.sizes[level][2]; 
+	
+	double max_residual = 0.0; 
+	double max_scale = 0.0; 
+	#pragma omp parallel for reduction(max:max_residual,max_scale) 
+	for( int line=0; line < ny*nz; line++ )
+	{
+		int j = line % ny; 
+		int k = line / ny; 
+		for( int i=0; i < nx; i++ )
+		{
+			int n = i + nx*line; 
+			if( pinned[n] )
+			{ r[n] = 0.0; continue; }
+			double diagonal = c[n]; 
+			double sum = f[n]; 
+			if( i > 0 ) { sum += w[0]*u[n-1]; diagonal += w[0]; }
+			if( i < nx-1 ) { sum += w[0]*u[n+1]; diagonal += w[0]; }
+			if( j > 0 ) { sum += w[1]*u[n-nx]; diagonal += w[1]; }
+			if( j < ny-1 ) { sum += w[1]*u[n+nx]; diagonal += w[1]; }
+			if( k > 0 ) { sum += w[2]*u[n-nx*ny]; diagonal += w[2]; }
+			if( k < nz-1 ) { sum += w[2]*u[n+nx*ny]; diagonal += w[2]; }
+			r[n] = sum - diagonal*u[n]; 
+			max_residual = std::max( max_residual , fabs( r[n] ) ); 
+			max_scale = std::max( max_scale , fabs( f[n] ) + fabs( diagonal*u[n] ) ); 
+		}
+	}
+	scale = max_scale; 
+	return max_residual; 
+}
+
+// coarse = average of its children on the finer level 
+static void multigrid_restrict( std::vector<double>& fine , std::vector<int>& fine_size , 
+	std::vector<double>& coarse , std::vector<int>& coarse_size )
+{
+	int ratio[3]; 
+	for( int d=0; d < 3; d++ )
+	{ ratio[d] = ( coarse_size[d] < fine_size[d] ) ? 2 : 1; }
+	
+	#pragma omp parallel for 
+	for( int line=0; line < coarse_size[1]*coarse_size[2]; line++ )
+	{
+		int J = line % coarse_size[1]; 
+		int K = line / coarse_size[1]; 
+		for( int I=0; I < coarse_size[0]; I++ )
+		{
+			double sum = 0.0; 
+			int children = 0; 
+			for( int k=ratio[2]*K; k < std::min( ratio[2]*(K+1) , fine_size[2] ); k++ )
+			{
+				for( int j=ratio[1]*J; j < std::min( ratio[1]*(J+1) , fine_size[1] ); j++ )
+				{
+					for( int i=ratio[0]*I; i < std::min( ratio[0]*(I+1) , fine_size[0] ); i++ )
+					{
+						sum += fine[ i + fine_size[0]*( j + fine_size[1]*k ) ]; 
+						children++; 
+					}
+				}
+			}
+			coarse[ I + coarse_size[0]*line ] = sum / children; 
+		}
+	}
+	return; 
+}
+
+// fine += coarse correction (piecewise constant), except at pinned voxels 
+static void multigrid_prolong( Multigrid_Levels& L , int level )
+{
+	std::vector<int>& fine_size = L.sizes[level]; 
+	std::vector<int>& coarse_size = L.sizes[level+1]; 
+	int shift[3]; 
+	for( int d=0; d < 3; d++ )
+	{ shift[d] = ( coarse_size[d] < fine_size[d] ) ? 1 : 0; }
+	std::vector<double>& fine = L.u[level]; 
+	std::vector<double>& coarse = L.u[level+1]; 
+	std::vector<char>& pinned = L.pinned[level]; 
+	
+	#pragma omp parallel for 
+	for( int line=0; line < fine_size[1]*fine_size[2]; line++ )
+	{
+		int j = line % fine_size[1]; 
+		int k = line / fine_size[1]; 
+		int coarse_line = coarse_size[0]*( (j>>shift[1]) + coarse_size[1]*(k>>shift[2]) ); 
+		for( int i=0; i < fine_size[0]; i++ )
+		{
+			int n = i + fine_size[0]*line; 
+			if( !pinned[n] )
+			{ fine[n] += coarse[ (i>>shift[0]) + coarse_line ]; }
+		}
+	}
+	return; 
+}
+
+static void multigrid_V_cycle( Multigrid_Levels& L , int level )
+{
+	if( level == (int) L.sizes.size()-1 )
+	{
+		multigrid_smooth( L , level , 20 ); 
+		return; 
+	}
+	
+	multigrid_smooth( L , level , 2 ); 
+	double scale; 
+	multigrid_residual( L , level , scale ); 
+	
+	// solve for the correction on the coarser level 
+	multigrid_restrict( L.r[level] , L.sizes[level] , L.f[level+1] , L.sizes[level+1] ); 
+	L.u[level+1].assign( L.u[level+1].size() , 0.0 ); 
+	multigrid_V_cycle( L , level+1 ); 
+	multigrid_prolong( L , level ); 
+	
+	multigrid_smooth( L , level , 2 ); 
+	return; 
+}
+
+void diffusion_decay_solver__quasi_steady_state_multigrid( Microenvironment& M, double dt )
+{
+	if( M.mesh.Cartesian_mesh == false )
+	{
+		std::cout << "Error: This algorithm is written for Cartesian meshes. Try: other solvers!" << std::endl << std::endl; 
+		return; 
+	}
+	
+	// hold the field between updates 
+	
+	M.multigrid_elapsed_time += dt; 
+	if( M.multigrid_u.size() > 0 && M.multigrid_u[0].size() == M.mesh.voxels.size() && 
+		M.multigrid_elapsed_time < M.quasi_steady_state_interval - 0.001*dt )
+	{
+		// the held field is in steady state with the sources and sinks 
+		M.solver_applied_cell_sources_and_sinks = true; 
+		return; 
+	}
+	double elapsed_time = M.multigrid_elapsed_time; 
+	M.multigrid_elapsed_time = 0.0; 
+	
+	int number_of_voxels = M.mesh.voxels.size(); 
+	int number_of_densities = M.number_of_densities(); 
+	
+	// set up the mesh hierarchy 
+	
+	if( M.multigrid_u.size() == 0 || M.multigrid_u[0].size() != M.mesh.voxels.size() )
+	{
+		std::vector<int> size = { (int) M.mesh.x_coordinates.size() , (int) M.mesh.y_coordinates.size() , (int) M.mesh.z_coordinates.size() }; 
+		std::vector<double> spacing = { M.mesh.dx , M.mesh.dy , M.mesh.dz }; 
+		M.multigrid_sizes.assign( 1 , size ); 
+		M.multigrid_spacings.assign( 1 , spacing ); 
+		while( size[0] > 2 || size[1] > 2 || size[2] > 2 )
+		{
+			for( int d=0; d < 3; d++ )
+			{
+				if( size[d] > 1 )
+				{ size[d] = ( size[d] + 1 ) / 2; spacing[d] *= 2.0; }
+			}
+			M.multigrid_sizes.push_back( size ); 
+			M.multigrid_spacings.push_back( spacing ); 
+		}
+		
+		int number_of_levels = M.multigrid_sizes.size(); 
+		M.multigrid_u.resize( number_of_levels ); 
+		M.multigrid_f.resize( number_of_levels ); 
+		M.multigrid_c.resize( number_of_levels ); 
+		M.multigrid_r.resize( number_of_levels ); 
+		M.multigrid_pinned.resize( number_of_levels ); 
+		for( int l=0; l < number_of_levels; l++ )
+		{
+			int n = M.multigrid_sizes[l][0] * M.multigrid_sizes[l][1] * M.multigrid_sizes[l][2]; 
+			M.multigrid_u[l].assign( n , 0.0 ); 
+			M.multigrid_f[l].assign( n , 0.0 ); 
+			M.multigrid_c[l].assign( n , 0.0 ); 
+			M.multigrid_r[l].assign( n , 0.0 ); 
+			M.multigrid_pinned[l].assign( n , 0 ); 
+		}
+		
+		std::cout << "Quasi-steady multigrid solver: " << number_of_levels << " levels, updated every " 
+			<< M.quasi_steady_state_interval << " " << M.time_units << std::endl; 
+	}
+	
+	// the agents' secretion and uptake, as rates in their voxels 
+	
+	M.multigrid_cell_sources.assign( number_of_voxels * number_of_densities , 0.0 ); 
+	M.multigrid_cell_uptakes.assign( number_of_voxels * number_of_densities , 0.0 ); 
+	M.sort_agents_by_voxel( all_basic_agents ); 
+	#pragma omp parallel for 
+	for( int m=0; m < (int) M.occupied_voxels.size(); m++ )
+	{
+		int n = M.occupied_voxels[m]; 
+		for( int i=M.agents_by_voxel_start[m]; i < M.agents_by_voxel_start[m+1]; i++ )
+		{
+			M.agent_source_sink_rates_function( all_basic_agents[ M.agents_by_voxel[i] ] , &M , dt , 
+				&M.multigrid_cell_sources[ n*number_of_densities ] , &M.multigrid_cell_uptakes[ n*number_of_densities ] ); 
+		}
+	}
+	bool bulk_sources_and_sinks = ( (int) M.uptake_rates.size() == number_of_voxels ); 
+	
+	Multigrid_Levels L( M.multigrid_u , M.multigrid_f , M.multigrid_c , M.multigrid_r , M.multigrid_pinned , M.multigrid_sizes ); 
+	std::vector< std::vector<double> >& density = *(M.p_density_vectors); 
+	for( int q=0; q < number_of_densities; q++ )
+	{
+		// the problem on the mesh, warm-started from the current densities 
+		
+		std::vector<double>& u = M.multigrid_u[0]; 
+		std::vector<double>& f = M.multigrid_f[0]; 
+		std::vector<double>& c = M.multigrid_c[0]; 
+		std::vector<char>& pinned = M.multigrid_pinned[0]; 
+		#pragma omp parallel for 
+		for( int n=0; n < number_of_voxels; n++ )
+		{
+			u[n] = density[n][q]; 
+			f[n] = M.multigrid_cell_sources[ n*number_of_densities + q ]; 
+			c[n] = M.decay_rates[q] + M.multigrid_cell_uptakes[ n*number_of_densities + q ]; 
+			if( bulk_sources_and_sinks )
+			{
+				f[n] += M.supply_target_densities_times_supply_rates[n][q]; 
+				c[n] += M.uptake_rates[n][q] + M.supply_rates[n][q]; 
+			}
+			pinned[n] = 0; 
+		}
+		if( M.dirichlet_activation_vector[q] )
+		{
+			for( unsigned int m=0; m < M.dirichlet_indices.size(); m++ )
+			{
+				int n = M.dirichlet_indices[m]; 
+				u[n] = M.dirichlet_values[ m*number_of_densities + q ]; 
+				pinned[n] = 1; 
+			}
+		}
+		
+		if( M.diffusion_coefficients[q] == 0.0 && M.decay_rates[q] == 0.0 )
+		{
+			// no diffusion or decay: no steady state to speak of, so 
+			// integrate the sources and sinks over the elapsed time instead 
+			#pragma omp parallel for 
+			for( int n=0; n < number_of_voxels; n++ )
+			{
+				if( !pinned[n] )
+				{ u[n] = ( u[n] + elapsed_time*f[n] ) / ( 1.0 + elapsed_time*c[n] ); }
+			}
+		}
+		else
+		{
+			// coarse-level coefficients 
+			L.weights.resize( L.sizes.size() ); 
+			for( unsigned int l=0; l < L.sizes.size(); l++ )
+			{
+				L.weights[l].resize( 3 ); 
+				for( int d=0; d < 3; d++ )
+				{ L.weights[l][d] = M.diffusion_coefficients[q] / ( M.multigrid_spacings[l][d] * M.multigrid_spacings[l][d] ); }
+				if( l > 0 )
+				{
+					multigrid_restrict( M.multigrid_c[l-1] , L.sizes[l-1] , M.multigrid_c[l] , L.sizes[l] ); 
+					// pinned if any child is 
+					std::vector<double> fine_pinned( L.pinned[l-1].begin() , L.pinned[l-1].end() ); 
+					std::vector<double> coarse_pinned( L.pinned[l].size() ); 
+					multigrid_restrict( fine_pinned , L.sizes[l-1] , coarse_pinned , L.sizes[l] ); 
+					for( unsigned int n=0; n < coarse_pinned.size(); n++ )
+					{ L.pinned[l][n] = ( coarse_pinned[n] > 0.0 ); }
+				}
+			}
+			
+			double scale; 
+			double residual = multigrid_residual( L , 0 , scale ); 
+			int cycles = 0; 
+			int max_cycles = 50; 
+			while( residual > M.quasi_steady_state_tolerance * scale && cycles < max_cycles )
+			{
+				multigrid_V_cycle( L , 0 ); 
+				residual = multigrid_residual( L , 0 , scale ); 
+				cycles++; 
+			}
+			if( residual > M.quasi_steady_state_tolerance * scale )
+			{
+				std::cout << "Warning: the quasi-steady solve of " << M.density_names[q] << " did not converge in " 
+					<< max_cycles << " V-cycles (residual / scale = " << residual / scale 
+					<< ", tolerance " << M.quasi_steady_state_tolerance << ")." << std::endl; 
+			}
+		}
+		
+		#pragma omp parallel for 
+		for( int n=0; n < number_of_voxels; n++ )
+		{ density[n][q] = u[n]; }
+	}
+	
+	M.solver_applied_cell_sources_and_sinks = true; 
+	return; 
+}
+
+// adaptive mesh refinement solver
+
+// Two levels: a coarse level with amr_ratio voxels (per direction, but not in 
+// z in 2-D) in each coarse voxel covers the whole mesh, and the patch (the 
+// coarse voxels in amr_patch_box, around the agents plus amr_buffer_distance) 
+// is solved at full resolution. Each step restricts the densities to the 
+// coarse level (volume averages), then does the LOD sweeps, one direction at a 
+// time, on both levels: the coarse sweep gives the flux through each coarse 
+// face of the patch boundary, the patch sweep takes that same flux in through 
+// its boundary voxels, and the patch is averaged back down onto the coarse 
+// voxels it covers (which the next coarse sweep then sees). So both levels 
+// exchange exactly the same amounts, and without Dirichlet nodes the total is 
+// conserved as in the uniform solver. Outside the patch, the voxels of each 
+// coarse voxel take a slope-limited linear profile with the coarse voxel's 
+// average, so the mesh keeps full-resolution densities throughout, and the 
+// rest of BioFVM and PhysiCell is unchanged. 
+// 
+// Dirichlet nodes are pinned at full resolution in the patch. Outside it, a 
+// coarse voxel that contains some is split into its pinned voxels (held at 
+// their values) and the rest, which exchanges with them across the faces they 
+// share, over the distance between the centers of the two parts. 
+
+// solves ( 1 + c2 + 2*c1 ) u[i] - c1*( u[i-1] + u[i+1] ) = u[i] in place along 
+// a line, with no flux through its ends, as in the LOD sweeps 
+static void amr_solve_line( double* u , int length , int stride , double c1 , double c2 , double* scratch )
+{
+	if( length == 1 )
+	{
+		u[0] /= 1.0 + c2; 
+		return; 
+	}
+	double denominator = 1.0 + c1 + c2; 
+	scratch[0] = -c1 / denominator; 
+	u[0] /= denominator; 
+	for( int i=1; i < length; i++ )
+	{
+		denominator = 1.0 + c2 + ( i == length-1 ? c1 : 2.0*c1 ) + c1*scratch[i-1]; 
+		scratch[i] = -c1 / denominator; 
+		u[i*stride] = ( u[i*stride] + c1*u[(i-1)*stride] ) / denominator; 
+	}
+	for( int i=length-2; i >= 0; i-- )
+	{ u[i*stride] -= scratch[i] * u[(i+1)*stride]; }
+	return; 
+}
+
+// the lines in direction d of a grid with sizes[3] voxels: line l starts at 
+// voxel amr_line_start( sizes , d , l ), and there are voxels/sizes[d] of them 
+static int amr_line_start( const int* sizes , int d , int l )
+{
+	int d1 = ( d == 0 ) ? 1 : 0; 
+	int d2 = ( d == 2 ) ? 1 : 2; 
+	int jump[3] = { 1 , sizes[0] , sizes[0]*sizes[1] }; 
+	return ( l % sizes[d1] ) * jump[d1] + ( l / sizes[d1] ) * jump[d2]; 
+}
+
+void diffusion_decay_solver__adaptive_mesh_refinement( Microenvironment& M, double dt )
+{
+	if( M.mesh.uniform_mesh == false )
+	{
+		std::cout << "Error: This algorithm is written for uniform Cartesian meshes. Try: something else." << std::endl << std::endl; 
+		return; 
+	}
+
+	int size[3] = { (int) M.mesh.x_coordinates.size() , (int) M.mesh.y_coordinates.size() , (int) M.mesh.z_coordinates.size() }; 
+	int nx = size[0]; 
+	int ny = size[1]; 
+	int nz = size[2]; 
+	int dimensions = ( nz == 1 ) ? 2 : 3; 
+	int number_of_voxels = M.mesh.voxels.size(); 
+	int number_of_densities = M.number_of_densities(); 
+	double h[3] = { M.mesh.dx , M.mesh.dy , M.mesh.dz }; 
+	std::vector< std::vector<double> >& density = *(M.p_density_vectors); 
+
+	// the largest ratio (up to amr_refinement_ratio) that divides the mesh, 
+	// so that the coarse voxels cover it exactly 
+
+	int ratio = std::max( M.amr_refinement_ratio , 1 ); 
+	while( ratio > 1 && ( nx % ratio || ny % ratio || ( dimensions == 3 && nz % ratio ) ) )
+	{ ratio--; }
+	if( ratio == 1 )
+	{
+		if( M.amr_ratio != 1 )
+		{
+			M.amr_ratio = 1; 
+			std::cout << "Adaptive mesh refinement: no refinement ratio up to " << M.amr_refinement_ratio 
+				<< " divides the mesh; solving at full resolution" << std::endl; 
+		}
+		if( dimensions == 2 )
+		{ diffusion_decay_solver__constant_coefficients_LOD_2D( M , dt ); }
+		else
+		{ diffusion_decay_solver__constant_coefficients_LOD_3D( M , dt ); }
+		return; 
+	}
+	int ratios[3] = { ratio , ratio , ( dimensions == 3 ) ? ratio : 1 }; 
+	int coarse_size[3] = { nx / ratios[0] , ny / ratios[1] , nz / ratios[2] }; 
+	int coarse_voxels = coarse_size[0] * coarse_size[1] * coarse_size[2]; 
+	int voxels_per_coarse_voxel = ratios[0] * ratios[1] * ratios[2]; 
+
+	if( M.amr_ratio != ratio || (int) M.amr_coarse_densities.size() != coarse_voxels * number_of_densities )
+	{
+		M.amr_ratio = ratio; 
+		M.amr_coarse_densities.assign( coarse_voxels * number_of_densities , 0.0 ); 
+		M.amr_patch_box.clear(); 
+		std::cout << "Adaptive mesh refinement: " << coarse_size[0] << " x " << coarse_size[1] << " x " << coarse_size[2]
+			<< " coarse voxels (refinement ratio " << ratio << ")" << std::endl; 
+	}
+	std::vector<double>& U = M.amr_coarse_densities; 
+
+	// the patch: the agents' voxels, plus amr_buffer_distance, in whole coarse voxels
+
+	int needed[6] = { coarse_size[0] , coarse_size[1] , coarse_size[2] , -1 , -1 , -1 }; 
+	for( unsigned int a=0; a < all_basic_agents.size(); a++ )
+	{
+		int n = all_basic_agents[a]->get_current_voxel_index(); 
+		if( n < 0 || n >= number_of_voxels )
+		{ continue; }
+		int index[3] = { n % nx , ( n / nx ) % ny , n / ( nx*ny ) }; 
+		for( int d=0; d < 3; d++ )
+		{
+			int margin = (int) ceil( M.amr_buffer_distance / h[d] ); 
+			needed[d] = std::min( needed[d] , std::max( index[d] - margin , 0 ) / ratios[d] ); 
+			needed[d+3] = std::max( needed[d+3] , std::min( index[d] + margin , size[d]-1 ) / ratios[d] ); 
+		}
+	}
+
+	if( needed[3] < 0 )
+	{ M.amr_patch_box.clear(); }
+	else
+	{
+		// regrid when the patch is too small, or more than twice as large as needed
+		bool regrid = ( M.amr_patch_box.size() != 6 ); 
+		if( regrid == false )
+		{
+			double current_volume = 1.0; 
+			double needed_volume = 1.0; 
+			for( int d=0; d < 3; d++ )
+			{
+				if( needed[d] < M.amr_patch_box[d] || needed[d+3] > M.amr_patch_box[d+3] )
+				{ regrid = true; }
+				current_volume *= M.amr_patch_box[d+3] - M.amr_patch_box[d] + 1; 
+				needed_volume *= needed[d+3] - needed[d] + 1; 
+			}
+			if( current_volume > 2.0 * needed_volume )
+			{ regrid = true; }
+		}
+		if( regrid )
+		{
+			// one more coarse voxel of room on each side, so the patch does not follow every step
+			M.amr_patch_box.resize( 6 ); 
+			for( int d=0; d < 3; d++ )
+			{
+				M.amr_patch_box[d] = std::max( needed[d] - 1 , 0 ); 
+				M.amr_patch_box[d+3] = std::min( needed[d+3] + 1 , coarse_size[d]-1 ); 
+			}
+		}
+	}
+	bool patch = ( M.amr_patch_box.size() == 6 ); 
+	int box[6] = { 0 , 0 , 0 , -1 , -1 , -1 }; // the patch, in coarse voxels 
+	int fine_box[6] = { 0 , 0 , 0 , -1 , -1 , -1 }; // and in voxels 
+	int patch_size[3] = { 0 , 0 , 0 }; 
+	int box_size[3] = { 0 , 0 , 0 }; 
+	if( patch )
+	{
+		for( int d=0; d < 3; d++ )
+		{
+			box[d] = M.amr_patch_box[d]; 
+			box[d+3] = M.amr_patch_box[d+3]; 
+			fine_box[d] = box[d] * ratios[d]; 
+			fine_box[d+3] = ( box[d+3] + 1 ) * ratios[d] - 1; 
+			box_size[d] = box[d+3] - box[d] + 1; 
+			patch_size[d] = fine_box[d+3] - fine_box[d] + 1; 
+		}
+	}
+	int patch_voxels = patch_size[0] * patch_size[1] * patch_size[2]; 
+
+	// restrict: each coarse voxel is the average of its voxels. Each thread 
+	// takes whole rows of coarse voxels, and streams through their voxels. 
+
+	#pragma omp parallel for
+	for( int row=0; row < coarse_size[1]*coarse_size[2]; row++ )
+	{
+		double* coarse_row = &U[ row * coarse_size[0] * number_of_densities ]; 
+		std::fill( coarse_row , coarse_row + coarse_size[0] * number_of_densities , 0.0 ); 
+		int cj = row % coarse_size[1]; 
+		int ck = row / coarse_size[1]; 
+		for( int k=ck*ratios[2]; k < (ck+1)*ratios[2]; k++ )
+		{
+			for( int j=cj*ratios[1]; j < (cj+1)*ratios[1]; j++ )
+			{
+				std::vector<double>* fine_row = &density[ nx*( j + ny*k ) ]; 
+				for( int i=0; i < nx; i++ )
+				{
+					double* sum = coarse_row + ( i / ratios[0] ) * number_of_densities; 
+					const double* fine = fine_row[i].data(); 
+					for( int q=0; q < number_of_densities; q++ )
+					{ sum[q] += fine[q]; }
+				}
+			}
+		}
+		for( int i=0; i < coarse_size[0] * number_of_densities; i++ )
+		{ coarse_row[i] /= voxels_per_coarse_voxel; }
+	}
+
+	// the patch, from the current densities 
+
+	M.amr_patch_densities.resize( patch_voxels * number_of_densities ); 
+	std::vector<double>& P = M.amr_patch_densities; 
+	#pragma omp parallel for
+	for( int row=0; row < patch_size[1]*patch_size[2]; row++ )
+	{
+		std::vector<double>* source = &density[ M.voxel_index( fine_box[0] , fine_box[1] + row % patch_size[1] , fine_box[2] + row / patch_size[1] ) ]; 
+		double* destination = &P[ row * patch_size[0] * number_of_densities ]; 
+		for( int i=0; i < patch_size[0]; i++ )
+		{ std::copy( source[i].begin() , source[i].end() , destination + i*number_of_densities ); }
+	}
+
+	// Dirichlet nodes: those in the patch, by patch voxel, and the others by coarse voxel 
+
+	std::vector<int> patch_nodes; // pairs of ( patch voxel , Dirichlet node ) 
+	std::vector<int> coarse_slot( coarse_voxels , -1 ); 
+	std::vector<int> pinned_voxels; // the coarse voxels with Dirichlet nodes, outside the patch 
+	std::vector<int> pinned_counts; 
+	std::vector<int> pinned_faces; // faces shared by their Dirichlet nodes and their other voxels 
+	std::vector<double> pinned_positions; // sums of the Dirichlet nodes' (voxel) coordinates 
+	std::vector<double> pinned_values; // means of the Dirichlet values 
+	for( unsigned int m=0; m < M.dirichlet_indices.size(); m++ )
+	{
+		int n = M.dirichlet_indices[m]; 
+		int index[3] = { n % nx , ( n / nx ) % ny , n / ( nx*ny ) }; 
+		int coarse_index[3] = { index[0] / ratios[0] , index[1] / ratios[1] , index[2] / ratios[2] }; 
+		bool in_patch = patch; 
+		for( int d=0; d < 3; d++ )
+		{
+			if( coarse_index[d] < box[d] || coarse_index[d] > box[d+3] )
+			{ in_patch = false; }
+		}
+		if( in_patch )
+		{
+			patch_nodes.push_back( ( index[0]-fine_box[0] ) + patch_size[0]*( ( index[1]-fine_box[1] ) + patch_size[1]*( index[2]-fine_box[2] ) ) ); 
+			patch_nodes.push_back( m ); 
+			continue; 
+		}
+		int c = coarse_index[0] + coarse_size[0]*( coarse_index[1] + coarse_size[1]*coarse_index[2] ); 
+		if( coarse_slot[c] < 0 )
+		{
+			coarse_slot[c] = pinned_voxels.size(); 
+			pinned_voxels.push_back( c ); 
+			pinned_counts.push_back( 0 ); 
+			pinned_faces.push_back( 0 ); 
+			pinned_positions.resize( pinned_positions.size() + 3 , 0.0 ); 
+			pinned_values.resize( pinned_values.size() + number_of_densities , 0.0 ); 
+		}
+		int s = coarse_slot[c]; 
+		pinned_counts[s]++; 
+		for( int d=0; d < 3; d++ )
+		{ pinned_positions[ 3*s + d ] += index[d]; }
+		for( int q=0; q < number_of_densities; q++ )
+		{ pinned_values[ s*number_of_densities + q ] += M.dirichlet_values[ m*number_of_densities + q ]; }
+		int jump[3] = { 1 , nx , nx*ny }; 
+		for( int d=0; d < dimensions; d++ )
+		{
+			if( index[d] % ratios[d] > 0 && M.dirichlet_node_map[ n - jump[d] ] < 0 )
+			{ pinned_faces[s]++; }
+			if( index[d] % ratios[d] < ratios[d]-1 && M.dirichlet_node_map[ n + jump[d] ] < 0 )
+			{ pinned_faces[s]++; }
+		}
+	}
+	std::vector<double> pinned_fractions( pinned_voxels.size() ); 
+	for( unsigned int s=0; s < pinned_voxels.size(); s++ )
+	{
+		pinned_fractions[s] = pinned_counts[s] / (double) voxels_per_coarse_voxel; 
+		for( int q=0; q < number_of_densities; q++ )
+		{ pinned_values[ s*number_of_densities + q ] /= pinned_counts[s]; }
+	}
+
+	// the other voxels of each partly pinned coarse voxel exchange with its 
+	// Dirichlet nodes (implicitly, once per step) 
+
+	for( unsigned int s=0; s < pinned_voxels.size(); s++ )
+	{
+		int c = pinned_voxels[s]; 
+		double f = pinned_fractions[s]; 
+		if( f == 1.0 || pinned_faces[s] == 0 )
+		{ continue; }
+		int coarse_index[3] = { c % coarse_size[0] , ( c / coarse_size[0] ) % coarse_size[1] , c / ( coarse_size[0]*coarse_size[1] ) }; 
+		double distance = 0.0; 
+		for( int d=0; d < 3; d++ )
+		{
+			double center = coarse_index[d]*ratios[d] + 0.5*( ratios[d] - 1 ); 
+			double pinned_center = pinned_positions[ 3*s + d ] / pinned_counts[s]; 
+			double free_center = ( voxels_per_coarse_voxel*center - pinned_positions[ 3*s + d ] ) / ( voxels_per_coarse_voxel - pinned_counts[s] ); 
+			distance += ( free_center - pinned_center ) * ( free_center - pinned_center ) * h[d] * h[d]; 
+		}
+		distance = std::max( sqrt( distance ) , 0.5 * h[0] ); 
+		for( int q=0; q < number_of_densities; q++ )
+		{
+			if( M.dirichlet_activation_vector[q] == false )
+			{ continue; }
+			double v = pinned_values[ s*number_of_densities + q ]; 
+			double rate = M.diffusion_coefficients[q] * pinned_faces[s] * h[0] 
+				/ ( distance * ( voxels_per_coarse_voxel - pinned_counts[s] ) * h[0] * h[0] ); 
+			double w = ( U[ c*number_of_densities + q ] - f*v ) / ( 1.0 - f ); 
+			w = ( w + dt*rate*v ) / ( 1.0 + dt*rate ); 
+			U[ c*number_of_densities + q ] = f*v + ( 1.0 - f )*w; 
+		}
+	}
+
+	// the sweeps 
+
+	std::vector<double> decay_constants( number_of_densities ); 
+	for( int q=0; q < number_of_densities; q++ )
+	{ decay_constants[q] = dt * M.decay_rates[q] / dimensions; }
+	int coarse_jump[3] = { 1 , coarse_size[0] , coarse_size[0]*coarse_size[1] }; 
+	int patch_jump[3] = { 1 , patch_size[0] , patch_size[0]*patch_size[1] }; 
+	std::vector<double> face_fluxes[2]; 
+
+	for( int d=0; d < dimensions; d++ )
+	{
+		int d1 = ( d == 0 ) ? 1 : 0; 
+		int d2 = ( d == 2 ) ? 1 : 2; 
+
+		// coarse: Dirichlet nodes, then the lines 
+
+		for( unsigned int s=0; s < pinned_voxels.size(); s++ )
+		{
+			double* u = &U[ pinned_voxels[s]*number_of_densities ]; 
+			double f = pinned_fractions[s]; 
+			for( int q=0; q < number_of_densities; q++ )
+			{
+				if( M.dirichlet_activation_vector[q] == false )
+				{ continue; }
+				double v = pinned_values[ s*number_of_densities + q ]; 
+				if( f == 1.0 )
+				{ u[q] = v; }
+				else
+				{ u[q] += decay_constants[q] * f * v; } // the pinned part does not decay 
+			}
+		}
+
+		int coarse_lines = coarse_voxels / coarse_size[d]; 
+		#pragma omp parallel 
+		{
+			std::vector<double> scratch( std::max( coarse_size[d] , patch_size[d] ) ); 
+			#pragma omp for 
+			for( int l=0; l < coarse_lines; l++ )
+			{
+				double* u = &U[ amr_line_start( coarse_size , d , l ) * number_of_densities ]; 
+				for( int q=0; q < number_of_densities; q++ )
+				{
+					double c1 = dt * M.diffusion_coefficients[q] / ( ratios[d]*h[d] * ratios[d]*h[d] ); 
+					amr_solve_line( u + q , coarse_size[d] , coarse_jump[d]*number_of_densities , c1 , decay_constants[q] , scratch.data() ); 
+				}
+			}
+		}
+
+		if( patch == false )
+		{ continue; }
+
+		// the coarse fluxes into the patch, through its low and high faces in 
+		// this direction (where they are not on the edge of the mesh) 
+
+		bool interface[2] = { box[d] > 0 , box[d+3] < coarse_size[d]-1 }; 
+		for( int side=0; side < 2; side++ )
+		{
+			face_fluxes[side].assign( box_size[d1] * box_size[d2] * number_of_densities , 0.0 ); 
+			if( interface[side] == false )
+			{ continue; }
+			int inside = ( side == 0 ) ? box[d] : box[d+3]; 
+			int outside = ( side == 0 ) ? inside - 1 : inside + 1; 
+			for( int b=0; b < box_size[d2]; b++ )
+			{
+				for( int a=0; a < box_size[d1]; a++ )
+				{
+					int c = ( box[d1] + a ) * coarse_jump[d1] + ( box[d2] + b ) * coarse_jump[d2]; 
+					double* u_inside = &U[ ( c + inside*coarse_jump[d] ) * number_of_densities ]; 
+					double* u_outside = &U[ ( c + outside*coarse_jump[d] ) * number_of_densities ]; 
+					double* flux = &face_fluxes[side][ ( a + box_size[d1]*b ) * number_of_densities ]; 
+					for( int q=0; q < number_of_densities; q++ )
+					{
+						double c1 = dt * M.diffusion_coefficients[q] / ( ratios[d]*h[d] * ratios[d]*h[d] ); 
+						// into the coarse voxel (per its volume), so ratios[d] times that into each boundary voxel 
+						flux[q] = ratios[d] * c1 * ( u_outside[q] - u_inside[q] ); 
+					}
+				}
+			}
+		}
+
+		// patch: Dirichlet nodes, then the lines, with the coarse fluxes in at the ends 
+
+		for( unsigned int i=0; i < patch_nodes.size(); i += 2 )
+		{
+			double* u = &P[ patch_nodes[i]*number_of_densities ]; 
+			int m = patch_nodes[i+1]; 
+			for( int q=0; q < number_of_densities; q++ )
+			{
+				if( M.dirichlet_activation_vector[q] )
+				{ u[q] = M.dirichlet_values[ m*number_of_densities + q ]; }
+			}
+		}
+
+		int patch_lines = patch_voxels / patch_size[d]; 
+		int stride = patch_jump[d] * number_of_densities; 
+		#pragma omp parallel 
+		{
+			std::vector<double> scratch( patch_size[d] ); 
+			#pragma omp for 
+			for( int l=0; l < patch_lines; l++ )
+			{
+				double* u = &P[ amr_line_start( patch_size , d , l ) * number_of_densities ]; 
+				int face = ( ( l % patch_size[d1] ) / ratios[d1] + box_size[d1] * ( ( l / patch_size[d1] ) / ratios[d2] ) ) * number_of_densities; 
+				for( int q=0; q < number_of_densities; q++ )
+				{
+					u[q] += face_fluxes[0][ face + q ]; 
+					u[ (patch_size[d]-1)*stride + q ] += face_fluxes[1][ face + q ]; 
+					double c1 = dt * M.diffusion_coefficients[q] / ( h[d] * h[d] ); 
+					amr_solve_line( u + q , patch_size[d] , stride , c1 , decay_constants[q] , scratch.data() ); 
+				}
+			}
+		}
+
+		// average the patch down onto the coarse voxels it covers 
+
+		#pragma omp parallel for 
+		for( int row=0; row < box_size[1]*box_size[2]; row++ )
+		{
+			int cj = row % box_size[1]; 
+			int ck = row / box_size[1]; 
+			double* coarse_row = &U[ ( box[0] + coarse_jump[1]*( box[1] + cj ) + coarse_jump[2]*( box[2] + ck ) ) * number_of_densities ]; 
+			std::fill( coarse_row , coarse_row + box_size[0] * number_of_densities , 0.0 ); 
+			for( int k=ck*ratios[2]; k < (ck+1)*ratios[2]; k++ )
+			{
+				for( int j=cj*ratios[1]; j < (cj+1)*ratios[1]; j++ )
+				{
+					const double* fine = &P[ patch_size[0]*( j + patch_size[1]*k ) * number_of_densities ]; 
+					for( int i=0; i < patch_size[0]; i++ )
+					{
+						double* sum = coarse_row + ( i / ratios[0] ) * number_of_densities; 
+						for( int q=0; q < number_of_densities; q++ )
+						{ sum[q] += fine[ i*number_of_densities + q ]; }
+					}
+				}
+			}
+			for( int i=0; i < box_size[0] * number_of_densities; i++ )
+			{ coarse_row[i] /= voxels_per_coarse_voxel; }
+		}
+	}
+
+	// write back: the patch at full resolution, and elsewhere the coarse 
+	// solution (the other voxels' part, where a coarse voxel is partly pinned), 
+	// as a linear profile through each coarse voxel with the same average. Its 
+	// slopes are limited (monotonized central, as in MUSCL), so it adds no new 
+	// extrema, and they are zero in partly pinned coarse voxels. 
+
+	std::vector<double> W = U; 
+	for( unsigned int s=0; s < pinned_voxels.size(); s++ )
+	{
+		double* w = &W[ pinned_voxels[s]*number_of_densities ]; 
+		double f = pinned_fractions[s]; 
+		for( int q=0; q < number_of_densities; q++ )
+		{
+			if( M.dirichlet_activation_vector[q] && f < 1.0 )
+			{ w[q] = ( w[q] - f*pinned_values[ s*number_of_densities + q ] ) / ( 1.0 - f ); }
+		}
+	}
+
+	std::vector<double> slopes( coarse_voxels * 3 * number_of_densities , 0.0 ); 
+	#pragma omp parallel for
+	for( int c=0; c < coarse_voxels; c++ )
+	{
+		if( coarse_slot[c] >= 0 )
+		{ continue; }
+		int coarse_index[3] = { c % coarse_size[0] , ( c / coarse_size[0] ) % coarse_size[1] , c / ( coarse_size[0]*coarse_size[1] ) }; 
+		for( int d=0; d < dimensions; d++ )
+		{
+			if( coarse_index[d] == 0 || coarse_index[d] == coarse_size[d]-1 )
+			{ continue; }
+			const double* u = &U[ c*number_of_densities ]; 
+			const double* u_low = u - coarse_jump[d]*number_of_densities; 
+			const double* u_high = u + coarse_jump[d]*number_of_densities; 
+			double* slope = &slopes[ ( 3*c + d ) * number_of_densities ]; 
+			for( int q=0; q < number_of_densities; q++ )
+			{
+				double low = u[q] - u_low[q]; 
+				double high = u_high[q] - u[q]; 
+				if( low * high <= 0.0 )
+				{ continue; }
+				double magnitude = std::min( std::min( 2.0*fabs(low) , 2.0*fabs(high) ) , 0.5*fabs( low + high ) ); 
+				slope[q] = ( low > 0.0 ) ? magnitude : -magnitude; 
+			}
+		}
+	}
+
+	#pragma omp parallel for
+	for( int row=0; row < ny*nz; row++ )
+	{
+		int j = row % ny; 
+		int k = row / ny; 
+		std::vector<double>* destination = &density[ row*nx ]; 
+		int row_start = ( j / ratios[1] + coarse_size[1]*( k / ratios[2] ) ) * coarse_size[0]; 
+		// offsets from the coarse voxel's center, as fractions of its width 
+		double offset_y = ( j % ratios[1] + 0.5 ) / ratios[1] - 0.5; 
+		double offset_z = ( k % ratios[2] + 0.5 ) / ratios[2] - 0.5; 
+		int i_start = nx; 
+		int i_end = nx; 
+		if( patch && j >= fine_box[1] && j <= fine_box[4] && k >= fine_box[2] && k <= fine_box[5] )
+		{
+			i_start = fine_box[0]; 
+			i_end = fine_box[3] + 1; 
+			const double* source = &P[ patch_size[0]*( ( j-fine_box[1] ) + patch_size[1]*( k-fine_box[2] ) ) * number_of_densities ]; 
+			for( int i=i_start; i < i_end; i++ )
+			{ std::copy( source + (i-i_start)*number_of_densities , source + (i-i_start+1)*number_of_densities , destination[i].begin() ); }
+		}
+		for( int i=0; i < nx; i++ )
+		{
+			if( i >= i_start && i < i_end )
+			{ continue; }
+			int c = row_start + i / ratios[0]; 
+			double offset_x = ( i % ratios[0] + 0.5 ) / ratios[0] - 0.5; 
+			const double* w = &W[ c*number_of_densities ]; 
+			const double* slope = &slopes[ 3*c*number_of_densities ]; 
+			double* value = destination[i].data(); 
+			for( int q=0; q < number_of_densities; q++ )
+			{
+				value[q] = w[q] + offset_x * slope[q] + offset_y * slope[ number_of_densities + q ] 
+					+ offset_z * slope[ 2*number_of_densities + q ]; 
+			}
+		}
+	}
+	M.apply_dirichlet_conditions(); 
+
+	return; 
+}
+
 };
@@ -58,6 +58,20 @@ namespace BioFVM{
 void diffusion_decay_solver__constant_coefficients_LOD_3D( Microenvironment& M, double dt ); // done
 // /*! diffusion-decay solver: 2D LOD implicit (stable method). D and r uniform */  
 void diffusion_decay_solver__constant_coefficients_LOD_2D( Microenvironment& M, double dt ); // done
+// /*! as above, but the last pass over the mesh also applies the bulk and cell sources and sinks */  
+void diffusion_decay_source_sink_solver__constant_coefficients_LOD_3D( Microenvironment& M, double dt ); 
+void diffusion_decay_source_sink_solver__constant_coefficients_LOD_2D( Microenvironment& M, double dt ); 
+// /*! diffusion-decay solvers: 3D / 2D LOD implicit, with D and lambda varying from voxel to voxel
+//     (see Microenvironment::diffusion_coefficient_field and decay_rate_field) */
+void diffusion_decay_solver__variable_coefficients_LOD_3D( Microenvironment& M, double dt ); 
+void diffusion_decay_solver__variable_coefficients_LOD_2D( Microenvironment& M, double dt ); 
+// /*! quasi-steady solver: every quasi_steady_state_interval, jump to the steady state (geometric 
+//     multigrid, warm-started from the current field), with the cells' secretion and uptake as rates */  
+void diffusion_decay_solver__quasi_steady_state_multigrid( Microenvironment& M, double dt ); 
+// /*! adaptive mesh refinement: LOD on a coarse level and, at full resolution, on a patch 
+//     that follows the agents (see amr_refinement_ratio and amr_buffer_distance), with 
+//     matched fluxes across the patch boundary so substrates are conserved */  
+void diffusion_decay_solver__adaptive_mesh_refinement( Microenvironment& M, double dt ); 
 
 /*! This solves for constant diffusion coefficients on a general mesh using the 
     explicit stepping for the diffusion operator, and implicit stepping for all 
@@ -185,6 +185,12 @@ std::ostream& operator<<(std::ostream& os, const std::vector<double>& v )
  return os; 
 }
 
+std::ostream& operator<<(std::ostream& os, const Vec3& v )
+{
+ os << v[0] << " " << v[1] << " " << v[2] << " " ; 
+ return os; 
+}
+
 // this one returns a new vector that has been normalized
 std::vector<double> normalize( std::vector<double>& v )
 {
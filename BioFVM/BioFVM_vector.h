@@ -54,9 +54,124 @@
 #include <vector> 
 #include <cmath>
 #include <cstring>
+#include <new>
+#include <stdint.h>
 
 namespace BioFVM{
 
+/* std::vector allocator with cache-line (64-byte) aligned storage, for 
+   flat buffers that solvers stream through with SIMD loads */ 
+
+template <class T> 
+class Aligned_Allocator
+{
+ public:
+	typedef T value_type; 
+
+	Aligned_Allocator() {} 
+	template <class U> Aligned_Allocator( const Aligned_Allocator<U>& ) {} 
+
+	T* allocate( std::size_t n )
+	{
+		// over-allocate, and keep the original pointer just below the aligned block 
+		char* raw = (char*) malloc( n*sizeof(T) + 64 + sizeof(void*) ); 
+		if( raw == NULL )
+		{ throw std::bad_alloc(); }
+		uintptr_t aligned = ( (uintptr_t) raw + sizeof(void*) + 63 ) & ~( (uintptr_t) 63 ); 
+		((void**) aligned)[-1] = raw; 
+		return (T*) aligned; 
+	}
+	void deallocate( T* p , std::size_t )
+	{ free( ((void**) p)[-1] ); }
+};
+
+template <class T, class U> 
+bool operator==( const Aligned_Allocator<T>& , const Aligned_Allocator<U>& ) { return true; }
+template <class T, class U> 
+bool operator!=( const Aligned_Allocator<T>& , const Aligned_Allocator<U>& ) { return false; }
+
+typedef std::vector< double , Aligned_Allocator<double> > aligned_vector; 
+
+/* fixed-size 3-D vectors (positions, velocities, orientations, gradients) */ 
+
+// Stored inline (no heap allocation), so copies and arithmetic are cheap. 
+// It also has the parts of the std::vector<double> interface that code 
+// uses on 3-D vectors ( [], size, assign, resize, begin/end ), and it 
+// converts to and from std::vector<double>, so older code keeps compiling. 
+class Vec3
+{
+ public:
+	double data[3]; 
+
+	Vec3() { data[0] = 0.0; data[1] = 0.0; data[2] = 0.0; }
+	Vec3( double x, double y, double z ) { data[0] = x; data[1] = y; data[2] = z; }
+	explicit Vec3( const std::vector<double>& v ) { *this = v; }
+
+	Vec3& operator=( const std::vector<double>& v )
+	{
+		data[0] = v.size() > 0 ? v[0] : 0.0; 
+		data[1] = v.size() > 1 ? v[1] : 0.0; 
+		data[2] = v.size() > 2 ? v[2] : 0.0; 
+		return *this; 
+	}
+	operator std::vector<double>() const { return std::vector<double>( data , data+3 ); }
+
+	double& operator[]( int i ) { return data[i]; }
+	const double& operator[]( int i ) const { return data[i]; }
+
+	// std::vector-style access 
+	unsigned int size( void ) const { return 3; }
+	void assign( unsigned int /* n */ , double value ) { data[0] = value; data[1] = value; data[2] = value; }
+	void resize( unsigned int /* n */ , double /* value */ = 0.0 ) { } // always has 3 elements 
+	double* begin( void ) { return data; }
+	double* end( void ) { return data+3; }
+	const double* begin( void ) const { return data; }
+	const double* end( void ) const { return data+3; }
+};
+
+inline Vec3 operator+( const Vec3& v1 , const Vec3& v2 )
+{ return Vec3( v1[0]+v2[0] , v1[1]+v2[1] , v1[2]+v2[2] ); }
+inline Vec3 operator-( const Vec3& v1 , const Vec3& v2 )
+{ return Vec3( v1[0]-v2[0] , v1[1]-v2[1] , v1[2]-v2[2] ); }
+inline Vec3 operator*( const Vec3& v1 , const Vec3& v2 )
+{ return Vec3( v1[0]*v2[0] , v1[1]*v2[1] , v1[2]*v2[2] ); }
+inline Vec3 operator*( double d , const Vec3& v1 )
+{ return Vec3( d*v1[0] , d*v1[1] , d*v1[2] ); }
+
+inline void operator+=( Vec3& v1, const Vec3& v2 )
+{ v1[0] += v2[0]; v1[1] += v2[1]; v1[2] += v2[2]; }
+inline void operator-=( Vec3& v1, const Vec3& v2 )
+{ v1[0] -= v2[0]; v1[1] -= v2[1]; v1[2] -= v2[2]; }
+inline void operator*=( Vec3& v1, const double& a )
+{ v1[0] *= a; v1[1] *= a; v1[2] *= a; }
+inline void operator/=( Vec3& v1, const double& a )
+{ v1[0] /= a; v1[1] /= a; v1[2] /= a; }
+
+inline double norm_squared( const Vec3& v )
+{ return v[0]*v[0] + v[1]*v[1] + v[2]*v[2]; }
+inline double norm( const Vec3& v )
+{ return sqrt( norm_squared( v ) ); }
+
+// this one normalizes v (same tolerance as for std::vector<double>) 
+inline void normalize( Vec3* v )
+{
+	double norm = 1e-32 + (*v)[0]*(*v)[0] + (*v)[1]*(*v)[1] + (*v)[2]*(*v)[2]; 
+	norm = sqrt( norm ); 
+	*v /= norm; 
+}
+
+// y = y + a*x, y = y - a*x 
+inline void axpy( Vec3* y, const double& a , const Vec3& x )
+{ (*y)[0] += a*x[0]; (*y)[1] += a*x[1]; (*y)[2] += a*x[2]; }
+inline void axpy( Vec3* y, const double& a , const std::vector<double>& x )
+{ (*y)[0] += a*x[0]; (*y)[1] += a*x[1]; (*y)[2] += a*x[2]; }
+inline void naxpy( Vec3* y, const double& a , const Vec3& x )
+{ (*y)[0] -= a*x[0]; (*y)[1] -= a*x[1]; (*y)[2] -= a*x[2]; }
+inline void naxpy( Vec3* y, const double& a , const std::vector<double>& x )
+{ (*y)[0] -= a*x[0]; (*y)[1] -= a*x[1]; (*y)[2] -= a*x[2]; }
+
+std::ostream& operator<<(std::ostream& os, const Vec3& v ); 
+
 /* faster operator overloading. multiplication and division are element-wise (Hadamard) */ 
 
 std::vector<double> operator-( const std::vector<double>& v1 , const std::vector<double>& v2 );
@@ -71,6 +71,7 @@
 #include "PhysiCell_constants.h"
 #include "../BioFVM/BioFVM_vector.h" 
 #include<limits.h>
+#include <algorithm>
 
 namespace PhysiCell{
 
@@ -128,6 +129,8 @@ Cell_Definition::Cell_Definition()
 	
 	functions.set_orientation = NULL;
 	
+	all_cell_definitions().push_back( this ); 
+	
 	return; 
 }
 
@@ -150,6 +153,8 @@ Cell_Definition::Cell_Definition( Cell_Definition& cd )
 	// this is the whole reason we need ot make a copy constructor 
 	parameters.pReference_live_phenotype = &phenotype; 
 	
+	all_cell_definitions().push_back( this ); 
+	
 	return; 
 }
 
@@ -175,6 +180,38 @@ Cell_Definition& Cell_Definition::operator=( const Cell_Definition& cd )
 	return *this; 
 }
 
+Cell_Definition::~Cell_Definition()
+{
+	std::vector<Cell_Definition*>& definitions = all_cell_definitions(); 
+	for( unsigned int i=0; i < definitions.size(); i++ )
+	{
+		if( definitions[i] == this )
+		{
+			definitions.erase( definitions.begin() + i ); 
+			return; 
+		}
+	}
+	return; 
+}
+
+// a function-local static, so that definitions in other files can register 
+// whatever the order of static initialization 
+std::vector<Cell_Definition*>& all_cell_definitions( void )
+{
+	static std::vector<Cell_Definition*> definitions; 
+	return definitions; 
+}
+
+Cell_Definition* find_cell_definition( std::string name )
+{
+	std::vector<Cell_Definition*>& definitions = all_cell_definitions(); 
+	for( unsigned int i=0; i < definitions.size(); i++ )
+	{
+		if( definitions[i]->name == name )
+		{ return definitions[i]; }
+	}
+	return NULL; 
+}
 
 Cell_Definition cell_defaults; 
 
@@ -298,6 +335,19 @@ void Cell::advance_bundled_phenotype_functions( double dt_ )
 }
 
 Cell::Cell()
+{
+	reset_cell_data(); 
+	return; 
+}
+
+void Cell::reset( void )
+{
+	Basic_Agent::reset(); 
+	reset_cell_data(); 
+	return; 
+}
+
+void Cell::reset_cell_data( void )
 {
 	// use the cell defaults; 
 	
@@ -312,15 +362,22 @@ Cell::Cell()
 	
 	phenotype.molecular.sync_to_cell( this ); 
 	
-	// cell state should be fine by the default constructor 
+	// same as the default Cell_State, without reallocating 
+	state.neighbors.clear(); 
+	state.orientation.assign( 3 , 0.0 ); 
+	state.simple_pressure = 0.0; 
 	
 	current_mechanics_voxel_index=-1;
 	
 	updated_current_mechanics_voxel_index = 0;
 	
+	random_stream.stream_id = ID; 
+	random_stream.stream_type = 0; 
+	random_stream.counter = 0; 
+	
 	is_movable = true;
 	is_out_of_domain = false;
-	displacement.resize(3,0.0); // state? 
+	displacement.assign(3,0.0); // state? 
 	
 	assign_orientation();
 	container = NULL;
@@ -392,7 +449,11 @@ Cell* Cell::divide( )
 	// phenotype.flagged_for_division = false; 
 	// phenotype.flagged_for_removal = false; 
 	
-	Cell* child = create_cell();
+	return divide( create_cell() ); 
+}
+
+Cell* Cell::divide( Cell* child )
+{
 	child->copy_data( this );	
 	child->copy_function_pointers(this);
 	child->parameters = parameters;
@@ -557,6 +618,27 @@ void Cell::die()
 	return; 
 } 
 
+// Adams-Bashforth constants, set from the first mechanics time step 
+static double d1; 
+static double d2; 
+static bool constants_defined = false; 
+
+void get_position_update_constants( double& d1_out , double& d2_out , bool& defined_out )
+{
+	d1_out = d1; 
+	d2_out = d2; 
+	defined_out = constants_defined; 
+	return; 
+}
+
+void set_position_update_constants( double d1_in , double d2_in , bool defined_in )
+{
+	d1 = d1_in; 
+	d2 = d2_in; 
+	constants_defined = defined_in; 
+	return; 
+}
+
 void Cell::update_position( double dt )
 {
 	// BioFVM Basic_Agent::update_position(dt) returns without doing anything. 
@@ -565,9 +647,6 @@ void Cell::update_position( double dt )
 	// Basic_Agent::update_position(dt);
 		
 	// use Adams-Bashforth 
-	static double d1; 
-	static double d2; 
-	static bool constants_defined = false; 
 	if( constants_defined == false )
 	{
 		d1 = dt; 
@@ -666,8 +745,8 @@ void Cell::copy_data(Cell* copy_me)
 	
 	velocity = copy_me->velocity; 
 	// expected_phenotype = copy_me-> expected_phenotype; //it is taken care in set_phenotype
-	cell_source_sink_solver_temp1 = std::vector<double>(copy_me->cell_source_sink_solver_temp1);
-	cell_source_sink_solver_temp2 = std::vector<double>(copy_me->cell_source_sink_solver_temp2);
+	cell_source_sink_solver_temp1 = copy_me->cell_source_sink_solver_temp1;
+	cell_source_sink_solver_temp2 = copy_me->cell_source_sink_solver_temp2;
 	
 	return; 
 }
@@ -768,10 +847,172 @@ void Cell::add_potentials(Cell* other_agent)
 	return;
 }
 
+// Cell objects are carved out of large slabs, and freed slots are reused. 
+// Derived classes (of another size) use the global allocator. Slabs with 
+// no cells left are released by release_unused_cell_memory(), and the rest 
+// at exit. 
+class Cell_Slab_Pool
+{
+ public:
+	static const int cells_per_slab = 256; 
+	std::vector<char*> slabs; 
+	std::vector<void*> free_slots; 
+	
+	~Cell_Slab_Pool()
+	{
+		for( unsigned int n=0; n < slabs.size(); n++ )
+		{ ::operator delete( slabs[n] ); }
+	}
+}; 
+static Cell_Slab_Pool cell_slab_pool; 
+
+void* Cell::operator new( std::size_t size )
+{
+	if( size != sizeof(Cell) )
+	{ return ::operator new( size ); }
+
+	int cells_per_slab = Cell_Slab_Pool::cells_per_slab; 
+	void* pSlot; 
+	#pragma omp critical(cell_slab)
+	{
+		std::vector<void*>& free_slots = cell_slab_pool.free_slots; 
+		if( free_slots.size() == 0 )
+		{
+			char* slab = (char*) ::operator new( cells_per_slab * sizeof(Cell) ); 
+			cell_slab_pool.slabs.push_back( slab ); 
+			for( int n=cells_per_slab-1; n >= 0; n-- )
+			{ free_slots.push_back( slab + n*sizeof(Cell) ); }
+		}
+		pSlot = free_slots.back(); 
+		free_slots.pop_back(); 
+	}
+	return pSlot; 
+}
+
+void Cell::operator delete( void* pSlot , std::size_t size )
+{
+	if( size != sizeof(Cell) )
+	{ ::operator delete( pSlot ); return; }
+
+	#pragma omp critical(cell_slab)
+	{ cell_slab_pool.free_slots.push_back( pSlot ); }
+	return; 
+}
+
+// Removed cells are kept whole (with all their vectors, strings, etc.), 
+// so that a new cell usually just overwrites one of them with the 
+// defaults, without any heap allocation. At most as many are kept as there 
+// are live cells (or a slab's worth), so that the memory of a large die-off 
+// goes back; the others are deleted. Those kept are deleted at exit, before 
+// the slabs that hold them (static objects go in reverse order). 
+class Recycled_Cells : public std::vector<Cell*>
+{
+ public:
+	~Recycled_Cells()
+	{
+		for( unsigned int n=0; n < size(); n++ )
+		{ delete (*this)[n]; }
+	}
+}; 
+static Recycled_Cells recycled_cells; 
+
+static unsigned int max_recycled_cells( void )
+{ return std::max( (unsigned int) Cell_Slab_Pool::cells_per_slab , (unsigned int) (*all_cells).size() ); }
+
+Cell* allocate_cell( void )
+{
+	Cell* pNew = NULL; 
+	#pragma omp critical(recycled_cells)
+	{
+		if( recycled_cells.size() > 0 )
+		{
+			pNew = recycled_cells.back(); 
+			recycled_cells.pop_back(); 
+		}
+	}
+	if( pNew == NULL )
+	{ return new Cell; }
+
+	pNew->reset(); 
+	return pNew; 
+}
+
+void recycle_cell( Cell* pCell )
+{
+	bool kept = false; 
+	#pragma omp critical(recycled_cells)
+	{
+		if( recycled_cells.size() < max_recycled_cells() )
+		{
+			recycled_cells.push_back( pCell ); 
+			kept = true; 
+		}
+	}
+	if( !kept )
+	{ delete pCell; }
+	return; 
+}
+
+void release_unused_cell_memory( void )
+{
+	// the removed cells beyond the limit 
+	std::vector<Cell*> excess; 
+	#pragma omp critical(recycled_cells)
+	{
+		unsigned int limit = max_recycled_cells(); 
+		if( recycled_cells.size() > limit )
+		{
+			excess.assign( recycled_cells.begin() + limit , recycled_cells.end() ); 
+			recycled_cells.resize( limit ); 
+		}
+	}
+	for( unsigned int n=0; n < excess.size(); n++ )
+	{ delete excess[n]; }
+
+	// the slabs whose slots are all free 
+	#pragma omp critical(cell_slab)
+	{
+		std::vector<char*>& slabs = cell_slab_pool.slabs; 
+		std::vector<void*>& free_slots = cell_slab_pool.free_slots; 
+		int cells_per_slab = Cell_Slab_Pool::cells_per_slab; 
+		if( free_slots.size() >= (unsigned int) cells_per_slab )
+		{
+			std::sort( slabs.begin() , slabs.end() ); 
+			std::vector<int> free_in_slab( slabs.size() , 0 ); 
+			for( unsigned int n=0; n < free_slots.size(); n++ )
+			{
+				int s = std::upper_bound( slabs.begin() , slabs.end() , (char*) free_slots[n] ) - slabs.begin() - 1; 
+				free_in_slab[s]++; 
+			}
+			
+			// keep the free slots of the other slabs in the same order 
+			unsigned int kept = 0; 
+			for( unsigned int n=0; n < free_slots.size(); n++ )
+			{
+				int s = std::upper_bound( slabs.begin() , slabs.end() , (char*) free_slots[n] ) - slabs.begin() - 1; 
+				if( free_in_slab[s] < cells_per_slab )
+				{ free_slots[kept++] = free_slots[n]; }
+			}
+			free_slots.resize( kept ); 
+			
+			unsigned int kept_slabs = 0; 
+			for( unsigned int s=0; s < slabs.size(); s++ )
+			{
+				if( free_in_slab[s] == cells_per_slab )
+				{ ::operator delete( slabs[s] ); }
+				else
+				{ slabs[kept_slabs++] = slabs[s]; }
+			}
+			slabs.resize( kept_slabs ); 
+		}
+	}
+	return; 
+}
+
 Cell* create_cell( void )
 {
 	Cell* pNew; 
-	pNew = new Cell;		
+	pNew = allocate_cell();		
 	(*all_cells).push_back( pNew ); 
 	pNew->index=(*all_cells).size()-1;
 	
@@ -841,8 +1082,8 @@ void delete_cell( int index )
 	
 	// deregister agent in from the agent container
 	(*all_cells)[index]->get_container()->remove_agent((*all_cells)[index]);
-	// de-allocate (delete) the cell; 
-	delete (*all_cells)[index]; 
+	// keep the cell's storage for reuse by the next new cell 
+	recycle_cell( (*all_cells)[index] ); 
 
 	// performance goal: don't delete in the middle -- very expensive reallocation
 	// alternative: copy last element to index position, then shrink vector by 1 at the end O(constant)
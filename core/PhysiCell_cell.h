@@ -74,6 +74,7 @@
 #include "./PhysiCell_phenotype.h"
 #include "./PhysiCell_cell_container.h"
 #include "./PhysiCell_constants.h"
+#include "./PhysiCell_utilities.h"
 
 using namespace BioFVM; 
 
@@ -127,15 +128,21 @@ class Cell_Definition
 	Cell_Definition();  // done 
 	Cell_Definition( Cell_Definition& cd ); // copy constructor 
 	Cell_Definition& operator=( const Cell_Definition& cd ); // copy assignment 
+	~Cell_Definition(); 
 };
 
 extern Cell_Definition cell_defaults; 
 
+// every Cell_Definition in existence, in order of construction (each one 
+// registers itself), so that definitions can be found by name 
+std::vector<Cell_Definition*>& all_cell_definitions( void ); 
+Cell_Definition* find_cell_definition( std::string name ); // the first one, or NULL 
+
 class Cell_State
 {
  public:
 	std::vector<Cell*> neighbors; // not currently tracked! 
-	std::vector<double> orientation;
+	Vec3 orientation;
 	
 	double simple_pressure; 
 	
@@ -148,6 +155,8 @@ class Cell : public Basic_Agent
 	Cell_Container * container;
 	int current_mechanics_voxel_index;
 	int updated_current_mechanics_voxel_index; // keeps the updated voxel index for later adjusting of current voxel index
+	friend class Cell_Container; // updates the voxel indices above in parallel after each mechanics step
+	void reset_cell_data( void ); // shared by Cell() and reset()
 		
  public:
 	std::string type_name; 
@@ -158,6 +167,7 @@ class Cell : public Basic_Agent
 
 	Cell_State state; 
 	Phenotype phenotype; 
+	Random_Stream random_stream; // keyed by ID; used while the container updates this cell
 	
 	void update_motility_vector( double dt_ );
 	void advance_bundled_phenotype_functions( double dt_ ); 
@@ -177,9 +187,15 @@ class Cell : public Basic_Agent
 	void lyse_cell( void ); 
 
 	Cell* divide( void );
+	Cell* divide( Cell* child ); // divide into a cell the caller already created
 	void die( void );
 	void step(double dt);
 	Cell();
+	void reset( void ); // back to a new cell (with a new ID), keeping the allocated storage 
+
+	// slab allocation of Cell objects (see create_cell) 
+	static void* operator new( std::size_t size ); 
+	static void operator delete( void* pSlot , std::size_t size ); 
 	
 	bool assign_position(std::vector<double> new_position);
 	bool assign_position(double, double, double);
@@ -189,7 +205,7 @@ class Cell : public Basic_Agent
 	
 	// mechanics 
 	void update_position( double dt ); //
-	std::vector<double> displacement; // this should be moved to state, or made private  
+	Vec3 displacement; // this should be moved to state, or made private  
 
 	
 	void assign_orientation();  // if set_orientaion is defined, uses it to assign the orientation
@@ -217,11 +233,19 @@ class Cell : public Basic_Agent
 Cell* create_cell( void );  
 Cell* create_cell( Cell_Definition& cd );  
 
+Cell* allocate_cell( void ); // a new cell, not yet in all_cells; reuses a removed cell if one is available 
+void recycle_cell( Cell* pCell ); // keep a removed cell for allocate_cell() 
+void release_unused_cell_memory( void ); // after removing many cells: trim the kept cells, free empty slabs 
+
 
 void delete_cell( int ); 
 void delete_cell( Cell* ); 
 void save_all_cells_to_matlab( std::string filename ); 
 
+// for checkpoints: the Adams-Bashforth constants used by Cell::update_position 
+void get_position_update_constants( double& d1 , double& d2 , bool& defined ); 
+void set_position_update_constants( double d1 , double d2 , bool defined ); 
+
 //function to check if a neighbor voxel contains any cell that can interact with me
 bool is_neighbor_voxel(Cell* pCell, std::vector<double> myVoxelCenter, std::vector<double> otherVoxelCenter, int otherVoxelIndex);  
 
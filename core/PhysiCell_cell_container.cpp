@@ -65,6 +65,11 @@
 ###############################################################################
 */
 
+#include <algorithm>
+#include <omp.h>
+#if defined(__AVX2__) || defined(__AVX512F__)
+#include <immintrin.h>
+#endif
 #include "../BioFVM/BioFVM_agent_container.h"
 #include "PhysiCell_constants.h"
 #include "../BioFVM/BioFVM_vector.h"
@@ -86,6 +91,15 @@ Cell_Container::Cell_Container()
 	return; 
 }	
 	
+bool Cell_Container::is_initialized( void )
+{ return initialzed; }
+
+void Cell_Container::set_initialized( bool value )
+{
+	initialzed = value; 
+	return; 
+}	
+	
 void Cell_Container::initialize(double x_start, double x_end, double y_start, double y_end, double z_start, double z_end , double voxel_size)
 {
 	initialize(x_start, x_end, y_start, y_end, z_start, z_end , voxel_size, voxel_size, voxel_size);
@@ -104,10 +118,26 @@ void Cell_Container::initialize(double x_start, double x_end, double y_start, do
 	agent_grid.resize(underlying_mesh.voxels.size());
 	max_cell_interactive_distance_in_voxel.resize(underlying_mesh.voxels.size(), 0.0);
 	agents_in_outer_voxels.resize(6);
+	size_flag_buffers(); 
+
+	// color the voxels for the pair potentials: same-colored voxels are at
+	// least 3 voxels apart in some direction, so they never share a neighbor
+	mechanics_voxel_colors.assign( 27 , std::vector<int>() ); 
+	for( int n=0; n < underlying_mesh.voxels.size(); n++ )
+	{
+		std::vector<unsigned int> ijk = underlying_mesh.cartesian_indices( n ); 
+		mechanics_voxel_colors[ ijk[0]%3 + 3*(ijk[1]%3) + 9*(ijk[2]%3) ].push_back( n ); 
+	}
 	
 	return; 
 }
  
+bool compare_cell_index( Cell* pA, Cell* pB )
+{ return pA->index < pB->index; }
+
+bool compare_cell_ID( Cell* pA, Cell* pB )
+{ return pA->ID < pB->ID; }
+ 
 void Cell_Container::update_all_cells(double t)
 {
 	// update_all_cells(t, dt_settings.cell_cycle_dt_default, dt_settings.mechanics_dt_default);
@@ -243,12 +273,52 @@ void Cell_Container::update_all_cells(double t, double phenotype_dt_ , double me
 
 void Cell_Container::update_all_cells(double t, double phenotype_dt_ , double mechanics_dt_ , double diffusion_dt_ )
 {
+	static int secretion_section = PhysiCell_profiler.section_index( "secretion" , true ); 
+	static int phenotype_section = PhysiCell_profiler.section_index( "phenotype" , true ); 
+	static int division_death_section = PhysiCell_profiler.section_index( "division_death" ); 
+	static int velocity_section = PhysiCell_profiler.section_index( "velocity" , true ); 
+	static int position_section = PhysiCell_profiler.section_index( "position" , true ); 
+	static int voxel_section = PhysiCell_profiler.section_index( "voxel_rebinning" ); 
+
+	// one flag buffer per thread (the thread count may have changed) 
+	size_flag_buffers(); 
+
 	// secretions and uptakes. Syncing with BioFVM is automated. 
+	// Cells are grouped by voxel, and each voxel is handled by one thread,
+	// so cells sharing a voxel never race on its density vector.
+	// If the diffusion step took care of this (the fused and quasi-steady 
+	// solvers; see cell_source_sink_function and cell_source_sink_rates_function), 
+	// it is skipped here. 
 
-	#pragma omp parallel for 
-	for( int i=0; i < (*all_cells).size(); i++ )
+	if( microenvironment.solver_applied_cell_sources_and_sinks == false )
 	{
-		(*all_cells)[i]->phenotype.secretion.advance( (*all_cells)[i], (*all_cells)[i]->phenotype , diffusion_dt_ );
+		PhysiCell_profiler.start( secretion_section ); 
+		microenvironment.sort_agents_by_voxel( all_basic_agents );
+
+		#pragma omp parallel 
+		{
+			PhysiCell_profiler.thread_start( secretion_section ); 
+			#pragma omp for
+			for( int n=0; n < microenvironment.occupied_voxels.size(); n++ )
+			{
+				for( int m=microenvironment.agents_by_voxel_start[n]; m < microenvironment.agents_by_voxel_start[n+1]; m++ )
+				{
+					Cell* pCell = (*all_cells)[ microenvironment.agents_by_voxel[m] ];
+					pCell->phenotype.secretion.advance( pCell, pCell->phenotype , diffusion_dt_ );
+				}
+			}
+
+			// cells outside the mesh are inactive (no secretion or uptake),
+			// but still need their rate vectors synced
+			#pragma omp for nowait
+			for( int m=0; m < microenvironment.agents_outside_mesh.size(); m++ )
+			{
+				Cell* pCell = (*all_cells)[ microenvironment.agents_outside_mesh[m] ];
+				pCell->phenotype.secretion.advance( pCell, pCell->phenotype , diffusion_dt_ );
+			}
+			PhysiCell_profiler.thread_stop( secretion_section ); 
+		}
+		PhysiCell_profiler.stop( secretion_section ); 
 	}
 	
 	//if it is the time for running cell cycle, do it!
@@ -270,24 +340,30 @@ void Cell_Container::update_all_cells(double t, double phenotype_dt_ , double me
 		
 		// new as of 1.2.1 -- bundles cell phenotype parameter update, volume update, geometry update, 
 		// checking for death, and advancing the cell cycle. Not motility, though. (that's in mechanics)
-		#pragma omp parallel for 
-		for( int i=0; i < (*all_cells).size(); i++ )
+		PhysiCell_profiler.start( phenotype_section ); 
+		#pragma omp parallel 
 		{
-			if((*all_cells)[i]->is_out_of_domain)
-			{ continue; }
-			// (*all_cells)[i]->phenotype.advance_bundled_models( (*all_cells)[i] , time_since_last_cycle ); 
-			(*all_cells)[i]->advance_bundled_phenotype_functions( time_since_last_cycle ); 
+			PhysiCell_profiler.thread_start( phenotype_section ); 
+			#pragma omp for nowait
+			for( int i=0; i < (*all_cells).size(); i++ )
+			{
+				if((*all_cells)[i]->is_out_of_domain)
+				{ continue; }
+				// (*all_cells)[i]->phenotype.advance_bundled_models( (*all_cells)[i] , time_since_last_cycle ); 
+				set_random_stream( &(*all_cells)[i]->random_stream ); 
+				(*all_cells)[i]->advance_bundled_phenotype_functions( time_since_last_cycle ); 
+				set_random_stream( NULL ); 
+			}
+			PhysiCell_profiler.thread_stop( phenotype_section ); 
 		}
+		PhysiCell_profiler.stop( phenotype_section ); 
 		
 		// process divides / removes 
-		for( int i=0; i < cells_ready_to_divide.size(); i++ )
-		{
-			cells_ready_to_divide[i]->divide();
-		}
-		for( int i=0; i < cells_ready_to_die.size(); i++ )
-		{	
-			cells_ready_to_die[i]->die();	
-		}
+		PhysiCell_profiler.start( division_death_section ); 
+		merge_flag_buffers(); 
+		divide_flagged_cells(); 
+		remove_flagged_cells(); 
+		PhysiCell_profiler.stop( division_death_section ); 
 		num_divisions_in_current_step+=  cells_ready_to_divide.size();
 		num_deaths_in_current_step+=  cells_ready_to_die.size();
 		
@@ -306,45 +382,69 @@ void Cell_Container::update_all_cells(double t, double phenotype_dt_ , double me
 			time_since_last_mechanics = mechanics_dt_;
 		}
 		
-		// new February 2018 
-		// if we need gradients, compute them
-		if( default_microenvironment_options.calculate_gradients ) 
-		{ microenvironment.compute_all_gradient_vectors();  }
-		// end of new in Feb 2018 		
+		// gradients are computed on demand (see Microenvironment::gradient_vector) 
 		
+		// divisions and deaths since the last step change the cell list
+		PhysiCell_profiler.start( voxel_section ); 
+		if( cell_list_out_of_date )
+		{ sort_cells_by_voxel(); }
+		PhysiCell_profiler.stop( voxel_section ); 
+
+		// copy positions, sizes, and mechanics parameters into contiguous arrays,
+		// then evaluate all the cell-cell potentials there
+		PhysiCell_profiler.start( velocity_section ); 
+		sync_mechanics_data();
+		compute_mechanics_potentials();
+
 		// Compute velocities
-		#pragma omp parallel for 
-		for( int i=0; i < (*all_cells).size(); i++ )
+		#pragma omp parallel 
 		{
-
-			if(!(*all_cells)[i]->is_out_of_domain && (*all_cells)[i]->is_movable && (*all_cells)[i]->functions.update_velocity )
+			PhysiCell_profiler.thread_start( velocity_section ); 
+			#pragma omp for nowait
+			for( int i=0; i < (*all_cells).size(); i++ )
 			{
-				// update_velocity already includes the motility update 
-				//(*all_cells)[i]->phenotype.motility.update_motility_vector( (*all_cells)[i] ,(*all_cells)[i]->phenotype , time_since_last_mechanics ); 
-				(*all_cells)[i]->functions.update_velocity( (*all_cells)[i], (*all_cells)[i]->phenotype, time_since_last_mechanics);
-			}
+				set_random_stream( &(*all_cells)[i]->random_stream ); 
 
-			if( (*all_cells)[i]->functions.custom_cell_rule )
-			{
-				(*all_cells)[i]->functions.custom_cell_rule((*all_cells)[i], (*all_cells)[i]->phenotype, time_since_last_mechanics);
+				if(!(*all_cells)[i]->is_out_of_domain && (*all_cells)[i]->is_movable && (*all_cells)[i]->functions.update_velocity )
+				{
+					// update_velocity already includes the motility update
+					//(*all_cells)[i]->phenotype.motility.update_motility_vector( (*all_cells)[i] ,(*all_cells)[i]->phenotype , time_since_last_mechanics );
+					(*all_cells)[i]->functions.update_velocity( (*all_cells)[i], (*all_cells)[i]->phenotype, time_since_last_mechanics);
+				}
+
+				if( (*all_cells)[i]->functions.custom_cell_rule )
+				{
+					(*all_cells)[i]->functions.custom_cell_rule((*all_cells)[i], (*all_cells)[i]->phenotype, time_since_last_mechanics);
+				}
+
+				set_random_stream( NULL ); 
 			}
+			PhysiCell_profiler.thread_stop( velocity_section ); 
 		}
+		mechanics_data_synced = false;
+		PhysiCell_profiler.stop( velocity_section ); 
+
 		// Calculate new positions
-		#pragma omp parallel for 
-		for( int i=0; i < (*all_cells).size(); i++ )
+		PhysiCell_profiler.start( position_section ); 
+		#pragma omp parallel 
 		{
-			if(!(*all_cells)[i]->is_out_of_domain && (*all_cells)[i]->is_movable)
+			PhysiCell_profiler.thread_start( position_section ); 
+			#pragma omp for nowait
+			for( int i=0; i < (*all_cells).size(); i++ )
 			{
-				(*all_cells)[i]->update_position(time_since_last_mechanics);
+				if(!(*all_cells)[i]->is_out_of_domain && (*all_cells)[i]->is_movable)
+				{
+					(*all_cells)[i]->update_position(time_since_last_mechanics);
+				}
 			}
+			PhysiCell_profiler.thread_stop( position_section ); 
 		}
+		PhysiCell_profiler.stop( position_section ); 
 		
-		// When somebody reviews this code, let's add proper braces for clarity!!! 
-		
-		// Update cell indices in the container
-		for( int i=0; i < (*all_cells).size(); i++ )
-			if(!(*all_cells)[i]->is_out_of_domain && (*all_cells)[i]->is_movable)
-				(*all_cells)[i]->update_voxel_in_container();
+		// Update cell indices in the container, and rebuild the cell list
+		PhysiCell_profiler.start( voxel_section ); 
+		update_all_mechanics_voxels();
+		PhysiCell_profiler.stop( voxel_section ); 
 		last_mechanics_time=t;
 	}
 	
@@ -354,26 +454,35 @@ void Cell_Container::update_all_cells(double t, double phenotype_dt_ , double me
 
 void Cell_Container::register_agent( Cell* agent )
 {
+	if( agent_grid_updates_deferred )
+	{ return; }
 	agent_grid[agent->get_current_mechanics_voxel_index()].push_back(agent);
+	cell_list_out_of_date = true; 
 	return; 
 }
 
 void Cell_Container::remove_agent(Cell* agent )
 {
+	if( agent_grid_updates_deferred )
+	{ return; }
 	remove_agent_from_voxel(agent, agent->get_current_mechanics_voxel_index());
+	cell_list_out_of_date = true; 
 	return; 
 }
 
 void Cell_Container::add_agent_to_outer_voxel(Cell* agent)
 {
 	int escaping_face= find_escaping_face_index(agent);
-	agents_in_outer_voxels[escaping_face].push_back(agent);
+	#pragma omp critical(outer_voxels)
+	{ agents_in_outer_voxels[escaping_face].push_back(agent); }
 	agent->is_out_of_domain=true;
 	return; 
 }
 
 void Cell_Container::remove_agent_from_voxel(Cell* agent, int voxel_index)
 {
+	if( agent_grid_updates_deferred )
+	{ return; }
 	int delete_index = 0; 
 	while( agent_grid[voxel_index][ delete_index ] != agent )
 	{
@@ -383,12 +492,103 @@ void Cell_Container::remove_agent_from_voxel(Cell* agent, int voxel_index)
 	agent_grid[agent->get_current_mechanics_voxel_index()][delete_index] = agent_grid[agent->get_current_mechanics_voxel_index()][agent_grid[agent->get_current_mechanics_voxel_index()].size()-1 ]; 
 	// shrink the vector
 	agent_grid[agent->get_current_mechanics_voxel_index()].pop_back(); 
+	cell_list_out_of_date = true; 
 	return; 
 }		
 
 void Cell_Container::add_agent_to_voxel(Cell* agent, int voxel_index)
 {
+	if( agent_grid_updates_deferred )
+	{ return; }
 	agent_grid[voxel_index].push_back(agent); 
+	cell_list_out_of_date = true; 
+	return; 
+}	
+
+void Cell_Container::sort_cells_by_voxel( void )
+{
+	int number_of_voxels = agent_grid.size(); 
+	int number_of_cells = (*all_cells).size(); 
+
+	// count the cells in each voxel 
+	voxel_cell_start.assign( number_of_voxels+1 , 0 ); 
+	#pragma omp parallel for 
+	for( int i=0; i < number_of_cells; i++ )
+	{
+		int voxel = (*all_cells)[i]->current_mechanics_voxel_index; 
+		if( voxel >= 0 )
+		{
+			#pragma omp atomic 
+			voxel_cell_start[voxel+1]++; 
+		}
+	}
+
+	// prefix sum: voxel n owns [ voxel_cell_start[n] , voxel_cell_start[n+1] ) 
+	for( int n=0; n < number_of_voxels; n++ )
+	{ voxel_cell_start[n+1] += voxel_cell_start[n]; }
+
+	// scatter the cells into their voxel's range 
+	voxel_next_slot.assign( voxel_cell_start.begin() , voxel_cell_start.end()-1 ); 
+	cells_in_voxel_order.resize( voxel_cell_start[number_of_voxels] ); 
+	#pragma omp parallel for 
+	for( int i=0; i < number_of_cells; i++ )
+	{
+		Cell* pCell = (*all_cells)[i]; 
+		int voxel = pCell->current_mechanics_voxel_index; 
+		if( voxel < 0 )
+		{ continue; }
+		int slot; 
+		#pragma omp atomic capture 
+		slot = voxel_next_slot[voxel]++; 
+		cells_in_voxel_order[slot] = pCell; 
+	}
+
+	// threads scatter in any order, so sort each range by cell index 
+	// to keep the traversal order (and the results) deterministic. 
+	// The agent_grid view is rebuilt from the same ranges. 
+	voxel_order_index.assign( number_of_cells , -1 ); 
+	#pragma omp parallel for 
+	for( int n=0; n < number_of_voxels; n++ )
+	{
+		std::vector<Cell*>::iterator first = cells_in_voxel_order.begin() + voxel_cell_start[n]; 
+		std::vector<Cell*>::iterator last = cells_in_voxel_order.begin() + voxel_cell_start[n+1]; 
+		std::sort( first , last , compare_cell_index ); 
+		agent_grid[n].assign( first , last ); 
+
+		for( int p=voxel_cell_start[n]; p < voxel_cell_start[n+1]; p++ )
+		{ voxel_order_index[ cells_in_voxel_order[p]->index ] = p; }
+	}
+
+	cell_list_out_of_date = false; 
+	return; 
+}
+
+void Cell_Container::update_all_mechanics_voxels( void )
+{
+	// same as calling Cell::update_voxel_in_container on each moved cell, 
+	// but in parallel: the agent_grid is rebuilt afterwards instead 
+	#pragma omp parallel for 
+	for( int i=0; i < (*all_cells).size(); i++ )
+	{
+		Cell* pCell = (*all_cells)[i]; 
+		if( pCell->is_out_of_domain || !pCell->is_movable )
+		{ continue; }
+
+		// microenvironment voxel index 
+		pCell->update_voxel_index(); 
+
+		// updated_current_mechanics_voxel_index is updated in update_position 
+		if( pCell->updated_current_mechanics_voxel_index == -1 )
+		{
+			add_agent_to_outer_voxel( pCell ); 
+			pCell->current_mechanics_voxel_index = -1; 
+			pCell->is_active = false; 
+			continue; 
+		}
+		pCell->current_mechanics_voxel_index = pCell->updated_current_mechanics_voxel_index; 
+	}
+
+	sort_cells_by_voxel(); 
 	return; 
 }	
 
@@ -417,18 +617,564 @@ int find_escaping_face_index(Cell* agent)
 
 void Cell_Container::flag_cell_for_division( Cell* pCell )
 { 
-	#pragma omp critical 
-	{cells_ready_to_divide.push_back( pCell );} 
+	// each thread has its own buffer, so no critical section is needed 
+	cells_ready_to_divide_by_thread[ omp_get_thread_num() ].push_back( pCell ); 
 	return; 
 }
 
 void Cell_Container::flag_cell_for_removal( Cell* pCell )
 { 
-	#pragma omp critical 
-	{cells_ready_to_die.push_back( pCell );} 
+	cells_ready_to_die_by_thread[ omp_get_thread_num() ].push_back( pCell ); 
+	return; 
+}
+
+void Cell_Container::size_flag_buffers( void )
+{
+	int number_of_threads = omp_get_max_threads(); 
+	if( cells_ready_to_divide_by_thread.size() < number_of_threads )
+	{
+		cells_ready_to_divide_by_thread.resize( number_of_threads ); 
+		cells_ready_to_die_by_thread.resize( number_of_threads ); 
+	}
 	return; 
 }
 
+void Cell_Container::merge_flag_buffers( void )
+{
+	for( int n=0; n < cells_ready_to_divide_by_thread.size(); n++ )
+	{
+		cells_ready_to_divide.insert( cells_ready_to_divide.end(), 
+			cells_ready_to_divide_by_thread[n].begin() , cells_ready_to_divide_by_thread[n].end() ); 
+		cells_ready_to_divide_by_thread[n].clear(); 
+
+		cells_ready_to_die.insert( cells_ready_to_die.end(), 
+			cells_ready_to_die_by_thread[n].begin() , cells_ready_to_die_by_thread[n].end() ); 
+		cells_ready_to_die_by_thread[n].clear(); 
+	}
+
+	// the buffers depend on which thread handled which cell; sort by 
+	// ID so that new cells get the same IDs for any number of threads 
+	std::sort( cells_ready_to_divide.begin() , cells_ready_to_divide.end() , compare_cell_ID ); 
+	std::sort( cells_ready_to_die.begin() , cells_ready_to_die.end() , compare_cell_ID ); 
+	return; 
+}
+
+void Cell_Container::divide_flagged_cells( void )
+{
+	int number_of_divisions = cells_ready_to_divide.size(); 
+	if( number_of_divisions == 0 )
+	{ return; }
+
+	// the agent_grid is rebuilt from the cell list after the batch 
+	agent_grid_updates_deferred = true; 
+	cell_list_out_of_date = true; 
+
+	// allocate the children, appended to all_cells in parent order. 
+	// The constructors draw from the parents' streams, as in Cell::divide(). 
+	int first_child = (*all_cells).size(); 
+	(*all_cells).resize( first_child + number_of_divisions ); 
+	#pragma omp parallel for 
+	for( int n=0; n < number_of_divisions; n++ )
+	{
+		set_random_stream( &cells_ready_to_divide[n]->random_stream ); 
+		Cell* pChild = allocate_cell(); 
+		if( BioFVM::get_default_microenvironment() )
+		{ pChild->register_microenvironment( BioFVM::get_default_microenvironment() ); }
+		pChild->index = first_child + n; 
+		(*all_cells)[ first_child + n ] = pChild; 
+		set_random_stream( NULL ); 
+	}
+
+	// the constructors took a contiguous block of IDs in some thread 
+	// order; hand them out in parent order instead 
+	int first_ID = (*all_cells)[first_child]->ID; 
+	for( int n=1; n < number_of_divisions; n++ )
+	{ first_ID = std::min( first_ID , (*all_cells)[first_child+n]->ID ); }
+
+	#pragma omp parallel for 
+	for( int n=0; n < number_of_divisions; n++ )
+	{
+		Cell* pChild = (*all_cells)[ first_child + n ]; 
+		pChild->ID = first_ID + n; 
+		pChild->random_stream.stream_id = pChild->ID; 
+
+		set_random_stream( &cells_ready_to_divide[n]->random_stream ); 
+		cells_ready_to_divide[n]->divide( pChild ); 
+		set_random_stream( NULL ); 
+	}
+
+	agent_grid_updates_deferred = false; 
+	return; 
+}
+
+void Cell_Container::remove_flagged_cells( void )
+{
+	if( cells_ready_to_die.size() == 0 )
+	{ return; }
+
+	int number_of_cells = (*all_cells).size(); 
+	std::vector<char>& removing = cells_being_removed; 
+	removing.assign( number_of_cells , 0 ); 
+
+	// releasing substrates writes to shared voxels, and taking the cells out 
+	// of the agent_grid to shared voxel lists, so this part is serial 
+	std::vector<Cell*> cells_to_delete; 
+	for( int n=0; n < cells_ready_to_die.size(); n++ )
+	{
+		Cell* pCell = cells_ready_to_die[n]; 
+		if( removing[ pCell->index ] )
+		{ continue; } // flagged twice 
+		removing[ pCell->index ] = 1; 
+		pCell->release_internalized_substrates(); 
+		cells_to_delete.push_back( pCell ); 
+
+		// as in remove_agent(), but a cell moved while the grid updates were 
+		// deferred (in divide_flagged_cells) may not be in its voxel's list 
+		int voxel = pCell->get_current_mechanics_voxel_index(); 
+		if( voxel >= 0 )
+		{
+			std::vector<Cell*>& voxel_cells = agent_grid[voxel]; 
+			std::vector<Cell*>::iterator it = std::find( voxel_cells.begin() , voxel_cells.end() , pCell ); 
+			if( it != voxel_cells.end() )
+			{
+				*it = voxel_cells.back(); 
+				voxel_cells.pop_back(); 
+			}
+		}
+	}
+
+	cell_list_out_of_date = true; 
+
+	// keep the storage for new cells 
+	for( int n=0; n < cells_to_delete.size(); n++ )
+	{ recycle_cell( cells_to_delete[n] ); }
+
+	// stable, parallel compaction of all_cells: each thread counts the 
+	// survivors in its block, then copies them after those of the 
+	// earlier blocks 
+	std::vector<Cell*>& compacted = compacted_cells; 
+	compacted.resize( number_of_cells - cells_to_delete.size() ); 
+	std::vector<int> kept_before( omp_get_max_threads() + 1 , 0 ); 
+
+	#pragma omp parallel 
+	{
+		int thread = omp_get_thread_num(); 
+		int number_of_threads = omp_get_num_threads(); 
+		int first = (long long) number_of_cells * thread / number_of_threads; 
+		int last = (long long) number_of_cells * (thread+1) / number_of_threads; 
+
+		int kept = 0; 
+		for( int i=first; i < last; i++ )
+		{
+			if( !removing[i] )
+			{ kept++; }
+		}
+		kept_before[thread+1] = kept; 
+
+		#pragma omp barrier 
+		#pragma omp single 
+		{
+			for( int n=0; n < number_of_threads; n++ )
+			{ kept_before[n+1] += kept_before[n]; }
+		}
+
+		int slot = kept_before[thread]; 
+		for( int i=first; i < last; i++ )
+		{
+			if( !removing[i] )
+			{
+				compacted[slot] = (*all_cells)[i]; 
+				compacted[slot]->index = slot; 
+				slot++; 
+			}
+		}
+	}
+	(*all_cells).swap( compacted ); 
+
+	release_unused_cell_memory(); 
+	return; 
+}
+
+
+void Cell_Mechanics_Data::resize( int n )
+{
+	x.resize( n );
+	y.resize( n );
+	z.resize( n );
+	radius.resize( n );
+	sqrt_repulsion.resize( n );
+	sqrt_adhesion.resize( n );
+	max_adhesion_distance.resize( n );
+
+	velocity_x.resize( n );
+	velocity_y.resize( n );
+	velocity_z.resize( n );
+	simple_pressure.resize( n );
+	return;
+}
+
+int Cell_Mechanics_Data::size( void )
+{ return x.size(); }
+
+void Cell_Container::sync_mechanics_data( void )
+{
+	mechanics_data.resize( cells_in_voxel_order.size() );
+
+	#pragma omp parallel for
+	for( int i=0; i < cells_in_voxel_order.size(); i++ )
+	{
+		Cell* pCell = cells_in_voxel_order[i];
+		mechanics_data.x[i] = pCell->position[0];
+		mechanics_data.y[i] = pCell->position[1];
+		mechanics_data.z[i] = pCell->position[2];
+		mechanics_data.radius[i] = pCell->phenotype.geometry.radius;
+		mechanics_data.sqrt_repulsion[i] = sqrt( pCell->phenotype.mechanics.cell_cell_repulsion_strength );
+		mechanics_data.sqrt_adhesion[i] = sqrt( pCell->phenotype.mechanics.cell_cell_adhesion_strength );
+		mechanics_data.max_adhesion_distance[i] = pCell->phenotype.mechanics.relative_maximum_adhesion_distance
+			* pCell->phenotype.geometry.radius;
+
+		mechanics_data.velocity_x[i] = 0.0;
+		mechanics_data.velocity_y[i] = 0.0;
+		mechanics_data.velocity_z[i] = 0.0;
+		mechanics_data.simple_pressure[i] = 0.0;
+	}
+
+	mechanics_data_synced = true;
+	return;
+}
+
+int Cell_Container::mechanics_data_index( Cell* pCell )
+{
+	if( !mechanics_data_synced || cell_list_out_of_date || pCell->index >= voxel_order_index.size() )
+	{ return -1; }
+	return voxel_order_index[ pCell->index ];
+}
+
+// Same potentials as Cell::add_potentials, but reading both cells
+// from the mechanics arrays. The pair is evaluated once, and the
+// results are added to i and (with the opposite sign) to j.
+inline void add_mechanics_pair_potential( Cell_Mechanics_Data& M, int i, int j )
+{
+	// 12 uniform neighbors at a close packing distance, after dividing out all constants
+	static double simple_pressure_scale = 0.027288820670331; // 12 * (1 - sqrt(pi/(2*sqrt(3))))^2
+
+	double dx = M.x[i] - M.x[j];
+	double dy = M.y[i] - M.y[j];
+	double dz = M.z[i] - M.z[j];
+	double distance = dx*dx;
+	distance += dy*dy;
+	distance += dz*dz;
+
+	// skip pairs beyond both the repulsive and adhesive ranges
+	double R = M.radius[i] + M.radius[j];
+	double max_interactive_distance = M.max_adhesion_distance[i] + M.max_adhesion_distance[j];
+	double cutoff = std::max( R , max_interactive_distance );
+	if( distance > cutoff*cutoff )
+	{ return; }
+	distance = std::max( sqrt(distance), 0.00001 );
+
+	// repulsive
+	double temp_r = 0.0;
+	if( distance <= R )
+	{
+		temp_r = -distance; // -d
+		temp_r /= R; // -d/R
+		temp_r += 1.0; // 1-d/R
+		temp_r *= temp_r; // (1-d/R)^2
+
+		double pressure = temp_r / simple_pressure_scale;
+		M.simple_pressure[i] += pressure;
+		M.simple_pressure[j] += pressure;
+	}
+	temp_r *= M.sqrt_repulsion[i] * M.sqrt_repulsion[j];
+
+	// adhesive
+	if( distance < max_interactive_distance )
+	{
+		double temp_a = -distance; // -d
+		temp_a /= max_interactive_distance; // -d/S
+		temp_a += 1.0; // 1 - d/S
+		temp_a *= temp_a; // (1-d/S)^2
+		temp_a *= M.sqrt_adhesion[i] * M.sqrt_adhesion[j];
+
+		temp_r -= temp_a;
+	}
+
+	if( fabs(temp_r) < 1e-16 )
+	{ return; }
+	temp_r /= distance;
+
+	// equal and opposite
+	M.velocity_x[i] += dx * temp_r;
+	M.velocity_y[i] += dy * temp_r;
+	M.velocity_z[i] += dz * temp_r;
+	M.velocity_x[j] -= dx * temp_r;
+	M.velocity_y[j] -= dy * temp_r;
+	M.velocity_z[j] -= dz * temp_r;
+	return;
+}
+
+// Adds the potentials between cell i and each of the cells first, ..., last-1
+// (a contiguous block that does not contain i). The SIMD versions below
+// do the same math as add_mechanics_pair_potential, with masks in place of
+// its branches. The version is picked at build time by the ARCH in the
+// Makefile (-march): AVX-512, then AVX2, else this scalar loop.
+#if !defined(__AVX2__) && !defined(__AVX512F__)
+inline void add_mechanics_block_potentials( Cell_Mechanics_Data& M, int i, int first, int last )
+{
+	for( int j=first; j < last; j++ )
+	{ add_mechanics_pair_potential( M, i, j ); }
+	return;
+}
+#endif
+
+#ifdef __AVX512F__
+inline void add_mechanics_block_potentials( Cell_Mechanics_Data& M, int i, int first, int last )
+{
+	static double simple_pressure_scale = 0.027288820670331; // 12 * (1 - sqrt(pi/(2*sqrt(3))))^2
+
+	__m512d xi = _mm512_set1_pd( M.x[i] );
+	__m512d yi = _mm512_set1_pd( M.y[i] );
+	__m512d zi = _mm512_set1_pd( M.z[i] );
+	__m512d ri = _mm512_set1_pd( M.radius[i] );
+	__m512d si = _mm512_set1_pd( M.max_adhesion_distance[i] );
+	__m512d sqrt_rep_i = _mm512_set1_pd( M.sqrt_repulsion[i] );
+	__m512d sqrt_adh_i = _mm512_set1_pd( M.sqrt_adhesion[i] );
+
+	__m512d zero = _mm512_setzero_pd();
+	__m512d one = _mm512_set1_pd( 1.0 );
+	__m512d min_distance = _mm512_set1_pd( 0.00001 );
+	__m512d tolerance = _mm512_set1_pd( 1e-16 );
+	__m512d pressure_factor = _mm512_set1_pd( 1.0 / simple_pressure_scale );
+
+	__m512d vxi = zero;
+	__m512d vyi = zero;
+	__m512d vzi = zero;
+	__m512d pi = zero;
+
+	for( int j=first; j < last; j += 8 )
+	{
+		// the last block is partial
+		__mmask8 lanes = ( last-j >= 8 ) ? 0xFF : (__mmask8) ( (1 << (last-j)) - 1 );
+
+		__m512d dx = _mm512_sub_pd( xi , _mm512_maskz_loadu_pd( lanes, &M.x[j] ) );
+		__m512d dy = _mm512_sub_pd( yi , _mm512_maskz_loadu_pd( lanes, &M.y[j] ) );
+		__m512d dz = _mm512_sub_pd( zi , _mm512_maskz_loadu_pd( lanes, &M.z[j] ) );
+		__m512d distance = _mm512_mul_pd( dx, dx );
+		distance = _mm512_fmadd_pd( dy, dy, distance );
+		distance = _mm512_fmadd_pd( dz, dz, distance );
+
+		__m512d R = _mm512_add_pd( ri , _mm512_maskz_loadu_pd( lanes, &M.radius[j] ) );
+		__m512d S = _mm512_add_pd( si , _mm512_maskz_loadu_pd( lanes, &M.max_adhesion_distance[j] ) );
+		__m512d cutoff = _mm512_max_pd( R, S );
+		lanes = _mm512_mask_cmp_pd_mask( lanes, distance, _mm512_mul_pd( cutoff, cutoff ), _CMP_LE_OQ );
+		if( lanes == 0 )
+		{ continue; }
+		distance = _mm512_max_pd( _mm512_sqrt_pd( distance ), min_distance );
+
+		// repulsive
+		__mmask8 repulsive = _mm512_mask_cmp_pd_mask( lanes, distance, R, _CMP_LE_OQ );
+		__m512d temp_r = _mm512_maskz_sub_pd( repulsive, one, _mm512_div_pd( distance, R ) ); // 1-d/R
+		temp_r = _mm512_mul_pd( temp_r, temp_r ); // (1-d/R)^2
+
+		__m512d pressure = _mm512_mul_pd( temp_r, pressure_factor );
+		pi = _mm512_add_pd( pi, pressure );
+		_mm512_mask_storeu_pd( &M.simple_pressure[j], lanes,
+			_mm512_add_pd( _mm512_maskz_loadu_pd( lanes, &M.simple_pressure[j] ), pressure ) );
+
+		temp_r = _mm512_mul_pd( temp_r, _mm512_mul_pd( sqrt_rep_i, _mm512_maskz_loadu_pd( lanes, &M.sqrt_repulsion[j] ) ) );
+
+		// adhesive
+		__mmask8 adhesive = _mm512_mask_cmp_pd_mask( lanes, distance, S, _CMP_LT_OQ );
+		__m512d temp_a = _mm512_maskz_sub_pd( adhesive, one, _mm512_div_pd( distance, S ) ); // 1-d/S
+		temp_a = _mm512_mul_pd( temp_a, temp_a ); // (1-d/S)^2
+		temp_a = _mm512_mul_pd( temp_a, _mm512_mul_pd( sqrt_adh_i, _mm512_maskz_loadu_pd( lanes, &M.sqrt_adhesion[j] ) ) );
+		temp_r = _mm512_sub_pd( temp_r, temp_a );
+
+		__m512d abs_temp_r = _mm512_castsi512_pd( _mm512_and_si512( _mm512_castpd_si512( temp_r ), _mm512_set1_epi64( 0x7FFFFFFFFFFFFFFFLL ) ) );
+		lanes = _mm512_mask_cmp_pd_mask( lanes, abs_temp_r, tolerance, _CMP_GE_OQ );
+		if( lanes == 0 )
+		{ continue; }
+		temp_r = _mm512_maskz_div_pd( lanes, temp_r, distance );
+
+		// equal and opposite
+		__m512d fx = _mm512_mul_pd( dx, temp_r );
+		__m512d fy = _mm512_mul_pd( dy, temp_r );
+		__m512d fz = _mm512_mul_pd( dz, temp_r );
+		vxi = _mm512_add_pd( vxi, fx );
+		vyi = _mm512_add_pd( vyi, fy );
+		vzi = _mm512_add_pd( vzi, fz );
+		_mm512_mask_storeu_pd( &M.velocity_x[j], lanes, _mm512_sub_pd( _mm512_maskz_loadu_pd( lanes, &M.velocity_x[j] ), fx ) );
+		_mm512_mask_storeu_pd( &M.velocity_y[j], lanes, _mm512_sub_pd( _mm512_maskz_loadu_pd( lanes, &M.velocity_y[j] ), fy ) );
+		_mm512_mask_storeu_pd( &M.velocity_z[j], lanes, _mm512_sub_pd( _mm512_maskz_loadu_pd( lanes, &M.velocity_z[j] ), fz ) );
+	}
+
+	M.velocity_x[i] += _mm512_reduce_add_pd( vxi );
+	M.velocity_y[i] += _mm512_reduce_add_pd( vyi );
+	M.velocity_z[i] += _mm512_reduce_add_pd( vzi );
+	M.simple_pressure[i] += _mm512_reduce_add_pd( pi );
+	return;
+}
+#endif
+
+#if defined(__AVX2__) && !defined(__AVX512F__)
+inline double horizontal_sum( __m256d v )
+{
+	__m128d sum = _mm_add_pd( _mm256_castpd256_pd128( v ), _mm256_extractf128_pd( v, 1 ) );
+	return _mm_cvtsd_f64( _mm_add_sd( sum, _mm_unpackhi_pd( sum, sum ) ) );
+}
+
+inline void add_mechanics_block_potentials( Cell_Mechanics_Data& M, int i, int first, int last )
+{
+	static double simple_pressure_scale = 0.027288820670331; // 12 * (1 - sqrt(pi/(2*sqrt(3))))^2
+
+	__m256d xi = _mm256_set1_pd( M.x[i] );
+	__m256d yi = _mm256_set1_pd( M.y[i] );
+	__m256d zi = _mm256_set1_pd( M.z[i] );
+	__m256d ri = _mm256_set1_pd( M.radius[i] );
+	__m256d si = _mm256_set1_pd( M.max_adhesion_distance[i] );
+	__m256d sqrt_rep_i = _mm256_set1_pd( M.sqrt_repulsion[i] );
+	__m256d sqrt_adh_i = _mm256_set1_pd( M.sqrt_adhesion[i] );
+
+	__m256d zero = _mm256_setzero_pd();
+	__m256d one = _mm256_set1_pd( 1.0 );
+	__m256d min_distance = _mm256_set1_pd( 0.00001 );
+	__m256d tolerance = _mm256_set1_pd( 1e-16 );
+	__m256d sign_bit = _mm256_set1_pd( -0.0 );
+	__m256d pressure_factor = _mm256_set1_pd( 1.0 / simple_pressure_scale );
+
+	__m256d vxi = zero;
+	__m256d vyi = zero;
+	__m256d vzi = zero;
+	__m256d pi = zero;
+
+	int j = first;
+	for( ; j+4 <= last; j += 4 )
+	{
+		__m256d dx = _mm256_sub_pd( xi , _mm256_loadu_pd( &M.x[j] ) );
+		__m256d dy = _mm256_sub_pd( yi , _mm256_loadu_pd( &M.y[j] ) );
+		__m256d dz = _mm256_sub_pd( zi , _mm256_loadu_pd( &M.z[j] ) );
+		__m256d distance = _mm256_mul_pd( dx, dx );
+		distance = _mm256_add_pd( distance, _mm256_mul_pd( dy, dy ) );
+		distance = _mm256_add_pd( distance, _mm256_mul_pd( dz, dz ) );
+
+		__m256d R = _mm256_add_pd( ri , _mm256_loadu_pd( &M.radius[j] ) );
+		__m256d S = _mm256_add_pd( si , _mm256_loadu_pd( &M.max_adhesion_distance[j] ) );
+		__m256d cutoff = _mm256_max_pd( R, S );
+		if( _mm256_movemask_pd( _mm256_cmp_pd( distance, _mm256_mul_pd( cutoff, cutoff ), _CMP_LE_OQ ) ) == 0 )
+		{ continue; }
+		distance = _mm256_max_pd( _mm256_sqrt_pd( distance ), min_distance );
+
+		// repulsive (masked lanes are 0, as in the scalar branch)
+		__m256d temp_r = _mm256_sub_pd( one, _mm256_div_pd( distance, R ) ); // 1-d/R
+		temp_r = _mm256_mul_pd( temp_r, temp_r ); // (1-d/R)^2
+		temp_r = _mm256_and_pd( temp_r, _mm256_cmp_pd( distance, R, _CMP_LE_OQ ) );
+
+		__m256d pressure = _mm256_mul_pd( temp_r, pressure_factor );
+		pi = _mm256_add_pd( pi, pressure );
+		_mm256_storeu_pd( &M.simple_pressure[j], _mm256_add_pd( _mm256_loadu_pd( &M.simple_pressure[j] ), pressure ) );
+
+		temp_r = _mm256_mul_pd( temp_r, _mm256_mul_pd( sqrt_rep_i, _mm256_loadu_pd( &M.sqrt_repulsion[j] ) ) );
+
+		// adhesive
+		__m256d temp_a = _mm256_sub_pd( one, _mm256_div_pd( distance, S ) ); // 1-d/S
+		temp_a = _mm256_mul_pd( temp_a, temp_a ); // (1-d/S)^2
+		temp_a = _mm256_mul_pd( temp_a, _mm256_mul_pd( sqrt_adh_i, _mm256_loadu_pd( &M.sqrt_adhesion[j] ) ) );
+		temp_a = _mm256_and_pd( temp_a, _mm256_cmp_pd( distance, S, _CMP_LT_OQ ) );
+		temp_r = _mm256_sub_pd( temp_r, temp_a );
+
+		__m256d keep = _mm256_cmp_pd( _mm256_andnot_pd( sign_bit, temp_r ), tolerance, _CMP_GE_OQ );
+		if( _mm256_movemask_pd( keep ) == 0 )
+		{ continue; }
+		temp_r = _mm256_and_pd( _mm256_div_pd( temp_r, distance ), keep );
+
+		// equal and opposite
+		__m256d fx = _mm256_mul_pd( dx, temp_r );
+		__m256d fy = _mm256_mul_pd( dy, temp_r );
+		__m256d fz = _mm256_mul_pd( dz, temp_r );
+		vxi = _mm256_add_pd( vxi, fx );
+		vyi = _mm256_add_pd( vyi, fy );
+		vzi = _mm256_add_pd( vzi, fz );
+		_mm256_storeu_pd( &M.velocity_x[j], _mm256_sub_pd( _mm256_loadu_pd( &M.velocity_x[j] ), fx ) );
+		_mm256_storeu_pd( &M.velocity_y[j], _mm256_sub_pd( _mm256_loadu_pd( &M.velocity_y[j] ), fy ) );
+		_mm256_storeu_pd( &M.velocity_z[j], _mm256_sub_pd( _mm256_loadu_pd( &M.velocity_z[j] ), fz ) );
+	}
+
+	M.velocity_x[i] += horizontal_sum( vxi );
+	M.velocity_y[i] += horizontal_sum( vyi );
+	M.velocity_z[i] += horizontal_sum( vzi );
+	M.simple_pressure[i] += horizontal_sum( pi );
+
+	// remainder
+	for( ; j < last; j++ )
+	{ add_mechanics_pair_potential( M, i, j ); }
+	return;
+}
+#endif
+
+void Cell_Container::compute_mechanics_potentials( void )
+{
+	// A voxel handles the pairs inside it, and the pairs with each Moore
+	// neighbor of higher index (a half shell), so each pair is visited
+	// once. That writes to the voxel and its neighbors, so voxels are
+	// processed one color at a time; the summation order is then fixed,
+	// and the results don't depend on the number of threads.
+	for( int c=0; c < mechanics_voxel_colors.size(); c++ )
+	{
+		std::vector<int>& voxels = mechanics_voxel_colors[c];
+
+		#pragma omp parallel for
+		for( int n=0; n < voxels.size(); n++ )
+		{
+			int voxel = voxels[n];
+			int start = voxel_cell_start[voxel];
+			int end = voxel_cell_start[voxel+1];
+			if( start == end )
+			{ continue; }
+
+			for( int i=start; i < end; i++ )
+			{ add_mechanics_block_potentials( mechanics_data, i, i+1, end ); }
+
+			std::vector<int>& neighbor_voxels = underlying_mesh.moore_connected_voxel_indices[voxel];
+			for( int k=0; k < neighbor_voxels.size(); k++ )
+			{
+				int other_voxel = neighbor_voxels[k];
+				if( other_voxel < voxel )
+				{ continue; }
+
+				for( int i=start; i < end; i++ )
+				{ add_mechanics_block_potentials( mechanics_data, i, voxel_cell_start[other_voxel], voxel_cell_start[other_voxel+1] ); }
+			}
+		}
+	}
+	return;
+}
+
+void Cell_Container::add_potentials_from_mechanics_data( Cell* pCell )
+{
+	int i = voxel_order_index[ pCell->index ];
+
+	pCell->state.simple_pressure = mechanics_data.simple_pressure[i];
+	pCell->velocity[0] += mechanics_data.velocity_x[i];
+	pCell->velocity[1] += mechanics_data.velocity_y[i];
+	pCell->velocity[2] += mechanics_data.velocity_z[i];
+	return;
+}
+
+void cell_source_sink_function( BioFVM::Basic_Agent* pAgent, BioFVM::Microenvironment* pMicroenvironment, double dt )
+{
+	Cell* pCell = static_cast<Cell*>( pAgent ); 
+	pCell->phenotype.secretion.advance( pCell, pCell->phenotype , dt );
+	return; 
+}
+
+void cell_source_sink_rates_function( BioFVM::Basic_Agent* pAgent, BioFVM::Microenvironment* pMicroenvironment, double dt , double* sources , double* uptakes )
+{
+	Cell* pCell = static_cast<Cell*>( pAgent ); 
+	if( pCell->phenotype.secretion.sync_to_cell( pCell, pCell->phenotype , dt ) )
+	{ pCell->add_source_sink_rates( sources , uptakes ); }
+	return; 
+}
 
 Cell_Container* create_cell_container_for_microenvironment( BioFVM::Microenvironment& m , double mechanics_voxel_size )
 {
@@ -437,6 +1183,8 @@ Cell_Container* create_cell_container_for_microenvironment( BioFVM::Microenviron
 		m.mesh.bounding_box[1], m.mesh.bounding_box[4], 
 		m.mesh.bounding_box[2], m.mesh.bounding_box[5],  mechanics_voxel_size );
 	m.agent_container = (Agent_Container*) cell_container; 
+	m.agent_source_sink_function = cell_source_sink_function; 
+	m.agent_source_sink_rates_function = cell_source_sink_rates_function; 
 	
 	if( BioFVM::get_default_microenvironment() == NULL )
 	{ 
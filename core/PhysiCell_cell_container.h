@@ -78,11 +78,43 @@ namespace PhysiCell{
 
 class Cell; 
 
+// Contiguous (structure-of-arrays) copy of the cell data read by the
+// mechanics kernel, stored in mechanics voxel order (see
+// Cell_Container::cells_in_voxel_order). Cell_Container syncs it at
+// the start of each mechanics step, so that the velocity update
+// streams through these arrays instead of chasing Cell pointers.
+class Cell_Mechanics_Data
+{
+ public:
+	std::vector<double> x;
+	std::vector<double> y;
+	std::vector<double> z;
+	std::vector<double> radius;
+	std::vector<double> sqrt_repulsion; // sqrt( cell_cell_repulsion_strength )
+	std::vector<double> sqrt_adhesion; // sqrt( cell_cell_adhesion_strength )
+	std::vector<double> max_adhesion_distance; // relative_maximum_adhesion_distance * radius
+
+	// outputs of the pair kernel: velocity and simple pressure from cell-cell potentials
+	std::vector<double> velocity_x;
+	std::vector<double> velocity_y;
+	std::vector<double> velocity_z;
+	std::vector<double> simple_pressure;
+
+	void resize( int n );
+	int size( void );
+};
+
 class Cell_Container : public BioFVM::Agent_Container
 {
  private:	
 	std::vector<Cell*> cells_ready_to_divide; // the index of agents ready to divide
 	std::vector<Cell*> cells_ready_to_die;
+	// flags are pushed to the calling thread's buffer, then merged
+	std::vector< std::vector<Cell*> > cells_ready_to_divide_by_thread;
+	std::vector< std::vector<Cell*> > cells_ready_to_die_by_thread;
+	// scratch space for remove_flagged_cells(), kept between steps
+	std::vector<char> cells_being_removed; // by Cell::index
+	std::vector<Cell*> compacted_cells;
 	int boundary_condition_for_pushed_out_agents; 	// what to do with pushed out cells
 	bool initialzed = false;
 	
@@ -95,11 +127,25 @@ class Cell_Container : public BioFVM::Agent_Container
 	double last_diffusion_time  = 0.0; 
 	double last_cell_cycle_time = 0.0;
 	double last_mechanics_time  = 0.0;
+	bool is_initialized( void ); // for checkpoints, with the times above 
+	void set_initialized( bool value ); 
 	Cell_Container();
  	void initialize(double x_start, double x_end, double y_start, double y_end, double z_start, double z_end , double voxel_size);
 	void initialize(double x_start, double x_end, double y_start, double y_end, double z_start, double z_end , double dx, double dy, double dz);
-	std::vector<std::vector<Cell*> > agent_grid;
+	std::vector<std::vector<Cell*> > agent_grid; // rebuilt from the cell list below each mechanics step
 	std::vector<std::vector<Cell*> > agents_in_outer_voxels;
+
+	// cell list: cells sorted by mechanics voxel, rebuilt in parallel
+	// (counting sort) each mechanics step. Cells in voxel n are
+	// cells_in_voxel_order[ voxel_cell_start[n] ] through
+	// cells_in_voxel_order[ voxel_cell_start[n+1]-1 ], in all_cells order.
+	std::vector<int> voxel_cell_start;
+	std::vector<Cell*> cells_in_voxel_order;
+	std::vector<int> voxel_order_index; // position in cells_in_voxel_order, by Cell::index (-1 if absent)
+	std::vector<int> voxel_next_slot; // scratch for sort_cells_by_voxel(): next free position in each voxel
+	bool cell_list_out_of_date = true;
+	void sort_cells_by_voxel( void );
+	void update_all_mechanics_voxels( void );
 	
 	void update_all_cells(double t);
 	void update_all_cells(double t, double dt);
@@ -115,12 +161,37 @@ class Cell_Container : public BioFVM::Agent_Container
 	void flag_cell_for_division( Cell* pCell ); 
 	void flag_cell_for_removal( Cell* pCell ); 
 	bool contain_any_cell(int voxel_index);
+
+	// batched division and removal of the flagged cells
+	void size_flag_buffers( void );
+	void merge_flag_buffers( void );
+	void divide_flagged_cells( void );
+	void remove_flagged_cells( void );
+	// while true, register / remove calls leave the agent_grid alone
+	// (it is rebuilt from the cell list afterwards)
+	bool agent_grid_updates_deferred = false;
+
+	// mechanics mirror (valid only during the velocity update)
+	Cell_Mechanics_Data mechanics_data;
+	bool mechanics_data_synced = false;
+	void sync_mechanics_data( void );
+	int mechanics_data_index( Cell* pCell ); // -1 if pCell is not in the mirror
+
+	// mechanics voxels grouped by ( i%3, j%3, k%3 ): voxels in the same group
+	// have disjoint Moore neighborhoods, so each group can run in parallel
+	std::vector< std::vector<int> > mechanics_voxel_colors;
+	void compute_mechanics_potentials( void ); // visits each cell pair once
+	void add_potentials_from_mechanics_data( Cell* pCell ); // adds the precomputed results to pCell
 };
 
 int find_escaping_face_index(Cell* agent);
 extern std::vector<Cell*> *all_cells; 
 
 Cell_Container* create_cell_container_for_microenvironment( BioFVM::Microenvironment& m , double mechanics_voxel_size );
+// secretion and uptake of one cell, for the fused diffusion-decay-source/sink solvers 
+void cell_source_sink_function( BioFVM::Basic_Agent* pAgent, BioFVM::Microenvironment* pMicroenvironment, double dt );
+// and its secretion and uptake rates, for the quasi-steady solver 
+void cell_source_sink_rates_function( BioFVM::Basic_Agent* pAgent, BioFVM::Microenvironment* pMicroenvironment, double dt , double* sources , double* uptakes );
 
 
 
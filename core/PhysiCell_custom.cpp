@@ -129,6 +129,16 @@ Custom_Cell_Data::Custom_Cell_Data( const Custom_Cell_Data& ccd )
 	return; 
 }
 
+Custom_Cell_Data& Custom_Cell_Data::operator=( const Custom_Cell_Data& ccd )
+{
+	variables = ccd.variables; 
+	vector_variables = ccd.vector_variables; 
+	
+	name_to_index_map = ccd.name_to_index_map; 
+	
+	return *this; 
+}
+
 int Custom_Cell_Data::add_variable( Variable& v )
 {
 	int n = variables.size(); 
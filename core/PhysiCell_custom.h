@@ -131,6 +131,7 @@ class Custom_Cell_Data
 	
 	Custom_Cell_Data(); // done 
 	Custom_Cell_Data( const Custom_Cell_Data& ccd ); 
+	Custom_Cell_Data& operator=( const Custom_Cell_Data& ccd ); 
 };
 
 }; 
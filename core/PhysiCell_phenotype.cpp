@@ -824,10 +824,22 @@ void Secretion::sync_to_microenvironment( Microenvironment* pNew_Microenvironmen
 }
 
 void Secretion::advance( Basic_Agent* pCell, Phenotype& phenotype , double dt )
+{
+	if( sync_to_cell( pCell, phenotype, dt ) == false )
+	{ return; }
+
+	// now, call the BioFVM secretion/uptake function 
+	
+	pCell->simulate_secretion_and_uptake( pMicroenvironment , dt ); 
+	
+	return; 
+}
+
+bool Secretion::sync_to_cell( Basic_Agent* pCell, Phenotype& phenotype , double dt )
 {
 	// if this phenotype is not associated with a cell, exit 
 	if( pCell == NULL )
-	{ return; }
+	{ return false; }
 
 	// if there is no microenvironment, attempt to sync. 
 	if( pMicroenvironment == NULL )
@@ -846,16 +858,17 @@ void Secretion::advance( Basic_Agent* pCell, Phenotype& phenotype , double dt )
 		// if we've still failed, return. 
 		if( pMicroenvironment == NULL ) 
 		{
-			return; 
+			return false; 
 		}
 	}
 
 	// make sure the associated cell has the correct rate vectors 
 	if( pCell->secretion_rates != &secretion_rates )
 	{
-		delete pCell->secretion_rates; 
-		delete pCell->uptake_rates; 
-		delete pCell->saturation_densities; 
+		// free the storage of the agent's own vectors 
+		std::vector<double>().swap( *(pCell->secretion_rates) ); 
+		std::vector<double>().swap( *(pCell->uptake_rates) ); 
+		std::vector<double>().swap( *(pCell->saturation_densities) ); 
 		
 		pCell->secretion_rates = &secretion_rates; 
 		pCell->uptake_rates = &uptake_rates; 
@@ -865,11 +878,7 @@ void Secretion::advance( Basic_Agent* pCell, Phenotype& phenotype , double dt )
 		pCell->set_internal_uptake_constants( dt );
 	}
 
-	// now, call the BioFVM secretion/uptake function 
-	
-	pCell->simulate_secretion_and_uptake( pMicroenvironment , dt ); 
-	
-	return; 
+	return true; 
 }
 
 void Secretion::set_all_secretion_to_zero( void )
@@ -938,13 +947,18 @@ void Molecular::sync_to_microenvironment( Microenvironment* pNew_Microenvironmen
 
 void Molecular::sync_to_cell( Basic_Agent* pCell )
 {
-	delete pCell->internalized_substrates;
+	// already synced (e.g., a reused cell) 
+	if( pCell->internalized_substrates == &internalized_total_substrates )
+	{ return; }
+
+	// free the storage of the agent's own vectors 
+	std::vector<double>().swap( *(pCell->internalized_substrates) );
 	pCell->internalized_substrates = &internalized_total_substrates;
 	
-	delete pCell->fraction_released_at_death;
+	std::vector<double>().swap( *(pCell->fraction_released_at_death) );
 	pCell->fraction_released_at_death = &fraction_released_at_death; 
 	
-	delete pCell->fraction_transferred_when_ingested; 
+	std::vector<double>().swap( *(pCell->fraction_transferred_when_ingested) ); 
 	pCell->fraction_transferred_when_ingested = &fraction_transferred_when_ingested; 
 
 	return; 
@@ -984,8 +998,8 @@ void Molecular::advance( Basic_Agent* pCell, Phenotype& phenotype , double dt )
 	{
 		// copy the data over 
 		internalized_substrates = *(pCell->internalized_substrates);
-		// remove the BioFVM copy 
-		delete pCell->internalized_substrates; 
+		// free the BioFVM copy's storage 
+		std::vector<double>().swap( *(pCell->internalized_substrates) ); 
 		// point BioFVM to this one  
 		pCell->internalized_substrates = &internalized_substrates; 
 	}
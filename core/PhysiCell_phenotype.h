@@ -385,7 +385,7 @@ class Motility
 	double migration_speed; // migration speed along chosen direction, 
 		// in absence of all other adhesive / repulsive forces 
 	
-	std::vector<double> migration_bias_direction; // a unit vector
+	Vec3 migration_bias_direction; // a unit vector
 		// random motility is biased in this direction (e.g., chemotaxis)
 	double migration_bias; // how biased is motility
 		// if 0, completely random. if 1, deterministic along the bias vector 
@@ -393,7 +393,7 @@ class Motility
 	bool restrict_to_2D; 
 		// if true, set random motility to 2D only. 
 		
-	std::vector<double> motility_vector; 
+	Vec3 motility_vector; 
 		
 	Motility(); // done 
 };
@@ -417,6 +417,8 @@ class Secretion
 	void sync_to_current_microenvironment( void ); // done 
 	
 	void advance( Basic_Agent* pCell, Phenotype& phenotype , double dt ); 
+	// point the cell's BioFVM rate vectors to these (false if there is no microenvironment) 
+	bool sync_to_cell( Basic_Agent* pCell, Phenotype& phenotype , double dt ); 
 	
 	// use this to properly size the secretion parameters to the microenvironment 
 	void sync_to_microenvironment( Microenvironment* pNew_Microenvironment ); // done 
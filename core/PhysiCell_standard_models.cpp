@@ -574,6 +574,17 @@ void standard_update_cell_velocity( Cell* pCell, Phenotype& phenotype, double dt
 	
 	pCell->state.simple_pressure = 0.0; 
 	
+	// fast path: read neighbors from the container's contiguous mechanics arrays
+	Cell_Container* pContainer = pCell->get_container();
+	if( pContainer->mechanics_data_index( pCell ) >= 0 )
+	{
+		pContainer->add_potentials_from_mechanics_data( pCell );
+
+		pCell->update_motility_vector(dt);
+		pCell->velocity += phenotype.motility.motility_vector;
+		return;
+	}
+
 	//First check the neighbors in my current voxel
 	std::vector<Cell*>::iterator neighbor;
 	std::vector<Cell*>::iterator end = pCell->get_container()->agent_grid[pCell->get_current_mechanics_voxel_index()].end();
@@ -72,35 +72,152 @@
 
 #include <iostream>
 #include <fstream>
+#include <omp.h>
 
 namespace PhysiCell{
 
 std::random_device rd;
-std::mt19937 gen(rd());
+unsigned long long random_seed = rd(); 
+
+Random_Stream::Random_Stream()
+{
+	stream_id = 0; 
+	stream_type = 0; 
+	counter = 0; 
+	return; 
+}
+
+Random_Stream::Random_Stream( unsigned int id , unsigned int type )
+{
+	stream_id = id; 
+	stream_type = type; 
+	counter = 0; 
+	return; 
+}
+
+void Random_Stream::next_block( unsigned int* out )
+{
+	// Philox4x32-10 (Salmon et al., SC '11), keyed by the seed. 
+	// The counter is ( draw number , stream id , stream type ). 
+	static const unsigned long long M0 = 0xD2511F53; 
+	static const unsigned long long M1 = 0xCD9E8D57; 
+	static const unsigned int W0 = 0x9E3779B9; 
+	static const unsigned int W1 = 0xBB67AE85; 
+
+	unsigned int k0 = (unsigned int) random_seed; 
+	unsigned int k1 = (unsigned int) ( random_seed >> 32 ); 
+	unsigned int c0 = (unsigned int) counter; 
+	unsigned int c1 = (unsigned int) ( counter >> 32 ); 
+	unsigned int c2 = stream_id; 
+	unsigned int c3 = stream_type; 
+	counter++; 
+
+	for( int round=0; round < 10; round++ )
+	{
+		unsigned long long product0 = M0 * c0; 
+		unsigned long long product1 = M1 * c2; 
+		unsigned int hi0 = (unsigned int) ( product0 >> 32 ); 
+		unsigned int lo0 = (unsigned int) product0; 
+		unsigned int hi1 = (unsigned int) ( product1 >> 32 ); 
+		unsigned int lo1 = (unsigned int) product1; 
+
+		c0 = hi1 ^ c1 ^ k0; 
+		c1 = lo1; 
+		c2 = hi0 ^ c3 ^ k1; 
+		c3 = lo0; 
+
+		k0 += W0; 
+		k1 += W1; 
+	}
+
+	out[0] = c0; 
+	out[1] = c1; 
+	out[2] = c2; 
+	out[3] = c3; 
+	return; 
+}
+
+double Random_Stream::uniform( void )
+{
+	unsigned int block[4]; 
+	next_block( block ); 
+	// 53 random bits 
+	unsigned long long bits = ( ( (unsigned long long) block[0] << 32 ) | block[1] ) >> 11; 
+	return bits * 1.1102230246251565e-16; // 2^-53 
+}
+
+double Random_Stream::normal( double mean, double standard_deviation )
+{
+	// Box-Muller, using both halves of one block 
+	static double two_pi = 6.283185307179586; 
+	unsigned int block[4]; 
+	next_block( block ); 
+	unsigned long long bits1 = ( ( (unsigned long long) block[0] << 32 ) | block[1] ) >> 11; 
+	unsigned long long bits2 = ( ( (unsigned long long) block[2] << 32 ) | block[3] ) >> 11; 
+	double u1 = ( bits1 + 1.0 ) * 1.1102230246251565e-16; // (0,1] 
+	double u2 = bits2 * 1.1102230246251565e-16; 
+	return mean + standard_deviation * sqrt( -2.0 * log( u1 ) ) * cos( two_pi * u2 ); 
+}
+
+// the default streams are per thread, so draws outside of any cell 
+// never race. Thread 0 (serial code) is reproducible for a given seed. 
+thread_local Random_Stream* current_random_stream = NULL; 
+thread_local Random_Stream default_random_stream( omp_get_thread_num() , 1 ); 
+
+// SeedRandom() starts a new epoch; each thread restarts its default stream 
+// the next time it uses it in a later epoch 
+static unsigned long long random_seed_epoch = 0; 
+static thread_local unsigned long long default_random_stream_epoch = 0; 
+
+static Random_Stream& current_default_random_stream( void )
+{
+	if( default_random_stream_epoch != random_seed_epoch )
+	{
+		default_random_stream.counter = 0; 
+		default_random_stream_epoch = random_seed_epoch; 
+	}
+	return default_random_stream; 
+}
+
+void set_random_stream( Random_Stream* pStream )
+{
+	current_random_stream = pStream; 
+	return; 
+}
 
 long SeedRandom( long input )
 {
-	gen.seed(input);
+	random_seed = input; 
+	random_seed_epoch++; 
 	return input;
 }
 
-
 long SeedRandom( void )
 { 
 	unsigned seed = std::chrono::system_clock::now().time_since_epoch().count();
-	gen.seed(seed);
+	random_seed = seed; 
+	random_seed_epoch++; 
 	return seed;
 }
 
+unsigned long long get_random_seed( void )
+{ return random_seed; }
+
+Random_Stream& get_default_random_stream( void )
+{ return current_default_random_stream(); }
+
 double UniformRandom()
 {
-	return std::generate_canonical<double, 10>(gen);
+	if( current_random_stream )
+	{ return current_random_stream->uniform(); }
+	return current_default_random_stream().uniform(); 
 }
 
 double NormalRandom( double mean, double standard_deviation )
 {
-	std::normal_distribution<> d(mean,standard_deviation);
-	return d(gen); 
+	if( current_random_stream )
+	{ return current_random_stream->normal( mean, standard_deviation ); }
+	return current_default_random_stream().normal( mean, standard_deviation ); 
 }
 
 // Squared distance between two points
@@ -201,4 +318,209 @@ int choose_event( std::vector<double>& probabilities )
 	return probabilities.size(); 
 }
 
+Phase_Profiler PhysiCell_profiler; 
+
+Phase_Profiler::Phase_Profiler()
+{
+	enabled = false; 
+	number_of_threads = 1; 
+	steps = 0; 
+	return; 
+}
+
+void Phase_Profiler::resize( void )
+{
+	if( omp_get_max_threads() > number_of_threads )
+	{ number_of_threads = omp_get_max_threads(); }
+
+	wall_start.resize( section_names.size() , 0.0 ); 
+	wall_time.resize( section_names.size() , 0.0 ); 
+	thread_start_time.resize( section_names.size() ); 
+	thread_time.resize( section_names.size() ); 
+	for( int n=0; n < section_names.size(); n++ )
+	{
+		thread_start_time[n].resize( number_of_threads , 0.0 ); 
+		thread_time[n].resize( number_of_threads , 0.0 ); 
+	}
+	return; 
+}
+
+int Phase_Profiler::section_index( std::string name , bool thread_times )
+{
+	for( int n=0; n < section_names.size(); n++ )
+	{
+		if( section_names[n] == name )
+		{ return n; }
+	}
+	section_names.push_back( name ); 
+	section_has_thread_times.push_back( thread_times ); 
+	resize(); 
+	return section_names.size()-1; 
+}
+
+int Phase_Profiler::section_index( std::string name )
+{ return section_index( name , false ); }
+
+void Phase_Profiler::start( int section )
+{
+	if( !enabled )
+	{ return; }
+	// the thread count may have changed 
+	if( omp_get_max_threads() > number_of_threads )
+	{ resize(); }
+	wall_start[section] = omp_get_wtime(); 
+	return; 
+}
+
+void Phase_Profiler::stop( int section )
+{
+	if( !enabled )
+	{ return; }
+	wall_time[section] += omp_get_wtime() - wall_start[section]; 
+	return; 
+}
+
+void Phase_Profiler::thread_start( int section )
+{
+	if( !enabled )
+	{ return; }
+	thread_start_time[section][omp_get_thread_num()] = omp_get_wtime(); 
+	return; 
+}
+
+void Phase_Profiler::thread_stop( int section )
+{
+	if( !enabled )
+	{ return; }
+	int thread = omp_get_thread_num(); 
+	thread_time[section][thread] += omp_get_wtime() - thread_start_time[section][thread]; 
+	return; 
+}
+
+void Phase_Profiler::end_step( void )
+{
+	if( !enabled )
+	{ return; }
+	steps++; 
+	return; 
+}
+
+void Phase_Profiler::record( double current_time )
+{
+	if( !enabled )
+	{ return; }
+	timeline_time.push_back( current_time ); 
+	timeline_steps.push_back( steps ); 
+	timeline_wall_time.push_back( wall_time ); 
+	timeline_thread_time.push_back( thread_time ); 
+
+	steps = 0; 
+	std::fill( wall_time.begin() , wall_time.end() , 0.0 ); 
+	for( int n=0; n < thread_time.size(); n++ )
+	{ std::fill( thread_time[n].begin() , thread_time[n].end() , 0.0 ); }
+	return; 
+}
+
+void Phase_Profiler::write( std::string filename_base )
+{
+	if( !enabled )
+	{ return; }
+	write_CSV( filename_base + ".csv" ); 
+	write_JSON( filename_base + ".json" ); 
+	return; 
+}
+
+// sections added after an entry was recorded are 0 in that entry 
+static double profiler_entry( std::vector<double>& values , int n )
+{
+	if( n < values.size() )
+	{ return values[n]; }
+	return 0.0; 
+}
+
+void Phase_Profiler::write_CSV( std::string filename )
+{
+	std::ofstream os( filename.c_str() , std::ios::out ); 
+	if( !os )
+	{
+		std::cout << "Warning: could not open " << filename << " to write the profile." << std::endl; 
+		return; 
+	}
+
+	os << "time,steps"; 
+	for( int n=0; n < section_names.size(); n++ )
+	{ os << "," << section_names[n]; }
+	for( int n=0; n < section_names.size(); n++ )
+	{
+		if( section_has_thread_times[n] )
+		{
+			for( int k=0; k < number_of_threads; k++ )
+			{ os << "," << section_names[n] << "_thread" << k; }
+		}
+	}
+	os << std::endl; 
+
+	std::vector<double> empty; 
+	for( int i=0; i < timeline_time.size(); i++ )
+	{
+		os << timeline_time[i] << "," << timeline_steps[i]; 
+		for( int n=0; n < section_names.size(); n++ )
+		{ os << "," << profiler_entry( timeline_wall_time[i] , n ); }
+		for( int n=0; n < section_names.size(); n++ )
+		{
+			if( section_has_thread_times[n] == false )
+			{ continue; }
+			std::vector<double>& threads = ( n < timeline_thread_time[i].size() ) ? timeline_thread_time[i][n] : empty; 
+			for( int k=0; k < number_of_threads; k++ )
+			{ os << "," << profiler_entry( threads , k ); }
+		}
+		os << std::endl; 
+	}
+	os.close(); 
+	return; 
+}
+
+void Phase_Profiler::write_JSON( std::string filename )
+{
+	std::ofstream os( filename.c_str() , std::ios::out ); 
+	if( !os )
+	{
+		std::cout << "Warning: could not open " << filename << " to write the profile." << std::endl; 
+		return; 
+	}
+
+	os << "{" << std::endl 
+		<< "\t\"units\": \"s\"," << std::endl 
+		<< "\t\"threads\": " << number_of_threads << "," << std::endl 
+		<< "\t\"sections\": ["; 
+	for( int n=0; n < section_names.size(); n++ )
+	{ os << ( n > 0 ? ", " : "" ) << "\"" << section_names[n] << "\""; }
+	os << "]," << std::endl << "\t\"timeline\": [" << std::endl; 
+
+	std::vector<double> empty; 
+	for( int i=0; i < timeline_time.size(); i++ )
+	{
+		os << "\t\t{ \"time\": " << timeline_time[i] << ", \"steps\": " << timeline_steps[i] << ", \"wall\": {"; 
+		for( int n=0; n < section_names.size(); n++ )
+		{ os << ( n > 0 ? ", " : " " ) << "\"" << section_names[n] << "\": " << profiler_entry( timeline_wall_time[i] , n ); }
+		os << " }, \"threads\": {"; 
+		bool first = true; 
+		for( int n=0; n < section_names.size(); n++ )
+		{
+			if( section_has_thread_times[n] == false )
+			{ continue; }
+			std::vector<double>& threads = ( n < timeline_thread_time[i].size() ) ? timeline_thread_time[i][n] : empty; 
+			os << ( first ? " " : ", " ) << "\"" << section_names[n] << "\": ["; 
+			for( int k=0; k < number_of_threads; k++ )
+			{ os << ( k > 0 ? ", " : "" ) << profiler_entry( threads , k ); }
+			os << "]"; 
+			first = false; 
+		}
+		os << " } }" << ( i+1 < timeline_time.size() ? "," : "" ) << std::endl; 
+	}
+	os << "\t]" << std::endl << "}" << std::endl; 
+	os.close(); 
+	return; 
+}
+
 };
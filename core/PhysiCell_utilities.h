@@ -78,8 +78,33 @@
 
 namespace PhysiCell{
 
+// Counter-based (Philox4x32-10) random number stream. Draw n of a stream
+// is a pure function of ( seed, stream_id, n ), so each cell gets its own
+// reproducible sequence no matter which thread advances it.
+class Random_Stream
+{
+ public:
+	unsigned int stream_id;
+	unsigned int stream_type; // 0 for cells, 1 for the per-thread default streams
+	unsigned long long counter; // number of draws so far
+
+	Random_Stream();
+	Random_Stream( unsigned int id , unsigned int type );
+	void next_block( unsigned int* out ); // 4 random 32-bit words
+	double uniform( void ); // [0,1)
+	double normal( double mean, double standard_deviation );
+};
+
+// UniformRandom() and NormalRandom() draw from the calling thread's current
+// stream. Cell_Container points it at each cell's stream while that cell's
+// functions run; NULL restores the thread's default stream.
+void set_random_stream( Random_Stream* pStream );
+
 long SeedRandom( long input );
 long SeedRandom( void );
+// for checkpoints: the seed, and the calling thread's default stream 
+unsigned long long get_random_seed( void ); 
+Random_Stream& get_default_random_stream( void ); 
 double UniformRandom( void );
 double NormalRandom( double mean, double standard_deviation );
 double dist_squared(std::vector<double> p1, std::vector<double> p2);
@@ -94,6 +119,60 @@ void add_software_citation( std::string name , std::string version, std::string
 
 int choose_event( std::vector<double>& probabilities ); 
 
+// Wall time spent in each phase of the main loop (diffusion, secretion, 
+// phenotype, ... ), accumulated between calls to record(), which adds an 
+// entry to the timeline. Phases that are one parallel loop also keep each 
+// thread's busy time, so load imbalance shows up. Disabled by default; 
+// every call returns immediately unless enabled is true. 
+class Phase_Profiler
+{
+ private:
+	std::vector<double> wall_start; // by section 
+	std::vector< std::vector<double> > thread_start_time; // [section][thread]
+	void resize( void ); 
+
+ public:
+	bool enabled; 
+	int number_of_threads; 
+
+	std::vector<std::string> section_names; 
+	std::vector<bool> section_has_thread_times; 
+
+	// accumulated since the last record() 
+	int steps; 
+	std::vector<double> wall_time; // by section 
+	std::vector< std::vector<double> > thread_time; // [section][thread]
+
+	// one entry per record() 
+	std::vector<double> timeline_time; 
+	std::vector<int> timeline_steps; 
+	std::vector< std::vector<double> > timeline_wall_time; 
+	std::vector< std::vector< std::vector<double> > > timeline_thread_time; 
+
+	Phase_Profiler(); 
+
+	// finds (or adds) a section. Call from serial code, e.g. to set a static int. 
+	int section_index( std::string name , bool thread_times ); 
+	int section_index( std::string name ); 
+
+	// wall time, called from serial code around the phase 
+	void start( int section ); 
+	void stop( int section ); 
+	// this thread's time, called by each thread inside the parallel region 
+	void thread_start( int section ); 
+	void thread_stop( int section ); 
+
+	void end_step( void ); 
+	void record( double current_time ); 
+
+	// writes filename_base.csv and filename_base.json 
+	void write( std::string filename_base ); 
+	void write_CSV( std::string filename ); 
+	void write_JSON( std::string filename ); 
+};
+
+extern Phase_Profiler PhysiCell_profiler; 
+
 };
 
 #endif
@@ -118,7 +118,19 @@ int main( int argc, char* argv[] )
 	Cell_Container* cell_container = create_cell_container_for_microenvironment( microenvironment, mechanics_voxel_size );
 	
 	create_cell_types();
-	setup_tissue();
+	
+	// start a new tissue, or resume (or fork) a checkpointed simulation 
+	bool restarting = ( PhysiCell_settings.restart_from.size() > 0 ); 
+	if( restarting )
+	{
+		if( !load_PhysiCell_checkpoint( PhysiCell_settings.restart_from , microenvironment ) )
+		{ exit(-1); }
+	}
+	else
+	{
+		setup_tissue();
+		PhysiCell_globals.next_checkpoint_time = PhysiCell_settings.checkpoint_interval; 
+	}
 	
 	/* Users typically start modifying here. START USERMODS */ 
 	
@@ -134,8 +146,11 @@ int main( int argc, char* argv[] )
 	// save a simulation snapshot 
 	
 	char filename[1024];
-	sprintf( filename , "%s/initial" , PhysiCell_settings.folder.c_str() ); 
-	save_PhysiCell_to_MultiCellDS_xml_pugi( filename , microenvironment , PhysiCell_globals.current_time ); 
+	if( !restarting )
+	{
+		sprintf( filename , "%s/initial" , PhysiCell_settings.folder.c_str() ); 
+		save_PhysiCell_full_data( filename , microenvironment , PhysiCell_globals.current_time ); 
+	}
 	
 	// save a quick SVG cross section through z = 0, after setting its 
 	// length bar to 200 microns 
@@ -146,8 +161,11 @@ int main( int argc, char* argv[] )
 	
 	std::vector<std::string> (*cell_coloring_function)(Cell*) = my_coloring_function;
 	
-	sprintf( filename , "%s/initial.svg" , PhysiCell_settings.folder.c_str() ); 
-	SVG_plot( filename , microenvironment, 0.0 , PhysiCell_globals.current_time, cell_coloring_function );
+	if( !restarting )
+	{
+		sprintf( filename , "%s/initial.svg" , PhysiCell_settings.folder.c_str() ); 
+		save_PhysiCell_SVG( filename , microenvironment, 0.0 , PhysiCell_globals.current_time, cell_coloring_function );
+	}
 	
 	display_citations(); 
 	
@@ -156,6 +174,15 @@ int main( int argc, char* argv[] )
 	BioFVM::RUNTIME_TIC();
 	BioFVM::TIC();
 	
+	// per-phase timings, saved as profile.csv and profile.json at each full save 
+	
+	PhysiCell_profiler.enabled = PhysiCell_settings.enable_profiling; 
+	int diffusion_section = PhysiCell_profiler.section_index( "diffusion" ); 
+	int full_save_section = PhysiCell_profiler.section_index( "full_save" ); 
+	int SVG_section = PhysiCell_profiler.section_index( "SVG" ); 
+	char profile_filename[1024]; 
+	sprintf( profile_filename , "%s/profile" , PhysiCell_settings.folder.c_str() ); 
+	
 	std::ofstream report_file;
 	if( PhysiCell_settings.enable_legacy_saves == true )
 	{	
@@ -184,9 +211,14 @@ int main( int argc, char* argv[] )
 				{	
 					sprintf( filename , "%s/output%08u" , PhysiCell_settings.folder.c_str(),  PhysiCell_globals.full_output_index ); 
 					
-					save_PhysiCell_to_MultiCellDS_xml_pugi( filename , microenvironment , PhysiCell_globals.current_time ); 
+					PhysiCell_profiler.start( full_save_section ); 
+					save_PhysiCell_full_data( filename , microenvironment , PhysiCell_globals.current_time ); 
+					PhysiCell_profiler.stop( full_save_section ); 
 				}
 				
+				PhysiCell_profiler.record( PhysiCell_globals.current_time ); 
+				PhysiCell_profiler.write( profile_filename ); 
+				
 				PhysiCell_globals.full_output_index++; 
 				PhysiCell_globals.next_full_save_time += PhysiCell_settings.full_save_interval;
 			}
@@ -197,22 +229,41 @@ int main( int argc, char* argv[] )
 				if( PhysiCell_settings.enable_SVG_saves == true )
 				{	
 					sprintf( filename , "%s/snapshot%08u.svg" , PhysiCell_settings.folder.c_str() , PhysiCell_globals.SVG_output_index ); 
-					SVG_plot( filename , microenvironment, 0.0 , PhysiCell_globals.current_time, cell_coloring_function );
+					PhysiCell_profiler.start( SVG_section ); 
+					save_PhysiCell_SVG( filename , microenvironment, 0.0 , PhysiCell_globals.current_time, cell_coloring_function );
+					PhysiCell_profiler.stop( SVG_section ); 
 					
 					PhysiCell_globals.SVG_output_index++; 
 					PhysiCell_globals.next_SVG_save_time  += PhysiCell_settings.SVG_save_interval;
 				}
 			}
 			
+			// save a checkpoint if it's time (after the saves above, which 
+			// a resumed run does not repeat) 
+			if( PhysiCell_settings.enable_checkpoints == true && 
+				fabs( PhysiCell_globals.current_time - PhysiCell_globals.next_checkpoint_time ) < 0.01 * diffusion_dt )
+			{
+				sprintf( filename , "%s/checkpoint%08u.bin" , PhysiCell_settings.folder.c_str() , PhysiCell_globals.checkpoint_index ); 
+				PhysiCell_globals.checkpoint_index++; 
+				PhysiCell_globals.next_checkpoint_time += PhysiCell_settings.checkpoint_interval; 
+				save_PhysiCell_checkpoint( filename , microenvironment ); 
+			}
+			
 			// update the microenvironment
+			PhysiCell_profiler.start( diffusion_section ); 
 			microenvironment.simulate_diffusion_decay( diffusion_dt );
+			PhysiCell_profiler.stop( diffusion_section ); 
 			
 			// run PhysiCell 
 			((Cell_Container *)microenvironment.agent_container)->update_all_cells( PhysiCell_globals.current_time );
 			
 			PhysiCell_globals.current_time += diffusion_dt;
+			PhysiCell_profiler.end_step(); 
 		}
 		
+		PhysiCell_profiler.record( PhysiCell_globals.current_time ); 
+		PhysiCell_profiler.write( profile_filename ); 
+		
 		if( PhysiCell_settings.enable_legacy_saves == true )
 		{			
 			log_output(PhysiCell_globals.current_time, PhysiCell_globals.full_output_index, microenvironment, report_file);
@@ -227,10 +278,18 @@ int main( int argc, char* argv[] )
 	// save a final simulation snapshot 
 	
 	sprintf( filename , "%s/final" , PhysiCell_settings.folder.c_str() ); 
-	save_PhysiCell_to_MultiCellDS_xml_pugi( filename , microenvironment , PhysiCell_globals.current_time ); 
+	save_PhysiCell_full_data( filename , microenvironment , PhysiCell_globals.current_time ); 
 	
 	sprintf( filename , "%s/final.svg" , PhysiCell_settings.folder.c_str() ); 
-	SVG_plot( filename , microenvironment, 0.0 , PhysiCell_globals.current_time, cell_coloring_function );
+	save_PhysiCell_SVG( filename , microenvironment, 0.0 , PhysiCell_globals.current_time, cell_coloring_function );
+	
+	// wait for the background writer (if used) to write everything 
+	
+	if( PhysiCell_settings.enable_background_writer == true )
+	{
+		PhysiCell_background_writer.finish(); 
+		PhysiCell_background_writer.display_information( std::cout ); 
+	}
 	
 	// timer 
 	
@@ -0,0 +1,158 @@
+%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%
+% If you use PhysiCell in your project, please cite PhysiCell and the version %
+% number, such as below:                                                      %
+%                                                                             %
+% We implemented and solved the model using PhysiCell (Version x.y.z) [1].    %
+%                                                                             %
+% [1] A Ghaffarizadeh, R Heiland, SH Friedman, SM Mumenthaler, and P Macklin, %
+%     PhysiCell: an Open Source Physics-Based Cell Simulator for Multicellu-  %
+%     lar Systems, PLoS Comput. Biol. 14(2): e1005991, 2018                   %
+%     DOI: 10.1371/journal.pcbi.1005991                                       %
+%                                                                             %
+% See VERSION.txt or call get_PhysiCell_version() to get the current version  %
+%     x.y.z. Call display_citations() to get detailed information on all cite-%
+%     able software used in your PhysiCell application.                       %
+%                                                                             %
+% Because PhysiCell extensively uses BioFVM, we suggest you also cite BioFVM  %
+%     as below:                                                               %
+%                                                                             %
+% We implemented and solved the model using PhysiCell (Version x.y.z) [1],    %
+% with BioFVM [2] to solve the transport equations.                           %
+%                                                                             %
+% [1] A Ghaffarizadeh, R Heiland, SH Friedman, SM Mumenthaler, and P Macklin, %
+%     PhysiCell: an Open Source Physics-Based Cell Simulator for Multicellu-  %
+%     lar Systems, PLoS Comput. Biol. 14(2): e1005991, 2018                   %
+%     DOI: 10.1371/journal.pcbi.1005991                                       %
+%                                                                             %
+% [2] A Ghaffarizadeh, SH Friedman, and P Macklin, BioFVM: an efficient para- %
+%     llelized diffusive transport solver for 3-D biological simulations,     %
+%     Bioinformatics 32(8): 1256-8, 2016. DOI: 10.1093/bioinformatics/btv730  %
+%                                                                             %
+%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%
+%                                                                             %
+% BSD 3-Clause License (see https://opensource.org/licenses/BSD-3-Clause)     %
+%                                                                             %
+% Copyright (c) 2015-2018, Paul Macklin and the PhysiCell Project             %
+% All rights reserved.                                                        %
+%                                                                             %
+% Redistribution and use in source and binary forms, with or without          %
+% modification, are permitted provided that the following conditions are met: %
+%                                                                             %
+% 1. Redistributions of source code must retain the above copyright notice,   %
+% this list of conditions and the following disclaimer.                       %
+%                                                                             %
+% 2. Redistributions in binary form must reproduce the above copyright        %
+% notice, this list of conditions and the following disclaimer in the         %
+% documentation and/or other materials provided with the distribution.        %
+%                                                                             %
+% 3. Neither the name of the copyright holder nor the names of its            %
+% contributors may be used to endorse or promote products derived from this   %
+% software without specific prior written permission.                         %
+%                                                                             %
+% THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" %
+% AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE   %
+% IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE  %
+% ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE   %
+% LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR         %
+% CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF        %
+% SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS    %
+% INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN     %
+% CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)     %
+% ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE  %
+% POSSIBILITY OF SUCH DAMAGE.                                                 %
+%                                                                             %
+%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%
+%
+% Usage: 
+%
+% out = read_PhysiCell_snapshot( filename ) 
+%
+% The data in filename must be a columnar snapshot (*_snapshot.bin), as 
+% saved with <full_data><format>columnar</format></full_data>. 
+% Frames of a compressed stream (snapshots.pcs, saved with 
+% <format>compressed</format>) are extracted to this format by 
+% tools/decompress_snapshots. 
+%
+% Each table becomes a struct of its columns, with one row per cell (or 
+% voxel) and one column per component: 
+%
+%   out.time 
+%   out.cells.ID , out.cells.position (n x 3) , out.cells.total_volume , ... 
+%   out.microenvironment.position , out.microenvironment.oxygen , ... 
+%   out.units.cells.position , ... 
+%
+% Licensed under 3-Clause BSD
+%
+
+function out = read_PhysiCell_snapshot( filename )
+
+fid = fopen( filename , 'r' , 'l' ); 
+if( fid < 0 )
+    error( 'Could not open %s' , filename ); 
+end
+
+magic = fread( fid , [1 8] , '*char' ); 
+if( ~strcmp( magic , 'PCSNAP01' ) )
+    fclose( fid ); 
+    error( '%s is not a PhysiCell snapshot' , filename ); 
+end
+
+% the endian marker is 0x01020304 in the byte order of the writer 
+marker = fread( fid , 1 , 'uint32' ); 
+if( marker ~= 16909060 )
+    fclose( fid ); 
+    fid = fopen( filename , 'r' , 'b' ); 
+    fseek( fid , 12 , 'bof' ); 
+end
+out.version = fread( fid , 1 , 'uint32' ); 
+out.time = fread( fid , 1 , 'double' ); 
+number_of_tables = fread( fid , 1 , 'uint32' ); 
+
+% the header: tables and their columns 
+
+tables = cell(1,number_of_tables); 
+for t=1:number_of_tables
+    tables{t}.name = read_string( fid ); 
+    tables{t}.rows = fread( fid , 1 , 'uint64' ); 
+    number_of_columns = fread( fid , 1 , 'uint32' ); 
+    tables{t}.columns = cell(1,number_of_columns); 
+    for c=1:number_of_columns
+        column.name = read_string( fid ); 
+        column.units = read_string( fid ); 
+        column.type = fread( fid , 1 , 'uint32' ); 
+        column.components = fread( fid , 1 , 'uint32' ); 
+        column.offset = fread( fid , 1 , 'uint64' ); 
+        column.bytes = fread( fid , 1 , 'uint64' ); 
+        tables{t}.columns{c} = column; 
+    end
+end
+
+% the data: each column is contiguous, [components x rows] 
+
+for t=1:number_of_tables
+    table_name = matlab.lang.makeValidName( tables{t}.name ); 
+    rows = tables{t}.rows; 
+    for c=1:length( tables{t}.columns )
+        column = tables{t}.columns{c}; 
+        name = matlab.lang.makeValidName( column.name ); 
+        fseek( fid , column.offset , 'bof' ); 
+        if( column.type == 1 )
+            A = fread( fid , [column.components rows] , 'int32=>double' ); 
+        else
+            A = fread( fid , [column.components rows] , 'double' ); 
+        end
+        out.(table_name).(name) = A'; 
+        out.units.(table_name).(name) = column.units; 
+    end
+end
+
+fclose( fid ); 
+
+return; 
+
+function str = read_string( fid )
+
+n = fread( fid , 1 , 'uint32' ); 
+str = fread( fid , [1 n] , '*char' ); 
+
+return; 
\ No newline at end of file
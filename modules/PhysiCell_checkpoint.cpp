@@ -0,0 +1,882 @@
+/*
+###############################################################################
+# If you use PhysiCell in your project, please cite PhysiCell and the version #
+# number, such as below:                                                      #
+#                                                                             #
+# We implemented and solved the model using PhysiCell (Version x.y.z) [1].    #
+#                                                                             #
+# [1] A Ghaffarizadeh, R Heiland, SH Friedman, SM Mumenthaler, and P Macklin, #
+#     PhysiCell: an Open Source Physics-Based Cell Simulator for Multicellu-  #
+#     lar Systems, PLoS Comput. Biol. 14(2): e1005991, 2018                   #
+#     DOI: 10.1371/journal.pcbi.1005991                                       #
+#                                                                             #
+# See VERSION.txt or call get_PhysiCell_version() to get the current version  #
+#     x.y.z. Call display_citations() to get detailed information on all cite-#
+#     able software used in your PhysiCell application.                       #
+#                                                                             #
+# Because PhysiCell extensively uses BioFVM, we suggest you also cite BioFVM  #
+#     as below:                                                               #
+#                                                                             #
+# We implemented and solved the model using PhysiCell (Version x.y.z) [1],    #
+# with BioFVM [2] to solve the transport equations.                           #
+#                                                                             #
+# [1] A Ghaffarizadeh, R Heiland, SH Friedman, SM Mumenthaler, and P Macklin, #
+#     PhysiCell: an Open Source Physics-Based Cell Simulator for Multicellu-  #
+#     lar Systems, PLoS Comput. Biol. 14(2): e1005991, 2018                   #
+#     DOI: 10.1371/journal.pcbi.1005991                                       #
+#                                                                             #
+# [2] A Ghaffarizadeh, SH Friedman, and P Macklin, BioFVM: an efficient para- #
+#     llelized diffusive transport solver for 3-D biological simulations,     #
+#     Bioinformatics 32(8): 1256-8, 2016. DOI: 10.1093/bioinformatics/btv730  #
+#                                                                             #
+###############################################################################
+#                                                                             #
+# BSD 3-Clause License (see https://opensource.org/licenses/BSD-3-Clause)     #
+#                                                                             #
+# Copyright (c) 2015-2018, Paul Macklin and the PhysiCell Project             #
+# All rights reserved.                                                        #
+#                                                                             #
+# Redistribution and use in source and binary forms, with or without          #
+# modification, are permitted provided that the following conditions are met: #
+#                                                                             #
+# 1. Redistributions of source code must retain the above copyright notice,   #
+# this list of conditions and the following disclaimer.                       #
+#                                                                             #
+# 2. Redistributions in binary form must reproduce the above copyright        #
+# notice, this list of conditions and the following disclaimer in the         #
+# documentation and/or other materials provided with the distribution.        #
+#                                                                             #
+# 3. Neither the name of the copyright holder nor the names of its            #
+# contributors may be used to endorse or promote products derived from this   #
+# software without specific prior written permission.                         #
+#                                                                             #
+# THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" #
+# AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE   #
+# IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE  #
+# ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE   #
+# LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR         #
+# CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF        #
+# SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS    #
+# INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN     #
+# CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)     #
+# ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE  #
+# POSSIBILITY OF SUCH DAMAGE.                                                 #
+#                                                                             #
+###############################################################################
+*/
+ 
+#include "./PhysiCell_checkpoint.h"
+
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+#include "./PhysiCell_settings.h"
+#include "./PhysiCell_snapshot.h"
+
+namespace PhysiCell{
+
+static const char PhysiCell_checkpoint_magic [9] = "PCCHKP01"; 
+static const unsigned int PhysiCell_checkpoint_endian_marker = 0x01020304; 
+static const unsigned int PhysiCell_checkpoint_version = 2; 
+
+// the checkpoint in memory, written or read front to back 
+
+class Checkpoint_Buffer
+{
+ private:
+ public:
+	std::vector<char> data; 
+	size_t position; 
+	bool failed; // set by the first read past the end (or a bad value) 
+	
+	Checkpoint_Buffer()
+	{
+		position = 0; 
+		failed = false; 
+	}
+	
+	void write( const void* value , size_t bytes )
+	{
+		const char* p = (const char*) value; 
+		data.insert( data.end() , p , p + bytes ); 
+		return; 
+	}
+	void read( void* value , size_t bytes )
+	{
+		if( failed || bytes > data.size() - position )
+		{
+			failed = true; 
+			memset( value , 0 , bytes ); 
+			return; 
+		}
+		memcpy( value , data.data() + position , bytes ); 
+		position += bytes; 
+		return; 
+	}
+	
+	// plain values (double, int, bool, ...) 
+	template <class T> void put( const T& value )
+	{ write( &value , sizeof(T) ); }
+	template <class T> void get( T& value )
+	{ read( &value , sizeof(T) ); }
+	
+	void put( const std::string& value )
+	{
+		unsigned int length = value.size(); 
+		put( length ); 
+		write( value.data() , length ); 
+		return; 
+	}
+	void get( std::string& value )
+	{
+		unsigned int length = 0; 
+		get( length ); 
+		if( failed || length > data.size() - position )
+		{
+			failed = true; 
+			return; 
+		}
+		value.assign( data.data() + position , length ); 
+		position += length; 
+		return; 
+	}
+	
+	void put( const std::vector<double>& value )
+	{
+		unsigned long long size = value.size(); 
+		put( size ); 
+		write( value.data() , size * sizeof(double) ); 
+		return; 
+	}
+	void get( std::vector<double>& value )
+	{
+		unsigned long long size = 0; 
+		get( size ); 
+		if( failed || size > ( data.size() - position ) / sizeof(double) )
+		{
+			failed = true; 
+			return; 
+		}
+		value.resize( size ); 
+		read( value.data() , size * sizeof(double) ); 
+		return; 
+	}
+	
+	void put( const std::vector< std::vector<double> >& value )
+	{
+		put( (unsigned int) value.size() ); 
+		for( unsigned int i=0; i < value.size(); i++ )
+		{ put( value[i] ); }
+		return; 
+	}
+	void get( std::vector< std::vector<double> >& value )
+	{
+		unsigned int size = 0; 
+		get( size ); 
+		if( failed || size > data.size() - position )
+		{
+			failed = true; 
+			return; 
+		}
+		value.resize( size ); 
+		for( unsigned int i=0; i < value.size(); i++ )
+		{ get( value[i] ); }
+		return; 
+	}
+}; 
+
+// Functions and reference phenotypes are stored by the name of the cell 
+// definition that has them, and cycle models by their code and name, so that 
+// a checkpoint does not depend on where the build put them. Each is saved 
+// only if the same lookup finds it again. 
+
+template <class T> static void checkpoint_put_function( Checkpoint_Buffer& B , T Cell_Functions::* field , T function )
+{
+	std::string name; 
+	bool found = ( function == NULL ); 
+	std::vector<Cell_Definition*>& definitions = all_cell_definitions(); 
+	for( unsigned int i=0; !found && i < definitions.size(); i++ )
+	{
+		if( definitions[i]->functions.*field == function && find_cell_definition( definitions[i]->name ) == definitions[i] )
+		{
+			name = definitions[i]->name; 
+			found = true; 
+		}
+	}
+	if( !found )
+	{ B.failed = true; }
+	B.put( function == NULL ); 
+	B.put( name ); 
+	return; 
+}
+template <class T> static void checkpoint_get_function( Checkpoint_Buffer& B , T Cell_Functions::* field , T& function )
+{
+	bool is_null = true; 
+	std::string name; 
+	B.get( is_null ); 
+	B.get( name ); 
+	function = NULL; 
+	if( is_null || B.failed )
+	{ return; }
+	Cell_Definition* pCD = find_cell_definition( name ); 
+	if( pCD == NULL || pCD->functions.*field == NULL )
+	{
+		B.failed = true; 
+		return; 
+	}
+	function = pCD->functions.*field; 
+	return; 
+}
+
+static void checkpoint_put_reference_phenotype( Checkpoint_Buffer& B , Phenotype* pPhenotype )
+{
+	std::string name; 
+	bool found = ( pPhenotype == NULL ); 
+	std::vector<Cell_Definition*>& definitions = all_cell_definitions(); 
+	for( unsigned int i=0; !found && i < definitions.size(); i++ )
+	{
+		if( &( definitions[i]->phenotype ) == pPhenotype && find_cell_definition( definitions[i]->name ) == definitions[i] )
+		{
+			name = definitions[i]->name; 
+			found = true; 
+		}
+	}
+	if( !found )
+	{ B.failed = true; }
+	B.put( pPhenotype == NULL ); 
+	B.put( name ); 
+	return; 
+}
+static void checkpoint_get_reference_phenotype( Checkpoint_Buffer& B , Phenotype*& pPhenotype )
+{
+	bool is_null = true; 
+	std::string name; 
+	B.get( is_null ); 
+	B.get( name ); 
+	pPhenotype = NULL; 
+	if( is_null || B.failed )
+	{ return; }
+	Cell_Definition* pCD = find_cell_definition( name ); 
+	if( pCD == NULL )
+	{
+		B.failed = true; 
+		return; 
+	}
+	pPhenotype = &( pCD->phenotype ); 
+	return; 
+}
+
+// the models of the cell definitions first, then the standard models 
+static Cycle_Model* checkpoint_find_cycle_model( int code , std::string name )
+{
+	std::vector<Cycle_Model*> models; 
+	std::vector<Cell_Definition*>& definitions = all_cell_definitions(); 
+	for( unsigned int i=0; i < definitions.size(); i++ )
+	{
+		models.push_back( definitions[i]->phenotype.cycle.pCycle_Model ); 
+		models.push_back( &( definitions[i]->functions.cycle_model ) ); 
+		for( unsigned int j=0; j < definitions[i]->phenotype.death.models.size(); j++ )
+		{ models.push_back( definitions[i]->phenotype.death.models[j] ); }
+	}
+	Cycle_Model* standard_models [] = { &Ki67_advanced , &Ki67_basic , &live , &flow_cytometry_cycle_model , 
+		&flow_cytometry_separated_cycle_model , &cycling_quiescent , &apoptosis , &necrosis }; 
+	models.insert( models.end() , standard_models , standard_models + 8 ); 
+	
+	for( unsigned int i=0; i < models.size(); i++ )
+	{
+		if( models[i] != NULL && models[i]->code == code && models[i]->name == name )
+		{ return models[i]; }
+	}
+	return NULL; 
+}
+
+static void checkpoint_put_cycle_model( Checkpoint_Buffer& B , Cycle_Model* pModel )
+{
+	int code = pModel ? pModel->code : -1; 
+	std::string name = pModel ? pModel->name : std::string( "" ); 
+	if( pModel != NULL && checkpoint_find_cycle_model( code , name ) != pModel )
+	{ B.failed = true; }
+	B.put( pModel == NULL ); 
+	B.put( code ); 
+	B.put( name ); 
+	return; 
+}
+static void checkpoint_get_cycle_model( Checkpoint_Buffer& B , Cycle_Model*& pModel )
+{
+	bool is_null = true; 
+	int code = -1; 
+	std::string name; 
+	B.get( is_null ); 
+	B.get( code ); 
+	B.get( name ); 
+	pModel = NULL; 
+	if( is_null || B.failed )
+	{ return; }
+	pModel = checkpoint_find_cycle_model( code , name ); 
+	if( pModel == NULL )
+	{ B.failed = true; }
+	return; 
+}
+
+// one cell: the Basic_Agent, then the Cell, then its phenotype 
+
+static void checkpoint_put_cell( Checkpoint_Buffer& B , Cell* pCell )
+{
+	B.put( pCell->ID ); 
+	B.put( pCell->type ); 
+	B.put( pCell->position ); 
+	B.put( pCell->velocity ); 
+	B.put( pCell->Basic_Agent::get_total_volume() ); 
+	
+	Vec3 previous_velocity; 
+	bool is_active; 
+	bool volume_is_changed; 
+	std::vector<double> temp1; 
+	std::vector<double> temp2; 
+	pCell->get_checkpoint_state( previous_velocity , is_active , volume_is_changed , temp1 , temp2 ); 
+	B.put( previous_velocity ); 
+	B.put( is_active ); 
+	B.put( volume_is_changed ); 
+	B.put( temp1 ); 
+	B.put( temp2 ); 
+	
+	B.put( pCell->type_name ); 
+	B.put( pCell->is_out_of_domain ); 
+	B.put( pCell->is_movable ); 
+	B.put( pCell->displacement ); 
+	B.put( pCell->state.orientation ); 
+	B.put( pCell->state.simple_pressure ); 
+	B.put( pCell->random_stream.stream_id ); 
+	B.put( pCell->random_stream.stream_type ); 
+	B.put( pCell->random_stream.counter ); 
+	
+	Custom_Cell_Data& custom_data = pCell->custom_data; 
+	B.put( (unsigned int) custom_data.variables.size() ); 
+	for( unsigned int i=0; i < custom_data.variables.size(); i++ )
+	{
+		B.put( custom_data.variables[i].name ); 
+		B.put( custom_data.variables[i].units ); 
+		B.put( custom_data.variables[i].value ); 
+	}
+	B.put( (unsigned int) custom_data.vector_variables.size() ); 
+	for( unsigned int i=0; i < custom_data.vector_variables.size(); i++ )
+	{
+		B.put( custom_data.vector_variables[i].name ); 
+		B.put( custom_data.vector_variables[i].units ); 
+		B.put( custom_data.vector_variables[i].value ); 
+	}
+	
+	Cell_Parameters& parameters = pCell->parameters; 
+	B.put( parameters.o2_hypoxic_threshold ); 
+	B.put( parameters.o2_hypoxic_response ); 
+	B.put( parameters.o2_hypoxic_saturation ); 
+	B.put( parameters.o2_proliferation_saturation ); 
+	B.put( parameters.o2_proliferation_threshold ); 
+	B.put( parameters.o2_reference ); 
+	B.put( parameters.o2_necrosis_threshold ); 
+	B.put( parameters.o2_necrosis_max ); 
+	checkpoint_put_reference_phenotype( B , parameters.pReference_live_phenotype ); 
+	B.put( parameters.max_necrosis_rate ); 
+	B.put( parameters.necrosis_type ); 
+	
+	// functions.cycle_model is a template for new cell definitions, not state 
+	Cell_Functions& functions = pCell->functions; 
+	checkpoint_put_function( B , &Cell_Functions::volume_update_function , functions.volume_update_function ); 
+	checkpoint_put_function( B , &Cell_Functions::update_migration_bias , functions.update_migration_bias ); 
+	checkpoint_put_function( B , &Cell_Functions::custom_cell_rule , functions.custom_cell_rule ); 
+	checkpoint_put_function( B , &Cell_Functions::update_phenotype , functions.update_phenotype ); 
+	checkpoint_put_function( B , &Cell_Functions::update_velocity , functions.update_velocity ); 
+	checkpoint_put_function( B , &Cell_Functions::add_cell_basement_membrane_interactions , functions.add_cell_basement_membrane_interactions ); 
+	checkpoint_put_function( B , &Cell_Functions::calculate_distance_to_membrane , functions.calculate_distance_to_membrane ); 
+	checkpoint_put_function( B , &Cell_Functions::set_orientation , functions.set_orientation ); 
+	checkpoint_put_function( B , &Cell_Functions::contact_function , functions.contact_function ); 
+	
+	Phenotype& phenotype = pCell->phenotype; 
+	B.put( phenotype.flagged_for_division ); 
+	B.put( phenotype.flagged_for_removal ); 
+	
+	checkpoint_put_cycle_model( B , phenotype.cycle.pCycle_Model ); 
+	checkpoint_put_cycle_model( B , phenotype.cycle.data.pCycle_Model ); 
+	B.put( phenotype.cycle.data.time_units ); 
+	B.put( phenotype.cycle.data.transition_rates ); 
+	B.put( phenotype.cycle.data.current_phase_index ); 
+	B.put( phenotype.cycle.data.elapsed_time_in_phase ); 
+	
+	Death& death = phenotype.death; 
+	B.put( death.rates ); 
+	B.put( (unsigned int) death.models.size() ); 
+	for( unsigned int i=0; i < death.models.size(); i++ )
+	{ checkpoint_put_cycle_model( B , death.models[i] ); }
+	B.put( (unsigned int) death.parameters.size() ); 
+	for( unsigned int i=0; i < death.parameters.size(); i++ )
+	{
+		Death_Parameters& P = death.parameters[i]; 
+		B.put( P.time_units ); 
+		B.put( P.unlysed_fluid_change_rate ); 
+		B.put( P.lysed_fluid_change_rate ); 
+		B.put( P.cytoplasmic_biomass_change_rate ); 
+		B.put( P.nuclear_biomass_change_rate ); 
+		B.put( P.calcification_rate ); 
+		B.put( P.relative_rupture_volume ); 
+	}
+	B.put( death.dead ); 
+	B.put( death.current_death_model_index ); 
+	
+	Volume& volume = phenotype.volume; 
+	B.put( volume.total ); 
+	B.put( volume.solid ); 
+	B.put( volume.fluid ); 
+	B.put( volume.fluid_fraction ); 
+	B.put( volume.nuclear ); 
+	B.put( volume.nuclear_fluid ); 
+	B.put( volume.nuclear_solid ); 
+	B.put( volume.cytoplasmic ); 
+	B.put( volume.cytoplasmic_fluid ); 
+	B.put( volume.cytoplasmic_solid ); 
+	B.put( volume.calcified_fraction ); 
+	B.put( volume.cytoplasmic_to_nuclear_ratio ); 
+	B.put( volume.rupture_volume ); 
+	B.put( volume.cytoplasmic_biomass_change_rate ); 
+	B.put( volume.nuclear_biomass_change_rate ); 
+	B.put( volume.fluid_change_rate ); 
+	B.put( volume.calcification_rate ); 
+	B.put( volume.target_solid_cytoplasmic ); 
+	B.put( volume.target_solid_nuclear ); 
+	B.put( volume.target_fluid_fraction ); 
+	B.put( volume.target_cytoplasmic_to_nuclear_ratio ); 
+	B.put( volume.relative_rupture_volume ); 
+	
+	B.put( phenotype.geometry.radius ); 
+	B.put( phenotype.geometry.nuclear_radius ); 
+	B.put( phenotype.geometry.surface_area ); 
+	B.put( phenotype.geometry.polarity ); 
+	
+	Mechanics& mechanics = phenotype.mechanics; 
+	B.put( mechanics.cell_cell_adhesion_strength ); 
+	B.put( mechanics.cell_BM_adhesion_strength ); 
+	B.put( mechanics.cell_cell_repulsion_strength ); 
+	B.put( mechanics.cell_BM_repulsion_strength ); 
+	B.put( mechanics.relative_maximum_adhesion_distance ); 
+	
+	Motility& motility = phenotype.motility; 
+	B.put( motility.is_motile ); 
+	B.put( motility.persistence_time ); 
+	B.put( motility.migration_speed ); 
+	B.put( motility.migration_bias_direction ); 
+	B.put( motility.migration_bias ); 
+	B.put( motility.restrict_to_2D ); 
+	B.put( motility.motility_vector ); 
+	
+	B.put( phenotype.secretion.secretion_rates ); 
+	B.put( phenotype.secretion.uptake_rates ); 
+	B.put( phenotype.secretion.saturation_densities ); 
+	
+	B.put( phenotype.molecular.internalized_total_substrates ); 
+	B.put( phenotype.molecular.fraction_released_at_death ); 
+	B.put( phenotype.molecular.fraction_transferred_when_ingested ); 
+	return; 
+}
+
+// the reverse, into a new cell from create_cell() 
+
+static void checkpoint_get_cell( Checkpoint_Buffer& B , Cell* pCell )
+{
+	Vec3 position; 
+	double agent_volume = 0.0; 
+	B.get( pCell->ID ); 
+	B.get( pCell->type ); 
+	B.get( position ); 
+	B.get( pCell->velocity ); 
+	B.get( agent_volume ); 
+	
+	Vec3 previous_velocity; 
+	bool is_active = true; 
+	bool volume_is_changed = true; 
+	std::vector<double> temp1; 
+	std::vector<double> temp2; 
+	B.get( previous_velocity ); 
+	B.get( is_active ); 
+	B.get( volume_is_changed ); 
+	B.get( temp1 ); 
+	B.get( temp2 ); 
+	
+	bool is_out_of_domain = false; 
+	bool is_movable = true; 
+	B.get( pCell->type_name ); 
+	B.get( is_out_of_domain ); 
+	B.get( is_movable ); 
+	B.get( pCell->displacement ); 
+	B.get( pCell->state.orientation ); 
+	B.get( pCell->state.simple_pressure ); 
+	B.get( pCell->random_stream.stream_id ); 
+	B.get( pCell->random_stream.stream_type ); 
+	B.get( pCell->random_stream.counter ); 
+	
+	// rebuilt, so that the name lookups match 
+	pCell->custom_data = Custom_Cell_Data(); 
+	unsigned int number_of_variables = 0; 
+	B.get( number_of_variables ); 
+	for( unsigned int i=0; !B.failed && i < number_of_variables; i++ )
+	{
+		Variable v; 
+		B.get( v.name ); 
+		B.get( v.units ); 
+		B.get( v.value ); 
+		pCell->custom_data.add_variable( v ); 
+	}
+	B.get( number_of_variables ); 
+	for( unsigned int i=0; !B.failed && i < number_of_variables; i++ )
+	{
+		Vector_Variable v; 
+		B.get( v.name ); 
+		B.get( v.units ); 
+		B.get( v.value ); 
+		pCell->custom_data.add_vector_variable( v ); 
+	}
+	
+	Cell_Parameters& parameters = pCell->parameters; 
+	B.get( parameters.o2_hypoxic_threshold ); 
+	B.get( parameters.o2_hypoxic_response ); 
+	B.get( parameters.o2_hypoxic_saturation ); 
+	B.get( parameters.o2_proliferation_saturation ); 
+	B.get( parameters.o2_proliferation_threshold ); 
+	B.get( parameters.o2_reference ); 
+	B.get( parameters.o2_necrosis_threshold ); 
+	B.get( parameters.o2_necrosis_max ); 
+	checkpoint_get_reference_phenotype( B , parameters.pReference_live_phenotype ); 
+	B.get( parameters.max_necrosis_rate ); 
+	B.get( parameters.necrosis_type ); 
+	
+	Cell_Functions& functions = pCell->functions; 
+	checkpoint_get_function( B , &Cell_Functions::volume_update_function , functions.volume_update_function ); 
+	checkpoint_get_function( B , &Cell_Functions::update_migration_bias , functions.update_migration_bias ); 
+	checkpoint_get_function( B , &Cell_Functions::custom_cell_rule , functions.custom_cell_rule ); 
+	checkpoint_get_function( B , &Cell_Functions::update_phenotype , functions.update_phenotype ); 
+	checkpoint_get_function( B , &Cell_Functions::update_velocity , functions.update_velocity ); 
+	checkpoint_get_function( B , &Cell_Functions::add_cell_basement_membrane_interactions , functions.add_cell_basement_membrane_interactions ); 
+	checkpoint_get_function( B , &Cell_Functions::calculate_distance_to_membrane , functions.calculate_distance_to_membrane ); 
+	checkpoint_get_function( B , &Cell_Functions::set_orientation , functions.set_orientation ); 
+	checkpoint_get_function( B , &Cell_Functions::contact_function , functions.contact_function ); 
+	
+	Phenotype& phenotype = pCell->phenotype; 
+	B.get( phenotype.flagged_for_division ); 
+	B.get( phenotype.flagged_for_removal ); 
+	
+	// the phase maps follow the model, then the cell's own rates 
+	checkpoint_get_cycle_model( B , phenotype.cycle.pCycle_Model ); 
+	checkpoint_get_cycle_model( B , phenotype.cycle.data.pCycle_Model ); 
+	if( phenotype.cycle.pCycle_Model == NULL || phenotype.cycle.data.pCycle_Model == NULL )
+	{ B.failed = true; }
+	if( B.failed )
+	{ return; }
+	phenotype.cycle.data.sync_to_cycle_model(); 
+	B.get( phenotype.cycle.data.time_units ); 
+	B.get( phenotype.cycle.data.transition_rates ); 
+	B.get( phenotype.cycle.data.current_phase_index ); 
+	B.get( phenotype.cycle.data.elapsed_time_in_phase ); 
+	
+	Death& death = phenotype.death; 
+	unsigned int number_of_models = 0; 
+	B.get( death.rates ); 
+	B.get( number_of_models ); 
+	death.models.assign( B.failed ? 0 : number_of_models , NULL ); 
+	for( unsigned int i=0; i < death.models.size(); i++ )
+	{ checkpoint_get_cycle_model( B , death.models[i] ); }
+	B.get( number_of_models ); 
+	death.parameters.resize( B.failed ? 0 : number_of_models ); 
+	for( unsigned int i=0; i < death.parameters.size(); i++ )
+	{
+		Death_Parameters& P = death.parameters[i]; 
+		B.get( P.time_units ); 
+		B.get( P.unlysed_fluid_change_rate ); 
+		B.get( P.lysed_fluid_change_rate ); 
+		B.get( P.cytoplasmic_biomass_change_rate ); 
+		B.get( P.nuclear_biomass_change_rate ); 
+		B.get( P.calcification_rate ); 
+		B.get( P.relative_rupture_volume ); 
+	}
+	B.get( death.dead ); 
+	B.get( death.current_death_model_index ); 
+	
+	Volume& volume = phenotype.volume; 
+	B.get( volume.total ); 
+	B.get( volume.solid ); 
+	B.get( volume.fluid ); 
+	B.get( volume.fluid_fraction ); 
+	B.get( volume.nuclear ); 
+	B.get( volume.nuclear_fluid ); 
+	B.get( volume.nuclear_solid ); 
+	B.get( volume.cytoplasmic ); 
+	B.get( volume.cytoplasmic_fluid ); 
+	B.get( volume.cytoplasmic_solid ); 
+	B.get( volume.calcified_fraction ); 
+	B.get( volume.cytoplasmic_to_nuclear_ratio ); 
+	B.get( volume.rupture_volume ); 
+	B.get( volume.cytoplasmic_biomass_change_rate ); 
+	B.get( volume.nuclear_biomass_change_rate ); 
+	B.get( volume.fluid_change_rate ); 
+	B.get( volume.calcification_rate ); 
+	B.get( volume.target_solid_cytoplasmic ); 
+	B.get( volume.target_solid_nuclear ); 
+	B.get( volume.target_fluid_fraction ); 
+	B.get( volume.target_cytoplasmic_to_nuclear_ratio ); 
+	B.get( volume.relative_rupture_volume ); 
+	
+	Geometry geometry; 
+	B.get( geometry.radius ); 
+	B.get( geometry.nuclear_radius ); 
+	B.get( geometry.surface_area ); 
+	B.get( geometry.polarity ); 
+	
+	Mechanics& mechanics = phenotype.mechanics; 
+	B.get( mechanics.cell_cell_adhesion_strength ); 
+	B.get( mechanics.cell_BM_adhesion_strength ); 
+	B.get( mechanics.cell_cell_repulsion_strength ); 
+	B.get( mechanics.cell_BM_repulsion_strength ); 
+	B.get( mechanics.relative_maximum_adhesion_distance ); 
+	
+	Motility& motility = phenotype.motility; 
+	B.get( motility.is_motile ); 
+	B.get( motility.persistence_time ); 
+	B.get( motility.migration_speed ); 
+	B.get( motility.migration_bias_direction ); 
+	B.get( motility.migration_bias ); 
+	B.get( motility.restrict_to_2D ); 
+	B.get( motility.motility_vector ); 
+	
+	B.get( phenotype.secretion.secretion_rates ); 
+	B.get( phenotype.secretion.uptake_rates ); 
+	B.get( phenotype.secretion.saturation_densities ); 
+	
+	B.get( phenotype.molecular.internalized_total_substrates ); 
+	B.get( phenotype.molecular.fraction_released_at_death ); 
+	B.get( phenotype.molecular.fraction_transferred_when_ingested ); 
+	if( B.failed )
+	{ return; }
+	
+	// link the rate vectors to the cell (which resets its volume and 
+	// geometry), then put back the values they had 
+	phenotype.secretion.sync_to_cell( pCell , phenotype , diffusion_dt ); 
+	pCell->assign_position( position[0] , position[1] , position[2] ); 
+	pCell->Basic_Agent::set_total_volume( agent_volume ); 
+	phenotype.geometry.radius = geometry.radius; 
+	phenotype.geometry.nuclear_radius = geometry.nuclear_radius; 
+	phenotype.geometry.surface_area = geometry.surface_area; 
+	phenotype.geometry.polarity = geometry.polarity; 
+	pCell->set_checkpoint_state( previous_velocity , is_active , volume_is_changed , temp1 , temp2 ); 
+	pCell->is_out_of_domain = is_out_of_domain; 
+	pCell->is_movable = is_movable; 
+	return; 
+}
+
+bool save_PhysiCell_checkpoint( std::string filename , Microenvironment& M )
+{
+	// the saves queued so far belong to the checkpointed run 
+	if( PhysiCell_settings.enable_background_writer == true )
+	{ PhysiCell_background_writer.finish(); }
+	
+	Cell_Container* pContainer = (Cell_Container*) M.agent_container; 
+	Checkpoint_Buffer B; 
+	
+	B.write( PhysiCell_checkpoint_magic , 8 ); 
+	B.put( PhysiCell_checkpoint_endian_marker ); 
+	B.put( PhysiCell_checkpoint_version ); 
+	
+	// globals 
+	
+	B.put( PhysiCell_globals.current_time ); 
+	B.put( PhysiCell_globals.next_full_save_time ); 
+	B.put( PhysiCell_globals.next_SVG_save_time ); 
+	B.put( PhysiCell_globals.full_output_index ); 
+	B.put( PhysiCell_globals.SVG_output_index ); 
+	B.put( PhysiCell_globals.next_checkpoint_time ); 
+	B.put( PhysiCell_globals.checkpoint_index ); 
+	
+	B.put( pContainer->last_diffusion_time ); 
+	B.put( pContainer->last_cell_cycle_time ); 
+	B.put( pContainer->last_mechanics_time ); 
+	B.put( pContainer->is_initialized() ); 
+	B.put( pContainer->max_cell_interactive_distance_in_voxel ); // as of the last phenotype step 
+	
+	double position_d1 = 0.0; 
+	double position_d2 = 0.0; 
+	bool position_constants_defined = false; 
+	get_position_update_constants( position_d1 , position_d2 , position_constants_defined ); 
+	B.put( position_d1 ); 
+	B.put( position_d2 ); 
+	B.put( position_constants_defined ); 
+	
+	B.put( get_next_basic_agent_ID() ); 
+	B.put( get_random_seed() ); 
+	B.put( get_default_random_stream().counter ); 
+	
+	// densities 
+	
+	B.put( (unsigned int) M.number_of_densities() ); 
+	for( unsigned int i=0; i < M.number_of_densities(); i++ )
+	{ B.put( M.density_names[i] ); }
+	B.put( (unsigned long long) M.number_of_voxels() ); 
+	for( unsigned int n=0; n < M.number_of_voxels(); n++ )
+	{
+		std::vector<double>& density = M.density_vector( n ); 
+		B.write( density.data() , density.size() * sizeof(double) ); 
+	}
+	
+	// cells 
+	
+	B.put( (unsigned long long) (*all_cells).size() ); 
+	for( unsigned int i=0; i < (*all_cells).size(); i++ )
+	{ checkpoint_put_cell( B , (*all_cells)[i] ); }
+	if( B.failed )
+	{
+		std::cout << "Error: A cell uses a function, reference phenotype or cycle model that no cell definition " << std::endl 
+			<< "       (or standard model) has, so " << filename << " cannot be written." << std::endl; 
+		return false; 
+	}
+	
+	std::string temporary = filename + ".tmp"; 
+	FILE* fp = fopen( temporary.c_str() , "wb" ); 
+	if( fp == NULL )
+	{
+		std::cout << "Error: Failed to open " << temporary << " for checkpoint writing." << std::endl; 
+		return false; 
+	}
+	bool success = ( fwrite( B.data.data() , 1 , B.data.size() , fp ) == B.data.size() ); 
+	success = ( fclose( fp ) == 0 ) && success; 
+	success = success && rename( temporary.c_str() , filename.c_str() ) == 0; 
+	if( !success )
+	{ std::cout << "Error: Failed to write " << filename << std::endl; }
+	return success; 
+}
+
+bool load_PhysiCell_checkpoint( std::string filename , Microenvironment& M )
+{
+	Cell_Container* pContainer = (Cell_Container*) M.agent_container; 
+	if( (*all_cells).size() > 0 )
+	{
+		std::cout << "Error: Checkpoints are loaded instead of setting up the tissue (there are cells already)." << std::endl; 
+		return false; 
+	}
+	
+	Checkpoint_Buffer B; 
+	FILE* fp = fopen( filename.c_str() , "rb" ); 
+	if( fp == NULL )
+	{
+		std::cout << "Error: Failed to open " << filename << " for checkpoint reading." << std::endl; 
+		return false; 
+	}
+	bool success = ( fseek( fp , 0 , SEEK_END ) == 0 ); 
+	long bytes = ftell( fp ); 
+	success = success && bytes >= 0 && fseek( fp , 0 , SEEK_SET ) == 0; 
+	if( success )
+	{
+		B.data.resize( bytes ); 
+		success = ( fread( B.data.data() , 1 , bytes , fp ) == (size_t) bytes ); 
+	}
+	fclose( fp ); 
+	
+	char magic [8]; 
+	unsigned int marker = 0; 
+	unsigned int version = 0; 
+	B.read( magic , 8 ); 
+	B.get( marker ); 
+	B.get( version ); 
+	if( !success || B.failed || memcmp( magic , PhysiCell_checkpoint_magic , 8 ) != 0 
+		|| marker != PhysiCell_checkpoint_endian_marker || version != PhysiCell_checkpoint_version )
+	{
+		std::cout << "Error: " << filename << " is not a PhysiCell checkpoint." << std::endl; 
+		return false; 
+	}
+	// globals (set once the cells are in place) 
+	
+	PhysiCell_Globals globals; 
+	B.get( globals.current_time ); 
+	B.get( globals.next_full_save_time ); 
+	B.get( globals.next_SVG_save_time ); 
+	B.get( globals.full_output_index ); 
+	B.get( globals.SVG_output_index ); 
+	B.get( globals.next_checkpoint_time ); 
+	B.get( globals.checkpoint_index ); 
+	
+	double container_times [3]; 
+	bool container_initialized = false; 
+	B.get( container_times[0] ); 
+	B.get( container_times[1] ); 
+	B.get( container_times[2] ); 
+	B.get( container_initialized ); 
+	std::vector<double> max_cell_interactive_distance; 
+	B.get( max_cell_interactive_distance ); 
+	
+	double position_d1 = 0.0; 
+	double position_d2 = 0.0; 
+	bool position_constants_defined = false; 
+	B.get( position_d1 ); 
+	B.get( position_d2 ); 
+	B.get( position_constants_defined ); 
+	
+	int next_ID = 0; 
+	unsigned long long seed = 0; 
+	unsigned long long counter = 0; 
+	B.get( next_ID ); 
+	B.get( seed ); 
+	B.get( counter ); 
+	
+	// densities, on the same substrates and mesh 
+	
+	unsigned int number_of_densities = 0; 
+	unsigned long long number_of_voxels = 0; 
+	B.get( number_of_densities ); 
+	success = !B.failed && number_of_densities == M.number_of_densities(); 
+	for( unsigned int i=0; success && i < number_of_densities; i++ )
+	{
+		std::string name; 
+		B.get( name ); 
+		success = !B.failed && name == M.density_names[i]; 
+	}
+	B.get( number_of_voxels ); 
+	success = success && !B.failed && number_of_voxels == M.number_of_voxels(); 
+	if( !success )
+	{
+		std::cout << "Error: The substrates or the mesh of " << filename << " differ from the microenvironment." << std::endl; 
+		return false; 
+	}
+	for( unsigned int n=0; n < M.number_of_voxels(); n++ )
+	{
+		std::vector<double>& density = M.density_vector( n ); 
+		B.read( density.data() , density.size() * sizeof(double) ); 
+	}
+	M.invalidate_gradient_vectors(); 
+	
+	// cells 
+	
+	unsigned long long number_of_cells = 0; 
+	B.get( number_of_cells ); 
+	for( unsigned long long i=0; !B.failed && i < number_of_cells; i++ )
+	{ checkpoint_get_cell( B , create_cell() ); }
+	if( B.failed )
+	{
+		std::cout << "Error: " << filename << " is damaged, or its cell definitions differ from this program's." << std::endl; 
+		return false; 
+	}
+	
+	PhysiCell_globals = globals; 
+	pContainer->last_diffusion_time = container_times[0]; 
+	pContainer->last_cell_cycle_time = container_times[1]; 
+	pContainer->last_mechanics_time = container_times[2]; 
+	pContainer->set_initialized( container_initialized ); 
+	if( max_cell_interactive_distance.size() == pContainer->max_cell_interactive_distance_in_voxel.size() )
+	{ pContainer->max_cell_interactive_distance_in_voxel = max_cell_interactive_distance; }
+	set_position_update_constants( position_d1 , position_d2 , position_constants_defined ); 
+	
+	// last, as creating the cells above used IDs and random numbers 
+	set_next_basic_agent_ID( next_ID ); 
+	SeedRandom( (long) seed ); 
+	get_default_random_stream().counter = counter; 
+	
+	std::cout << "Resuming from " << filename << " at t = " << PhysiCell_globals.current_time 
+		<< " " << PhysiCell_settings.time_units << " (" << number_of_cells << " cells)" << std::endl; 
+	return true; 
+}
+
+};
@@ -0,0 +1,112 @@
+/*
+###############################################################################
+# If you use PhysiCell in your project, please cite PhysiCell and the version #
+# number, such as below:                                                      #
+#                                                                             #
+# We implemented and solved the model using PhysiCell (Version x.y.z) [1].    #
+#                                                                             #
+# [1] A Ghaffarizadeh, R Heiland, SH Friedman, SM Mumenthaler, and P Macklin, #
+#     PhysiCell: an Open Source Physics-Based Cell Simulator for Multicellu-  #
+#     lar Systems, PLoS Comput. Biol. 14(2): e1005991, 2018                   #
+#     DOI: 10.1371/journal.pcbi.1005991                                       #
+#                                                                             #
+# See VERSION.txt or call get_PhysiCell_version() to get the current version  #
+#     x.y.z. Call display_citations() to get detailed information on all cite-#
+#     able software used in your PhysiCell application.                       #
+#                                                                             #
+# Because PhysiCell extensively uses BioFVM, we suggest you also cite BioFVM  #
+#     as below:                                                               #
+#                                                                             #
+# We implemented and solved the model using PhysiCell (Version x.y.z) [1],    #
+# with BioFVM [2] to solve the transport equations.                           #
+#                                                                             #
+# [1] A Ghaffarizadeh, R Heiland, SH Friedman, SM Mumenthaler, and P Macklin, #
+#     PhysiCell: an Open Source Physics-Based Cell Simulator for Multicellu-  #
+#     lar Systems, PLoS Comput. Biol. 14(2): e1005991, 2018                   #
+#     DOI: 10.1371/journal.pcbi.1005991                                       #
+#                                                                             #
+# [2] A Ghaffarizadeh, SH Friedman, and P Macklin, BioFVM: an efficient para- #
+#     llelized diffusive transport solver for 3-D biological simulations,     #
+#     Bioinformatics 32(8): 1256-8, 2016. DOI: 10.1093/bioinformatics/btv730  #
+#                                                                             #
+###############################################################################
+#                                                                             #
+# BSD 3-Clause License (see https://opensource.org/licenses/BSD-3-Clause)     #
+#                                                                             #
+# Copyright (c) 2015-2018, Paul Macklin and the PhysiCell Project             #
+# All rights reserved.                                                        #
+#                                                                             #
+# Redistribution and use in source and binary forms, with or without          #
+# modification, are permitted provided that the following conditions are met: #
+#                                                                             #
+# 1. Redistributions of source code must retain the above copyright notice,   #
+# this list of conditions and the following disclaimer.                       #
+#                                                                             #
+# 2. Redistributions in binary form must reproduce the above copyright        #
+# notice, this list of conditions and the following disclaimer in the         #
+# documentation and/or other materials provided with the distribution.        #
+#                                                                             #
+# 3. Neither the name of the copyright holder nor the names of its            #
+# contributors may be used to endorse or promote products derived from this   #
+# software without specific prior written permission.                         #
+#                                                                             #
+# THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" #
+# AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE   #
+# IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE  #
+# ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE   #
+# LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR         #
+# CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF        #
+# SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS    #
+# INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN     #
+# CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)     #
+# ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE  #
+# POSSIBILITY OF SUCH DAMAGE.                                                 #
+#                                                                             #
+###############################################################################
+*/
+
+#ifndef __PhysiCell_checkpoint_h__
+#define __PhysiCell_checkpoint_h__
+
+#include <iostream>
+#include <string>
+
+#include "../core/PhysiCell.h"
+
+namespace PhysiCell{
+
+// Checkpoints: the complete state of a simulation, so that a long run can be 
+// stopped and resumed, or several parameter variants can be forked from one 
+// warmed-up state. Unlike a full save, a checkpoint keeps everything the next 
+// step depends on: each cell's phenotype (including the cycle phase and the 
+// time elapsed in it), custom data, parameters, function pointers, previous 
+// velocity and random stream, as well as the densities, PhysiCell_globals, 
+// the cell container's update clocks, the next cell ID and the random seed. 
+// On one thread, a resumed run continues exactly (bit for bit) as the 
+// original run would have. 
+// 
+// Function pointers and reference phenotypes are stored by the name of a 
+// cell definition that has them (see all_cell_definitions()), and cycle 
+// models by their code and name (found among the definitions' models and the 
+// standard models), so any build with the same cell definitions can resume 
+// a checkpoint. Saving fails for a cell whose functions no definition has. 
+// Not included: the solvers' caches (rebuilt as needed), the coarse state of 
+// the quasi-steady and adaptive mesh solvers, and global variables of custom 
+// modules. 
+// 
+// File layout (native byte order, checked by the endian marker): 
+//   "PCCHKP01" , uint32 endian marker 0x01020304 , uint32 version , 
+//   then the globals, the densities ( uint32 substrates and their names , 
+//   uint64 voxels , the density vectors ), and the cells in all_cells order 
+// (see PhysiCell_checkpoint.cpp for the cell records). 
+
+// writes the file atomically (to filename.tmp, then renamed) 
+bool save_PhysiCell_checkpoint( std::string filename , Microenvironment& M ); 
+
+// call instead of setup_tissue(), once the microenvironment, the cell 
+// container and the cell definitions are set up (there must be no cells yet) 
+bool load_PhysiCell_checkpoint( std::string filename , Microenvironment& M ); 
+
+};
+
+#endif
@@ -0,0 +1,248 @@
+/*
+###############################################################################
+# If you use PhysiCell in your project, please cite PhysiCell and the version #
+# number, such as below:                                                      #
+#                                                                             #
+# We implemented and solved the model using PhysiCell (Version x.y.z) [1].    #
+#                                                                             #
+# [1] A Ghaffarizadeh, R Heiland, SH Friedman, SM Mumenthaler, and P Macklin, #
+#     PhysiCell: an Open Source Physics-Based Cell Simulator for Multicellu-  #
+#     lar Systems, PLoS Comput. Biol. 14(2): e1005991, 2018                   #
+#     DOI: 10.1371/journal.pcbi.1005991                                       #
+#                                                                             #
+# See VERSION.txt or call get_PhysiCell_version() to get the current version  #
+#     x.y.z. Call display_citations() to get detailed information on all cite-#
+#     able software used in your PhysiCell application.                       #
+#                                                                             #
+# Because PhysiCell extensively uses BioFVM, we suggest you also cite BioFVM  #
+#     as below:                                                               #
+#                                                                             #
+# We implemented and solved the model using PhysiCell (Version x.y.z) [1],    #
+# with BioFVM [2] to solve the transport equations.                           #
+#                                                                             #
+# [1] A Ghaffarizadeh, R Heiland, SH Friedman, SM Mumenthaler, and P Macklin, #
+#     PhysiCell: an Open Source Physics-Based Cell Simulator for Multicellu-  #
+#     lar Systems, PLoS Comput. Biol. 14(2): e1005991, 2018                   #
+#     DOI: 10.1371/journal.pcbi.1005991                                       #
+#                                                                             #
+# [2] A Ghaffarizadeh, SH Friedman, and P Macklin, BioFVM: an efficient para- #
+#     llelized diffusive transport solver for 3-D biological simulations,     #
+#     Bioinformatics 32(8): 1256-8, 2016. DOI: 10.1093/bioinformatics/btv730  #
+#                                                                             #
+###############################################################################
+#                                                                             #
+# BSD 3-Clause License (see https://opensource.org/licenses/BSD-3-Clause)     #
+#                                                                             #
+# Copyright (c) 2015-2018, Paul Macklin and the PhysiCell Project             #
+# All rights reserved.                                                        #
+#                                                                             #
+# Redistribution and use in source and binary forms, with or without          #
+# modification, are permitted provided that the following conditions are met: #
+#                                                                             #
+# 1. Redistributions of source code must retain the above copyright notice,   #
+# this list of conditions and the following disclaimer.                       #
+#                                                                             #
+# 2. Redistributions in binary form must reproduce the above copyright        #
+# notice, this list of conditions and the following disclaimer in the         #
+# documentation and/or other materials provided with the distribution.        #
+#                                                                             #
+# 3. Neither the name of the copyright holder nor the names of its            #
+# contributors may be used to endorse or promote products derived from this   #
+# software without specific prior written permission.                         #
+#                                                                             #
+# THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" #
+# AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE   #
+# IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE  #
+# ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE   #
+# LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR         #
+# CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF        #
+# SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS    #
+# INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN     #
+# CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)     #
+# ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE  #
+# POSSIBILITY OF SUCH DAMAGE.                                                 #
+#                                                                             #
+###############################################################################
+*/
+ 
+#include "./PhysiCell_compression.h"
+
+#include <cstring>
+
+namespace PhysiCell{
+
+// Block format: a sequence of 
+//   token ( literal length << 4 | match length - 4 ) , 
+//   [ more literal length: bytes of 255 , then the rest ] , literals , 
+//   offset ( 2 bytes , little end first ) , [ more match length ] 
+// where the last sequence has only literals. 
+
+static const int compression_hash_bits = 16; 
+static const size_t compression_minimum_match = 4; 
+static const size_t compression_maximum_offset = 65535; 
+static const size_t compression_end_literals = 5; // the last bytes are always literals 
+
+static inline unsigned int compression_read32( const unsigned char* p )
+{
+	unsigned int value; 
+	memcpy( &value , p , 4 ); 
+	return value; 
+}
+
+static inline unsigned int compression_hash( unsigned int sequence )
+{ return ( sequence * 2654435761u ) >> ( 32 - compression_hash_bits ); }
+
+static void compression_write_length( std::vector<unsigned char>& output , size_t length )
+{
+	while( length >= 255 )
+	{
+		output.push_back( 255 ); 
+		length -= 255; 
+	}
+	output.push_back( (unsigned char) length ); 
+	return; 
+}
+
+static void compression_write_sequence( std::vector<unsigned char>& output , const unsigned char* literals , 
+	size_t literal_length , size_t offset , size_t match_length )
+{
+	size_t match_code = match_length - compression_minimum_match; 
+	unsigned char token = (unsigned char) ( ( literal_length < 15 ? literal_length : 15 ) << 4 ); 
+	if( match_length > 0 )
+	{ token |= (unsigned char) ( match_code < 15 ? match_code : 15 ); }
+	output.push_back( token ); 
+	
+	if( literal_length >= 15 )
+	{ compression_write_length( output , literal_length - 15 ); }
+	output.insert( output.end() , literals , literals + literal_length ); 
+	
+	if( match_length > 0 )
+	{
+		output.push_back( (unsigned char) ( offset & 255 ) ); 
+		output.push_back( (unsigned char) ( offset >> 8 ) ); 
+		if( match_code >= 15 )
+		{ compression_write_length( output , match_code - 15 ); }
+	}
+	return; 
+}
+
+void compress_block( const unsigned char* input , size_t input_size , std::vector<unsigned char>& output )
+{
+	// positions of the last occurrence of each (hashed) 4-byte sequence 
+	static thread_local std::vector<long long> table; 
+	table.assign( 1 << compression_hash_bits , -1 ); 
+	
+	size_t anchor = 0; 
+	size_t position = 0; 
+	if( input_size > compression_end_literals + compression_minimum_match )
+	{
+		size_t last_match_start = input_size - compression_end_literals - compression_minimum_match; 
+		size_t match_end_limit = input_size - compression_end_literals; 
+		
+		while( position <= last_match_start )
+		{
+			unsigned int sequence = compression_read32( input + position ); 
+			unsigned int h = compression_hash( sequence ); 
+			long long reference = table[h]; 
+			table[h] = position; 
+			
+			if( reference < 0 || position - reference > compression_maximum_offset 
+				|| compression_read32( input + reference ) != sequence )
+			{
+				position++; 
+				continue; 
+			}
+			
+			size_t length = compression_minimum_match; 
+			while( position + length < match_end_limit && input[reference+length] == input[position+length] )
+			{ length++; }
+			
+			compression_write_sequence( output , input + anchor , position - anchor , position - reference , length ); 
+			position += length; 
+			anchor = position; 
+		}
+	}
+	
+	compression_write_sequence( output , input + anchor , input_size - anchor , 0 , 0 ); 
+	return; 
+}
+
+static bool compression_read_length( const unsigned char* input , size_t input_size , size_t& position , size_t& length )
+{
+	unsigned char byte = 255; 
+	while( byte == 255 )
+	{
+		if( position >= input_size )
+		{ return false; }
+		byte = input[position++]; 
+		length += byte; 
+	}
+	return true; 
+}
+
+bool decompress_block( const unsigned char* input , size_t input_size , unsigned char* output , size_t output_size )
+{
+	size_t in = 0; 
+	size_t out = 0; 
+	while( in < input_size )
+	{
+		unsigned char token = input[in++]; 
+		
+		size_t literal_length = token >> 4; 
+		if( literal_length == 15 && !compression_read_length( input , input_size , in , literal_length ) )
+		{ return false; }
+		if( literal_length > input_size - in || literal_length > output_size - out )
+		{ return false; }
+		memcpy( output + out , input + in , literal_length ); 
+		in += literal_length; 
+		out += literal_length; 
+		
+		if( in == input_size )
+		{ break; }
+		
+		if( input_size - in < 2 )
+		{ return false; }
+		size_t offset = input[in] | ( input[in+1] << 8 ); 
+		in += 2; 
+		size_t match_length = token & 15; 
+		if( match_length == 15 && !compression_read_length( input , input_size , in , match_length ) )
+		{ return false; }
+		match_length += compression_minimum_match; 
+		if( offset == 0 || offset > out || match_length > output_size - out )
+		{ return false; }
+		
+		// byte by byte: the match may overlap what it copies 
+		const unsigned char* source = output + out - offset; 
+		for( size_t i=0; i < match_length; i++ )
+		{ output[out+i] = source[i]; }
+		out += match_length; 
+	}
+	return out == output_size; 
+}
+
+void shuffle_bytes( const unsigned char* input , size_t size , int element_size , unsigned char* output )
+{
+	size_t n = size / element_size; 
+	for( int k=0; k < element_size; k++ )
+	{
+		for( size_t i=0; i < n; i++ )
+		{ output[k*n+i] = input[i*element_size+k]; }
+	}
+	// a partial last element is left as is 
+	memcpy( output + n*element_size , input + n*element_size , size - n*element_size ); 
+	return; 
+}
+
+void unshuffle_bytes( const unsigned char* input , size_t size , int element_size , unsigned char* output )
+{
+	size_t n = size / element_size; 
+	for( int k=0; k < element_size; k++ )
+	{
+		for( size_t i=0; i < n; i++ )
+		{ output[i*element_size+k] = input[k*n+i]; }
+	}
+	memcpy( output + n*element_size , input + n*element_size , size - n*element_size ); 
+	return; 
+}
+
+};
@@ -361,13 +361,81 @@ std::string formatted_minutes_to_DDHHMM( double minutes )
 	return output ;
 }
 
+SVG_Snapshot::SVG_Snapshot()
+{
+	z_slice = 0.0; 
+	time = 0.0; 
+	total_cell_count = 0; 
+	dx = 1.0; 
+	dy = 1.0; 
+	bounding_box.assign( 6 , 0.0 ); 
+	return; 
+}
+
+void SVG_Snapshot::capture( Microenvironment& M, double z_slice_in , double time_in, std::vector<std::string> (*cell_coloring_function)(Cell*) )
+{
+	options = PhysiCell_SVG_options; 
+	z_slice = z_slice_in; 
+	time = time_in; 
+	bounding_box = M.mesh.bounding_box; 
+	dx = M.mesh.dx; 
+	dy = M.mesh.dy; 
+	total_cell_count = all_cells->size(); 
+	
+	RUNTIME_TOC(); 
+	runtime = format_stopwatch_value( runtime_stopwatch_value() );
+	
+	// the cells that intersect the slice, with their colors. The coloring 
+	// function is user code, so this stays serial. 
+	
+	unsigned int n = 0; 
+	for( int i=0 ; i < total_cell_count ; i++ )
+	{
+		Cell* pC = (*all_cells)[i]; 
+		if( fabs( (pC->position)[2] - z_slice ) < pC->phenotype.geometry.radius )
+		{
+			if( cells.size() <= n )
+			{ cells.resize( n+1 ); }
+			SVG_Snapshot_Cell& C = cells[n]; 
+			C.ID = pC->ID; 
+			C.x = (pC->position)[0]; 
+			C.y = (pC->position)[1]; 
+			C.z_distance = fabs( (pC->position)[2] - z_slice ); 
+			C.radius = pC->phenotype.geometry.radius; 
+			C.nuclear_radius = pC->phenotype.geometry.nuclear_radius; 
+			C.colors = cell_coloring_function( pC ); 
+			n++; 
+		}
+	}
+	cells.resize( n ); 
+	
+	return; 
+}
+
 void SVG_plot( std::string filename , Microenvironment& M, double z_slice , double time, std::vector<std::string> (*cell_coloring_function)(Cell*) )
 {
-	double X_lower = M.mesh.bounding_box[0];
-	double X_upper = M.mesh.bounding_box[3];
+	static SVG_Snapshot snapshot; 
+	snapshot.capture( M , z_slice , time , cell_coloring_function ); 
+	if( !SVG_plot( filename , snapshot ) )
+	{
+		std::cout << std::endl << "Error: We're not writing data like we expect. " << std::endl
+		<< "Check to make sure your save directory exists. " << std::endl << std::endl
+		<< "I'm going to exit with a crash code of -1 now until " << std::endl 
+		<< "you fix your directory. Sorry!" << std::endl << std::endl; 
+		exit(-1); 
+	}
+	return; 
+}
+ 
+bool SVG_plot( std::string filename , SVG_Snapshot& S )
+{
+	double z_slice = S.z_slice; 
+	
+	double X_lower = S.bounding_box[0];
+	double X_upper = S.bounding_box[3];
  
-	double Y_lower = M.mesh.bounding_box[1]; 
-	double Y_upper = M.mesh.bounding_box[4]; 
+	double Y_lower = S.bounding_box[1]; 
+	double Y_upper = S.bounding_box[4]; 
 
 	double plot_width = X_upper - X_lower; 
 	double plot_height = Y_upper - Y_lower; 
@@ -380,12 +448,7 @@ void SVG_plot( std::string filename , Microenvironment& M, double z_slice , doub
 	if( os.fail() )
 	{ 
 		std::cout << std::endl << "Error: Failed to open " << filename << " for SVG writing." << std::endl << std::endl; 
-
-		std::cout << std::endl << "Error: We're not writing data like we expect. " << std::endl
-		<< "Check to make sure your save directory exists. " << std::endl << std::endl
-		<< "I'm going to exit with a crash code of -1 now until " << std::endl 
-		<< "you fix your directory. Sorry!" << std::endl << std::endl; 
-		exit(-1); 
+		return false; 
 	} 
 	
 	Write_SVG_start( os, plot_width , plot_height + top_margin );
@@ -398,19 +461,19 @@ void SVG_plot( std::string filename , Microenvironment& M, double z_slice , doub
 	char* szString; 
 	szString = new char [1024]; 
  
-	int total_cell_count = all_cells->size(); 
+	int total_cell_count = S.total_cell_count; 
  
-	double temp_time = time; 
+	double temp_time = S.time; 
 
 	std::string time_label = formatted_minutes_to_DDHHMM( temp_time ); 
  
 	sprintf( szString , "Current time: %s, z = %3.2f %s", time_label.c_str(), 
-		z_slice , PhysiCell_SVG_options.simulation_space_units.c_str() ); 
+		z_slice , S.options.simulation_space_units.c_str() ); 
 	Write_SVG_text( os, szString, font_size*0.5,  font_size*(.2+1), 
-		font_size, PhysiCell_SVG_options.font_color.c_str() , PhysiCell_SVG_options.font.c_str() );
+		font_size, S.options.font_color.c_str() , S.options.font.c_str() );
 	sprintf( szString , "%u agents" , total_cell_count ); 
 	Write_SVG_text( os, szString, font_size*0.5,  font_size*(.2+1+.2+.9), 
-		0.95*font_size, PhysiCell_SVG_options.font_color.c_str() , PhysiCell_SVG_options.font.c_str() );
+		0.95*font_size, S.options.font_color.c_str() , S.options.font.c_str() );
 	
 	delete [] szString; 
 
@@ -422,8 +485,8 @@ void SVG_plot( std::string filename , Microenvironment& M, double z_slice , doub
 	   
 	// prepare to do mesh-based plot (later)
 	
-	double dx_stroma = M.mesh.dx; 
-	double dy_stroma = M.mesh.dy; 
+	double dx_stroma = S.dx; 
+	double dy_stroma = S.dy; 
 	
 	os << "  <g id=\"ECM\">" << std::endl; 
   
@@ -490,37 +553,31 @@ void SVG_plot( std::string filename , Microenvironment& M, double z_slice , doub
  
 	// plot intersecting cells 
 	os << "  <g id=\"cells\">" << std::endl; 
-	for( int i=0 ; i < total_cell_count ; i++ )
+	for( unsigned int i=0 ; i < S.cells.size() ; i++ )
 	{
-		Cell* pC = (*all_cells)[i]; // global_cell_list[i]; 
+		SVG_Snapshot_Cell& C = S.cells[i]; 
+		std::vector<std::string>& Colors = C.colors; 
+		double r = C.radius; 
+		double rn = C.nuclear_radius; 
+		double z = C.z_distance; 
   
-		static std::vector<std::string> Colors; 
-		if( fabs( (pC->position)[2] - z_slice ) < pC->phenotype.geometry.radius )
+		os << "   <g id=\"cell" << C.ID << "\">" << std::endl; 
+		
+		// figure out how much of the cell intersects with z = 0 
+		
+		double plot_radius = sqrt( r*r - z*z ); 
+		
+		Write_SVG_circle( os, C.x-X_lower, C.y-Y_lower, 
+			plot_radius , 0.5, Colors[1], Colors[0] ); 
+		
+		// plot the nucleus if it, too intersects z = 0;
+		if( fabs(z) < rn && S.options.plot_nuclei == true )
 		{
-			double r = pC->phenotype.geometry.radius ; 
-			double rn = pC->phenotype.geometry.nuclear_radius ; 
-			double z = fabs( (pC->position)[2] - z_slice) ; 
-   
-			Colors = cell_coloring_function( pC ); 
-
-			os << "   <g id=\"cell" << pC->ID << "\">" << std::endl; 
-  
-			// figure out how much of the cell intersects with z = 0 
-   
-			double plot_radius = sqrt( r*r - z*z ); 
-
-			Write_SVG_circle( os, (pC->position)[0]-X_lower, (pC->position)[1]-Y_lower, 
-				plot_radius , 0.5, Colors[1], Colors[0] ); 
-
-			// plot the nucleus if it, too intersects z = 0;
-			if( fabs(z) < rn && PhysiCell_SVG_options.plot_nuclei == true )
-			{   
-				plot_radius = sqrt( rn*rn - z*z ); 
-			 	Write_SVG_circle( os, (pC->position)[0]-X_lower, (pC->position)[1]-Y_lower, 
-					plot_radius, 0.5, Colors[3],Colors[2]); 
-			}					  
-			os << "   </g>" << std::endl;
+			plot_radius = sqrt( rn*rn - z*z ); 
+			Write_SVG_circle( os, C.x-X_lower, C.y-Y_lower, 
+				plot_radius, 0.5, Colors[3],Colors[2]); 
 		}
+		os << "   </g>" << std::endl;
 	}
 	os << "  </g>" << std::endl; 
 	
@@ -553,14 +610,14 @@ void SVG_plot( std::string filename , Microenvironment& M, double z_slice , doub
  
 	double bar_margin = 0.025 * plot_height; 
 	double bar_height = 0.01 * plot_height; 
-	double bar_width = PhysiCell_SVG_options.length_bar; 
+	double bar_width = S.options.length_bar; 
 	double bar_stroke_width = 0.001 * plot_height; 
 	
-	std::string bar_units = PhysiCell_SVG_options.simulation_space_units; 
+	std::string bar_units = S.options.simulation_space_units; 
 	// convert from micron to mm
 	double temp = bar_width;  
 
-	if( temp > 999 && std::strstr( bar_units.c_str() , PhysiCell_SVG_options.mu.c_str() )   )
+	if( temp > 999 && std::strstr( bar_units.c_str() , S.options.mu.c_str() )   )
 	{
 		temp /= 1000;
 		bar_units = "mm";
@@ -579,16 +636,14 @@ void SVG_plot( std::string filename , Microenvironment& M, double z_slice , doub
 		bar_width , bar_height , 0.002 * plot_height , "rgb(255,255,255)", "rgb(0,0,0)" );
 	Write_SVG_text( os, szString , plot_width - bar_margin - bar_width + 0.25*font_size , 
 		plot_height + top_margin - bar_margin - bar_height - 0.25*font_size , 
-		font_size , PhysiCell_SVG_options.font_color.c_str() , PhysiCell_SVG_options.font.c_str() ); 
+		font_size , S.options.font_color.c_str() , S.options.font.c_str() ); 
 	
 	delete [] szString; 
 
 	// plot runtime 
 	szString = new char [1024]; 
-	RUNTIME_TOC(); 
-	std::string formatted_stopwatch_value = format_stopwatch_value( runtime_stopwatch_value() );
-	Write_SVG_text( os, formatted_stopwatch_value.c_str() , bar_margin , top_margin + plot_height - bar_margin , 0.75 * font_size , 
-		PhysiCell_SVG_options.font_color.c_str() , PhysiCell_SVG_options.font.c_str() );
+	Write_SVG_text( os, S.runtime.c_str() , bar_margin , top_margin + plot_height - bar_margin , 0.75 * font_size , 
+		S.options.font_color.c_str() , S.options.font.c_str() );
 	delete [] szString; 
 
 	// draw a box around the plot window
@@ -598,7 +653,7 @@ void SVG_plot( std::string filename , Microenvironment& M, double z_slice , doub
 	Write_SVG_end( os ); 
 	os.close();
  
-	return; 
+	return true; 
 }
 
 };
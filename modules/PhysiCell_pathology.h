@@ -96,6 +96,40 @@ struct PhysiCell_SVG_options_struct {
 
 extern PhysiCell_SVG_options_struct PhysiCell_SVG_options;
 
+// what SVG_plot draws, copied out of the cells so that the file can be 
+// written later, e.g. by the background writer (see Background_Writer) 
+
+class SVG_Snapshot_Cell
+{
+ private:
+ public:
+	int ID; 
+	double x; 
+	double y; 
+	double z_distance; // from the slice 
+	double radius; 
+	double nuclear_radius; 
+	std::vector<std::string> colors; // from the coloring function 
+}; 
+
+class SVG_Snapshot
+{
+ private:
+ public:
+	PhysiCell_SVG_options_struct options; 
+	double z_slice; 
+	double time; 
+	int total_cell_count; 
+	std::vector<double> bounding_box; 
+	double dx; 
+	double dy; 
+	std::string runtime; // formatted wall time at capture 
+	std::vector<SVG_Snapshot_Cell> cells; // the cells that intersect the slice 
+	
+	SVG_Snapshot(); 
+	void capture( Microenvironment& M, double z_slice , double time, std::vector<std::string> (*cell_coloring_function)(Cell*) ); 
+}; 
+
 // done 
 std::vector<double> transmission( std::vector<double>& incoming_light, std::vector<double>& absorb_color, double thickness , double stain );
 
@@ -116,6 +150,7 @@ std::vector<std::string> hematoxylin_and_eosin_stroma_coloring( double& ECM_frac
 std::string formatted_minutes_to_DDHHMM( double minutes ); 
 
 void SVG_plot( std::string filename , Microenvironment& M, double z_slice , double time, std::vector<std::string> (*cell_coloring_function)(Cell*) ); // done
+bool SVG_plot( std::string filename , SVG_Snapshot& snapshot ); // false if the file can't be opened 
 
 void SVG_plot_with_stroma( std::string filename , Microenvironment& M, double z_slice , double time, std::vector<std::string> (*cell_coloring_function)(Cell*) , 
 	int ECM_index, std::vector<std::string> (*ECM_coloring_function)(double) ); // planned
@@ -123,11 +123,21 @@ PhysiCell_Settings::PhysiCell_Settings()
 
 	full_save_interval = 60;  
 	enable_full_saves = true; 
+	full_save_format = "MultiCellDS"; 
+	full_save_keyframe_interval = 1; 
 	enable_legacy_saves = false; 
 	
 	SVG_save_interval = 60; 
 	enable_SVG_saves = true; 
 	
+	enable_background_writer = false; 
+	
+	enable_profiling = false; 
+	
+	enable_checkpoints = false; 
+	checkpoint_interval = 1440; 
+	restart_from = ""; 
+	
 	// parallel options 
 	
 	omp_num_threads = 4; 
@@ -158,6 +168,12 @@ void PhysiCell_Settings::read_from_pugixml( void )
 	node = xml_find_node( node , "full_data" ); 
 	full_save_interval = xml_get_double_value( node , "interval" );
 	enable_full_saves = xml_get_bool_value( node , "enable" ); 
+	// optional: <format>columnar</format> or <format>compressed</format> 
+	if( xml_find_node( node , "format" ) )
+	{ full_save_format = xml_get_string_value( node , "format" ); }
+	// optional: <keyframe_interval>10</keyframe_interval> (compressed saves) 
+	if( xml_find_node( node , "keyframe_interval" ) )
+	{ full_save_keyframe_interval = xml_get_int_value( node , "keyframe_interval" ); }
 	node = node.parent(); 
 	
 	node = xml_find_node( node , "SVG" ); 
@@ -168,6 +184,32 @@ void PhysiCell_Settings::read_from_pugixml( void )
 	node = xml_find_node( node , "legacy_data" ); 
 	enable_legacy_saves = xml_get_bool_value( node , "enable" );
 	node = node.parent(); 
+	
+	// optional: <background_writer><enable>true</enable></background_writer> 
+	if( xml_find_node( node , "background_writer" ) )
+	{
+		node = xml_find_node( node , "background_writer" ); 
+		enable_background_writer = xml_get_bool_value( node , "enable" ); 
+		node = node.parent(); 
+	}
+	
+	// optional: <profile><enable>true</enable></profile> 
+	node = xml_find_node( node , "profile" ); 
+	enable_profiling = xml_get_bool_value( node , "enable" );
+	node = node.parent(); 
+	
+	// optional: <checkpoint><enable>true</enable><interval>1440</interval>
+	//   <restart_from>output/checkpoint00000002.bin</restart_from></checkpoint> 
+	node = xml_find_node( physicell_config_root , "save" ); 
+	if( xml_find_node( node , "checkpoint" ) )
+	{
+		node = xml_find_node( node , "checkpoint" ); 
+		enable_checkpoints = xml_get_bool_value( node , "enable" ); 
+		checkpoint_interval = xml_get_double_value( node , "interval" ); 
+		if( xml_find_node( node , "restart_from" ) )
+		{ restart_from = xml_get_string_value( node , "restart_from" ); }
+		node = node.parent(); 
+	}
 
 	// parallel options 
 
@@ -547,6 +589,7 @@ bool setup_microenvironment_from_XML( pugi::xml_node root_node )
 	std::vector<double> initial_condition_vector = {}; 
 	std::vector<double> Dirichlet_condition_vector = {}; 
 	std::vector<bool> Dirichlet_activation_vector = {}; 
+	std::vector<bool> gradient_activation_vector = {}; 
 
 	// next, add all the substrates to the microenvironment
 	// build the initial conditions and Dirichlet conditions as we go 
@@ -591,6 +634,13 @@ bool setup_microenvironment_from_XML( pugi::xml_node root_node )
 		if( node1.attribute("enabled").as_bool() )
 		{ activated_Dirichlet_boundary_detected = true; } 
 		
+		// gradients are computed unless <calculate_gradient> is false 
+		node1 = node.child( "calculate_gradient" ); 
+		if( node1 )
+		{ gradient_activation_vector.push_back( xml_get_my_bool_value(node1) ); }
+		else
+		{ gradient_activation_vector.push_back( true ); }
+		
 		// move on to the next variable (if any!)
 		node = node.next_sibling( "variable" ); 
 		i++; 
@@ -601,6 +651,7 @@ bool setup_microenvironment_from_XML( pugi::xml_node root_node )
 
 	default_microenvironment_options.Dirichlet_condition_vector = Dirichlet_condition_vector;  
 	default_microenvironment_options.Dirichlet_activation_vector = Dirichlet_activation_vector;
+	default_microenvironment_options.gradient_activation_vector = gradient_activation_vector;
 	default_microenvironment_options.initial_condition_vector = initial_condition_vector; 
 	
 	// because outer boundary Dirichlet conditions are defined in the XML, 
@@ -620,8 +671,46 @@ bool setup_microenvironment_from_XML( pugi::xml_node root_node )
 	node = xml_find_node( root_node , "microenvironment_setup" );
 	node = xml_find_node( node , "options" ); 
 	
-	// calculate gradients? 
-	default_microenvironment_options.calculate_gradients = xml_get_bool_value( node, "calculate_gradients" ); 
+	// calculate gradients? (no longer used: gradients are computed on demand) 
+	if( node.child( "calculate_gradients" ) )
+	{
+		default_microenvironment_options.calculate_gradients = xml_get_bool_value( node, "calculate_gradients" ); 
+		std::cout << std::endl 
+				  << "Warning: calculate_gradients is deprecated and has no effect. Gradients are" << std::endl 
+				  << "         computed on demand, the first time each voxel is queried after the" << std::endl 
+				  << "         densities change. You can remove it from microenvironment_setup/options." << std::endl << std::endl; 
+	}
+	
+	// apply the sources and sinks inside the diffusion solver? 
+	if( node.child( "fuse_sources_and_sinks" ) )
+	{ default_microenvironment_options.fuse_sources_and_sinks = xml_get_bool_value( node, "fuse_sources_and_sinks" ); }
+	
+	// let the diffusion coefficients and decay rates vary in space?
+	if( node.child( "variable_coefficients" ) )
+	{ default_microenvironment_options.variable_coefficients = xml_get_bool_value( node, "variable_coefficients" ); }
+	
+	// jump to the steady state every update_interval instead? 
+	pugi::xml_node node_quasi_steady = node.child( "quasi_steady_state_solver" ); 
+	if( node_quasi_steady )
+	{
+		default_microenvironment_options.quasi_steady_state_solver = node_quasi_steady.attribute("enabled").as_bool(); 
+		if( node_quasi_steady.child( "update_interval" ) )
+		{
+			default_microenvironment_options.quasi_steady_state_interval = 
+				xml_get_double_value( node_quasi_steady , "update_interval" ); 
+		}
+	}
+	
+	// resolve only the neighborhood of the cells? 
+	pugi::xml_node node_amr = node.child( "adaptive_mesh_refinement" ); 
+	if( node_amr )
+	{
+		default_microenvironment_options.adaptive_mesh_refinement = node_amr.attribute("enabled").as_bool(); 
+		if( node_amr.child( "refinement_ratio" ) )
+		{ default_microenvironment_options.amr_refinement_ratio = xml_get_int_value( node_amr , "refinement_ratio" ); }
+		if( node_amr.child( "buffer_distance" ) )
+		{ default_microenvironment_options.amr_buffer_distance = xml_get_double_value( node_amr , "buffer_distance" ); }
+	}
 	
 	// track internalized substrates in each agent? 
 	default_microenvironment_options.track_internalized_substrates_in_each_agent 
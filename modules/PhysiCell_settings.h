@@ -107,11 +107,21 @@ class PhysiCell_Settings
 
 	double full_save_interval = 60;  
 	bool enable_full_saves = true; 
+	std::string full_save_format = "MultiCellDS"; // or "columnar" (see Columnar_Snapshot) or "compressed" (see Snapshot_Stream) 
+	int full_save_keyframe_interval = 1; // compressed saves: a keyframe every N saves, deltas in between 
 	bool enable_legacy_saves = false; 
 	
 	double SVG_save_interval = 60; 
 	bool enable_SVG_saves = true; 
 	
+	bool enable_background_writer = false; // write columnar or compressed full saves and SVGs from a separate thread 
+	
+	bool enable_profiling = false; // per-phase timings (see Phase_Profiler) 
+	
+	bool enable_checkpoints = false; // complete restartable state (see save_PhysiCell_checkpoint) 
+	double checkpoint_interval = 1440; 
+	std::string restart_from = ""; // a checkpoint file to resume (or fork) from, instead of setup_tissue() 
+	
 	PhysiCell_Settings();
 	
 	void read_from_pugixml( void ); 
@@ -126,6 +136,8 @@ class PhysiCell_Globals
 	double next_SVG_save_time = 0.0; 
 	int full_output_index = 0; 
 	int SVG_output_index = 0; 
+	double next_checkpoint_time = 0.0; 
+	int checkpoint_index = 0; 
 };
 
 template <class T> 
@@ -0,0 +1,1532 @@
+/*
+###############################################################################
+# If you use PhysiCell in your project, please cite PhysiCell and the version #
+# number, such as below:                                                      #
+#                                                                             #
+# We implemented and solved the model using PhysiCell (Version x.y.z) [1].    #
+#                                                                             #
+# [1] A Ghaffarizadeh, R Heiland, SH Friedman, SM Mumenthaler, and P Macklin, #
+#     PhysiCell: an Open Source Physics-Based Cell Simulator for Multicellu-  #
+#     lar Systems, PLoS Comput. Biol. 14(2): e1005991, 2018                   #
+#     DOI: 10.1371/journal.pcbi.1005991                                       #
+#                                                                             #
+# See VERSION.txt or call get_PhysiCell_version() to get the current version  #
+#     x.y.z. Call display_citations() to get detailed information on all cite-#
+#     able software used in your PhysiCell application.                       #
+#                                                                             #
+# Because PhysiCell extensively uses BioFVM, we suggest you also cite BioFVM  #
+#     as below:                                                               #
+#                                                                             #
+# We implemented and solved the model using PhysiCell (Version x.y.z) [1],    #
+# with BioFVM [2] to solve the transport equations.                           #
+#                                                                             #
+# [1] A Ghaffarizadeh, R Heiland, SH Friedman, SM Mumenthaler, and P Macklin, #
+#     PhysiCell: an Open Source Physics-Based Cell Simulator for Multicellu-  #
+#     lar Systems, PLoS Comput. Biol. 14(2): e1005991, 2018                   #
+#     DOI: 10.1371/journal.pcbi.1005991                                       #
+#                                                                             #
+# [2] A Ghaffarizadeh, SH Friedman, and P Macklin, BioFVM: an efficient para- #
+#     llelized diffusive transport solver for 3-D biological simulations,     #
+#     Bioinformatics 32(8): 1256-8, 2016. DOI: 10.1093/bioinformatics/btv730  #
+#                                                                             #
+###############################################################################
+#                                                                             #
+# BSD 3-Clause License (see https://opensource.org/licenses/BSD-3-Clause)     #
+#                                                                             #
+# Copyright (c) 2015-2018, Paul Macklin and the PhysiCell Project             #
+# All rights reserved.                                                        #
+#                                                                             #
+# Redistribution and use in source and binary forms, with or without          #
+# modification, are permitted provided that the following conditions are met: #
+#                                                                             #
+# 1. Redistributions of source code must retain the above copyright notice,   #
+# this list of conditions and the following disclaimer.                       #
+#                                                                             #
+# 2. Redistributions in binary form must reproduce the above copyright        #
+# notice, this list of conditions and the following disclaimer in the         #
+# documentation and/or other materials provided with the distribution.        #
+#                                                                             #
+# 3. Neither the name of the copyright holder nor the names of its            #
+# contributors may be used to endorse or promote products derived from this   #
+# software without specific prior written permission.                         #
+#                                                                             #
+# THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" #
+# AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE   #
+# IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE  #
+# ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE   #
+# LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR         #
+# CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF        #
+# SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS    #
+# INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN     #
+# CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)     #
+# ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE  #
+# POSSIBILITY OF SUCH DAMAGE.                                                 #
+#                                                                             #
+###############################################################################
+*/
+ 
+#include "./PhysiCell_snapshot.h"
+
+#include <cstring>
+#include <chrono>
+
+#include "./PhysiCell_MultiCellDS.h"
+#include "./PhysiCell_compression.h"
+#include "./PhysiCell_settings.h"
+
+namespace PhysiCell{
+
+Snapshot_Column::Snapshot_Column()
+{
+	name = "unnamed"; 
+	units = "none"; 
+	type = PhysiCell_snapshot_float64; 
+	components = 1; 
+	return; 
+}
+
+void Snapshot_Column::resize( long rows )
+{
+	if( type == PhysiCell_snapshot_int32 )
+	{
+		integers.resize( rows * components ); 
+		values.clear(); 
+	}
+	else
+	{
+		values.resize( rows * components ); 
+		integers.clear(); 
+	}
+	return; 
+}
+
+size_t Snapshot_Column::bytes( void )
+{
+	if( type == PhysiCell_snapshot_int32 )
+	{ return integers.size() * sizeof(int); }
+	return values.size() * sizeof(double); 
+}
+
+void* Snapshot_Column::data( void )
+{
+	if( type == PhysiCell_snapshot_int32 )
+	{ return (void*) integers.data(); }
+	return (void*) values.data(); 
+}
+
+Snapshot_Table::Snapshot_Table()
+{
+	name = "unnamed"; 
+	number_of_rows = 0; 
+	return; 
+}
+
+Snapshot_Column& Snapshot_Table::set_column( int i , std::string name , std::string units , int type , int components )
+{
+	if( (int) columns.size() <= i )
+	{ columns.resize( i+1 ); }
+	columns[i].name = name; 
+	columns[i].units = units; 
+	columns[i].type = type; 
+	columns[i].components = components; 
+	columns[i].resize( number_of_rows ); 
+	return columns[i]; 
+}
+
+int Snapshot_Table::find_column( std::string name )
+{
+	for( unsigned int i=0; i < columns.size(); i++ )
+	{
+		if( columns[i].name == name )
+		{ return i; }
+	}
+	return -1; 
+}
+
+void Snapshot_Table::resize( long rows )
+{
+	number_of_rows = rows; 
+	for( unsigned int i=0; i < columns.size(); i++ )
+	{ columns[i].resize( rows ); }
+	return; 
+}
+
+Columnar_Snapshot::Columnar_Snapshot()
+{
+	current_time = 0.0; 
+	return; 
+}
+
+Snapshot_Table& Columnar_Snapshot::table( std::string name )
+{
+	int n = find_table( name ); 
+	if( n > -1 )
+	{ return tables[n]; }
+	
+	tables.resize( tables.size() + 1 ); 
+	tables.back().name = name; 
+	return tables.back(); 
+}
+
+int Columnar_Snapshot::find_table( std::string name )
+{
+	for( unsigned int i=0; i < tables.size(); i++ )
+	{
+		if( tables[i].name == name )
+		{ return i; }
+	}
+	return -1; 
+}
+
+void Columnar_Snapshot::capture( Microenvironment& M , double current_simulation_time )
+{
+	current_time = current_simulation_time; 
+	
+	std::string volume_units = M.spatial_units + "^3"; 
+	std::string speed_units = M.spatial_units + "/" + M.time_units; 
+	
+	// cells: the same fields as the custom matlab cell data, and like it, 
+	// the custom data layout of the first cell 
+	
+	Snapshot_Table& cells = table( "cells" ); 
+	long number_of_cells = (*all_cells).size(); 
+	cells.number_of_rows = number_of_cells; 
+	
+	int n = 0; 
+	cells.set_column( n++ , "ID" , "none" , PhysiCell_snapshot_int32 , 1 ); 
+	cells.set_column( n++ , "position" , M.spatial_units , PhysiCell_snapshot_float64 , 3 ); 
+	cells.set_column( n++ , "total_volume" , volume_units , PhysiCell_snapshot_float64 , 1 ); 
+	cells.set_column( n++ , "cell_type" , "none" , PhysiCell_snapshot_int32 , 1 ); 
+	cells.set_column( n++ , "cycle_model" , "none" , PhysiCell_snapshot_int32 , 1 ); 
+	cells.set_column( n++ , "current_phase" , "none" , PhysiCell_snapshot_int32 , 1 ); 
+	cells.set_column( n++ , "elapsed_time_in_phase" , M.time_units , PhysiCell_snapshot_float64 , 1 ); 
+	cells.set_column( n++ , "nuclear_volume" , volume_units , PhysiCell_snapshot_float64 , 1 ); 
+	cells.set_column( n++ , "cytoplasmic_volume" , volume_units , PhysiCell_snapshot_float64 , 1 ); 
+	cells.set_column( n++ , "fluid_fraction" , "none" , PhysiCell_snapshot_float64 , 1 ); 
+	cells.set_column( n++ , "calcified_fraction" , "none" , PhysiCell_snapshot_float64 , 1 ); 
+	cells.set_column( n++ , "orientation" , "none" , PhysiCell_snapshot_float64 , 3 ); 
+	cells.set_column( n++ , "polarity" , "none" , PhysiCell_snapshot_float64 , 1 ); 
+	cells.set_column( n++ , "migration_speed" , speed_units , PhysiCell_snapshot_float64 , 1 ); 
+	cells.set_column( n++ , "motility_vector" , speed_units , PhysiCell_snapshot_float64 , 3 ); 
+	cells.set_column( n++ , "migration_bias" , "none" , PhysiCell_snapshot_float64 , 1 ); 
+	cells.set_column( n++ , "motility_bias_direction" , "none" , PhysiCell_snapshot_float64 , 3 ); 
+	cells.set_column( n++ , "persistence_time" , M.time_units , PhysiCell_snapshot_float64 , 1 ); 
+	
+	int number_of_custom_variables = 0; 
+	int number_of_custom_vectors = 0; 
+	if( number_of_cells > 0 )
+	{
+		Custom_Cell_Data& custom = (*all_cells)[0]->custom_data; 
+		number_of_custom_variables = custom.variables.size(); 
+		number_of_custom_vectors = custom.vector_variables.size(); 
+		for( int j=0; j < number_of_custom_variables; j++ )
+		{
+			cells.set_column( n++ , custom.variables[j].name , custom.variables[j].units , 
+				PhysiCell_snapshot_float64 , 1 ); 
+		}
+		for( int j=0; j < number_of_custom_vectors; j++ )
+		{
+			cells.set_column( n++ , custom.vector_variables[j].name , custom.vector_variables[j].units , 
+				PhysiCell_snapshot_float64 , custom.vector_variables[j].value.size() ); 
+		}
+	}
+	cells.columns.resize( n ); 
+	
+	std::vector<Snapshot_Column>& C = cells.columns; 
+	int first_custom = n - number_of_custom_variables - number_of_custom_vectors; 
+	
+	#pragma omp parallel for 
+	for( long i=0; i < number_of_cells; i++ )
+	{
+		Cell* pCell = (*all_cells)[i]; 
+		Phenotype& phenotype = pCell->phenotype; 
+		
+		C[0].integers[i] = pCell->ID; 
+		for( int k=0; k < 3; k++ )
+		{ C[1].values[3*i+k] = pCell->position[k]; }
+		C[2].values[i] = phenotype.volume.total; 
+		
+		C[3].integers[i] = pCell->type; 
+		C[4].integers[i] = -1; 
+		C[5].integers[i] = -1; 
+		C[6].values[i] = phenotype.cycle.data.elapsed_time_in_phase; 
+		if( phenotype.cycle.pCycle_Model )
+		{
+			C[4].integers[i] = phenotype.cycle.model().code; 
+			C[5].integers[i] = phenotype.cycle.current_phase().code; 
+		}
+		
+		C[7].values[i] = phenotype.volume.nuclear; 
+		C[8].values[i] = phenotype.volume.cytoplasmic; 
+		C[9].values[i] = phenotype.volume.fluid_fraction; 
+		C[10].values[i] = phenotype.volume.calcified_fraction; 
+		
+		for( int k=0; k < 3; k++ )
+		{ C[11].values[3*i+k] = pCell->state.orientation[k]; }
+		C[12].values[i] = phenotype.geometry.polarity; 
+		
+		C[13].values[i] = phenotype.motility.migration_speed; 
+		for( int k=0; k < 3; k++ )
+		{ C[14].values[3*i+k] = phenotype.motility.motility_vector[k]; }
+		C[15].values[i] = phenotype.motility.migration_bias; 
+		for( int k=0; k < 3; k++ )
+		{ C[16].values[3*i+k] = phenotype.motility.migration_bias_direction[k]; }
+		C[17].values[i] = phenotype.motility.persistence_time; 
+		
+		// custom data (zero where a cell has less than the first cell) 
+		
+		Custom_Cell_Data& custom = pCell->custom_data; 
+		int c = first_custom; 
+		for( int j=0; j < number_of_custom_variables; j++ , c++ )
+		{
+			C[c].values[i] = 0.0; 
+			if( j < (int) custom.variables.size() )
+			{ C[c].values[i] = custom.variables[j].value; }
+		}
+		for( int j=0; j < number_of_custom_vectors; j++ , c++ )
+		{
+			int size = C[c].components; 
+			for( int k=0; k < size; k++ )
+			{
+				C[c].values[size*i+k] = 0.0; 
+				if( j < (int) custom.vector_variables.size() && k < (int) custom.vector_variables[j].value.size() )
+				{ C[c].values[size*i+k] = custom.vector_variables[j].value[k]; }
+			}
+		}
+	}
+	
+	// microenvironment: voxel centers and volumes, then one column per substrate 
+	
+	Snapshot_Table& densities = table( "microenvironment" ); 
+	long number_of_voxels = M.number_of_voxels(); 
+	int number_of_densities = M.number_of_densities(); 
+	densities.number_of_rows = number_of_voxels; 
+	
+	densities.set_column( 0 , "position" , M.spatial_units , PhysiCell_snapshot_float64 , 3 ); 
+	densities.set_column( 1 , "volume" , volume_units , PhysiCell_snapshot_float64 , 1 ); 
+	for( int j=0; j < number_of_densities; j++ )
+	{ densities.set_column( 2+j , M.density_names[j] , M.density_units[j] , PhysiCell_snapshot_float64 , 1 ); }
+	densities.columns.resize( 2 + number_of_densities ); 
+	
+	std::vector<Snapshot_Column>& D = densities.columns; 
+	
+	#pragma omp parallel for 
+	for( long i=0; i < number_of_voxels; i++ )
+	{
+		for( int k=0; k < 3; k++ )
+		{ D[0].values[3*i+k] = M.mesh.voxels[i].center[k]; }
+		D[1].values[i] = M.mesh.voxels[i].volume; 
+		
+		std::vector<double>& density = M.density_vector(i); 
+		for( int j=0; j < number_of_densities; j++ )
+		{ D[2+j].values[i] = density[j]; }
+	}
+	
+	return; 
+}
+
+// header serialization 
+
+static void snapshot_append( std::vector<char>& buffer , const void* data , size_t bytes )
+{
+	const char* p = (const char*) data; 
+	buffer.insert( buffer.end() , p , p + bytes ); 
+	return; 
+}
+
+static void snapshot_append_uint32( std::vector<char>& buffer , unsigned int value )
+{
+	snapshot_append( buffer , &value , 4 ); 
+	return; 
+}
+
+static void snapshot_append_uint64( std::vector<char>& buffer , unsigned long long value )
+{
+	snapshot_append( buffer , &value , 8 ); 
+	return; 
+}
+
+static void snapshot_append_string( std::vector<char>& buffer , const std::string& value )
+{
+	snapshot_append_uint32( buffer , value.size() ); 
+	snapshot_append( buffer , value.c_str() , value.size() ); 
+	return; 
+}
+
+static const char PhysiCell_snapshot_magic [9] = "PCSNAP01"; 
+static const unsigned int PhysiCell_snapshot_endian_marker = 0x01020304; 
+static const unsigned int PhysiCell_snapshot_version = 1; 
+
+static size_t snapshot_align( size_t offset )
+{ return ( offset + 7 ) & ~( (size_t) 7 ); }
+
+static void snapshot_header( Columnar_Snapshot& S , std::vector<unsigned long long>& offsets , std::vector<char>& buffer )
+{
+	buffer.clear(); 
+	snapshot_append( buffer , PhysiCell_snapshot_magic , 8 ); 
+	snapshot_append_uint32( buffer , PhysiCell_snapshot_endian_marker ); 
+	snapshot_append_uint32( buffer , PhysiCell_snapshot_version ); 
+	snapshot_append( buffer , &(S.current_time) , 8 ); 
+	snapshot_append_uint32( buffer , S.tables.size() ); 
+	
+	int n = 0; 
+	for( unsigned int t=0; t < S.tables.size(); t++ )
+	{
+		Snapshot_Table& T = S.tables[t]; 
+		snapshot_append_string( buffer , T.name ); 
+		snapshot_append_uint64( buffer , T.number_of_rows ); 
+		snapshot_append_uint32( buffer , T.columns.size() ); 
+		for( unsigned int c=0; c < T.columns.size(); c++ )
+		{
+			snapshot_append_string( buffer , T.columns[c].name ); 
+			snapshot_append_string( buffer , T.columns[c].units ); 
+			snapshot_append_uint32( buffer , T.columns[c].type ); 
+			snapshot_append_uint32( buffer , T.columns[c].components ); 
+			snapshot_append_uint64( buffer , offsets[n] ); 
+			snapshot_append_uint64( buffer , T.columns[c].bytes() ); 
+			n++; 
+		}
+	}
+	return; 
+}
+
+void Columnar_Snapshot::layout( std::vector<char>& header , std::vector<unsigned long long>& offsets )
+{
+	// the header size does not depend on the offsets, so lay it out once 
+	// to place the columns, then again with their offsets 
+	
+	int number_of_columns = 0; 
+	for( unsigned int t=0; t < tables.size(); t++ )
+	{ number_of_columns += tables[t].columns.size(); }
+	offsets.assign( number_of_columns , 0 ); 
+	
+	snapshot_header( *this , offsets , header ); 
+	
+	size_t offset = snapshot_align( header.size() ); 
+	int n = 0; 
+	for( unsigned int t=0; t < tables.size(); t++ )
+	{
+		for( unsigned int c=0; c < tables[t].columns.size(); c++ )
+		{
+			offsets[n] = offset; 
+			offset = snapshot_align( offset + tables[t].columns[c].bytes() ); 
+			n++; 
+		}
+	}
+	snapshot_header( *this , offsets , header ); 
+	return; 
+}
+
+bool Columnar_Snapshot::write( std::string filename )
+{
+	std::vector<char> header; 
+	std::vector<unsigned long long> offsets; 
+	layout( header , offsets ); 
+	
+	FILE* fp = fopen( filename.c_str() , "wb" ); 
+	if( fp == NULL )
+	{
+		std::cout << "Error: Failed to open " << filename << " for snapshot writing." << std::endl; 
+		return false; 
+	}
+	
+	// one write for the header, one per column 
+	
+	static const char padding [8] = {0,0,0,0,0,0,0,0}; 
+	bool success = ( fwrite( header.data() , 1 , header.size() , fp ) == header.size() ); 
+	size_t offset = header.size(); 
+	int n = 0; 
+	for( unsigned int t=0; t < tables.size(); t++ )
+	{
+		for( unsigned int c=0; c < tables[t].columns.size(); c++ )
+		{
+			size_t pad = offsets[n] - offset; 
+			if( pad > 0 )
+			{ success = success && ( fwrite( padding , 1 , pad , fp ) == pad ); }
+			
+			size_t bytes = tables[t].columns[c].bytes(); 
+			success = success && ( fwrite( tables[t].columns[c].data() , 1 , bytes , fp ) == bytes ); 
+			offset = offsets[n] + bytes; 
+			n++; 
+		}
+	}
+	
+	success = ( fclose( fp ) == 0 ) && success; 
+	if( !success )
+	{ std::cout << "Error: Failed to write " << filename << std::endl; }
+	return success; 
+}
+
+// header parsing 
+
+class Snapshot_Cursor
+{
+ private:
+ public:
+	const char* data; 
+	size_t size; 
+	size_t position; 
+
+	bool read( void* value , size_t bytes )
+	{
+		if( bytes > size - position )
+		{ return false; }
+		memcpy( value , data + position , bytes ); 
+		position += bytes; 
+		return true; 
+	}
+	bool read_string( std::string& value )
+	{
+		unsigned int length = 0; 
+		if( !read( &length , 4 ) || length > 65536 || length > size - position )
+		{ return false; }
+		value.assign( data + position , length ); 
+		position += length; 
+		return true; 
+	}
+}; 
+
+bool Columnar_Snapshot::read_image( const char* image , size_t bytes )
+{
+	Snapshot_Cursor cursor; 
+	cursor.data = image; 
+	cursor.size = bytes; 
+	cursor.position = 0; 
+	
+	char magic [8]; 
+	unsigned int marker = 0; 
+	unsigned int version = 0; 
+	unsigned int number_of_tables = 0; 
+	bool success = cursor.read( magic , 8 ) && memcmp( magic , PhysiCell_snapshot_magic , 8 ) == 0 
+		&& cursor.read( &marker , 4 ) && marker == PhysiCell_snapshot_endian_marker 
+		&& cursor.read( &version , 4 ) && version == PhysiCell_snapshot_version 
+		&& cursor.read( &current_time , 8 ) 
+		&& cursor.read( &number_of_tables , 4 ); 
+	
+	std::vector<unsigned long long> offsets; 
+	std::vector<unsigned long long> sizes; 
+	if( success )
+	{ tables.resize( number_of_tables ); }
+	for( unsigned int t=0; success && t < tables.size(); t++ )
+	{
+		Snapshot_Table& T = tables[t]; 
+		unsigned long long rows = 0; 
+		unsigned int number_of_columns = 0; 
+		success = cursor.read_string( T.name ) && cursor.read( &rows , 8 ) 
+			&& cursor.read( &number_of_columns , 4 ); 
+		T.number_of_rows = rows; 
+		if( success )
+		{ T.columns.resize( number_of_columns ); }
+		for( unsigned int c=0; success && c < T.columns.size(); c++ )
+		{
+			Snapshot_Column& C = T.columns[c]; 
+			unsigned int type = 0; 
+			unsigned int components = 0; 
+			unsigned long long offset = 0; 
+			unsigned long long size = 0; 
+			success = cursor.read_string( C.name ) && cursor.read_string( C.units ) 
+				&& cursor.read( &type , 4 ) && cursor.read( &components , 4 ) 
+				&& cursor.read( &offset , 8 ) && cursor.read( &size , 8 ); 
+			C.type = type; 
+			C.components = components; 
+			offsets.push_back( offset ); 
+			sizes.push_back( size ); 
+		}
+	}
+	
+	// the columns 
+	
+	int n = 0; 
+	for( unsigned int t=0; success && t < tables.size(); t++ )
+	{
+		for( unsigned int c=0; success && c < tables[t].columns.size(); c++ )
+		{
+			Snapshot_Column& C = tables[t].columns[c]; 
+			success = ( C.type == PhysiCell_snapshot_int32 || C.type == PhysiCell_snapshot_float64 ) 
+				&& offsets[n] <= bytes && sizes[n] <= bytes - offsets[n]; 
+			if( success )
+			{
+				C.resize( tables[t].number_of_rows ); 
+				success = ( C.bytes() == sizes[n] ); 
+			}
+			if( success )
+			{ memcpy( C.data() , image + offsets[n] , sizes[n] ); }
+			n++; 
+		}
+	}
+	
+	if( !success )
+	{ tables.clear(); }
+	return success; 
+}
+
+bool Columnar_Snapshot::read( std::string filename )
+{
+	FILE* fp = fopen( filename.c_str() , "rb" ); 
+	if( fp == NULL )
+	{
+		std::cout << "Error: Failed to open " << filename << " for snapshot reading." << std::endl; 
+		return false; 
+	}
+	
+	std::vector<char> image; 
+	bool success = ( fseek( fp , 0 , SEEK_END ) == 0 ); 
+	long bytes = ftell( fp ); 
+	success = success && bytes >= 0 && fseek( fp , 0 , SEEK_SET ) == 0; 
+	if( success )
+	{
+		image.resize( bytes ); 
+		success = ( fread( image.data() , 1 , bytes , fp ) == (size_t) bytes ); 
+	}
+	fclose( fp ); 
+	
+	success = success && read_image( image.data() , image.size() ); 
+	if( !success )
+	{ std::cout << "Error: " << filename << " is not a valid PhysiCell snapshot." << std::endl; }
+	return success; 
+}
+
+void Columnar_Snapshot::display_information( std::ostream& os )
+{
+	os << "Columnar snapshot at t = " << current_time << std::endl; 
+	for( unsigned int t=0; t < tables.size(); t++ )
+	{
+		os << "   " << tables[t].name << ": " << tables[t].number_of_rows << " rows" << std::endl; 
+		for( unsigned int c=0; c < tables[t].columns.size(); c++ )
+		{
+			Snapshot_Column& C = tables[t].columns[c]; 
+			os << "      " << C.name << " [" << C.units << "] " 
+				<< ( C.type == PhysiCell_snapshot_int32 ? "int32" : "float64" ) 
+				<< " x " << C.components << std::endl; 
+		}
+	}
+	return; 
+}
+
+void save_PhysiCell_to_columnar_snapshot( std::string filename_base , Microenvironment& M , double current_simulation_time )
+{
+	// kept between saves, so that the columns are not reallocated 
+	static Columnar_Snapshot snapshot; 
+	
+	snapshot.capture( M , current_simulation_time ); 
+	
+	char filename [1024]; 
+	sprintf( filename , "%s_snapshot.bin" , filename_base.c_str() ); 
+	if( !snapshot.write( filename ) )
+	{
+		std::cout << std::endl << "Error: We're not writing data like we expect. " << std::endl
+		<< "Check to make sure your save directory exists. " << std::endl << std::endl
+		<< "I'm going to exit with a crash code of -1 now until " << std::endl 
+		<< "you fix your directory. Sorry!" << std::endl << std::endl; 
+		exit(-1); 
+	}
+	
+	return; 
+}
+
+// snapshot streams 
+
+static const char PhysiCell_stream_magic [9] = "PCSTRM01"; 
+static const char PhysiCell_stream_frame_magic [5] = "PCFR"; 
+static const unsigned int PhysiCell_stream_version = 2; 
+static const size_t PhysiCell_stream_chunk_bytes = 1 << 20; 
+static const unsigned int PhysiCell_stream_stored = 0; 
+static const unsigned int PhysiCell_stream_compressed = 1; 
+
+// deltas 
+
+// output = values ^ reference[ rows[i] ] row by row (values or the reference 
+// row taken as 0 if NULL or -1), for unsigned U of the element size; true if 
+// any of output is nonzero 
+template <class U>
+static bool snapshot_xor_rows( const void* values , const void* reference , const std::vector<long>& rows , int components , void* output )
+{
+	const char* v = (const char*) values; 
+	const char* r = (const char*) reference; 
+	char* o = (char*) output; 
+	bool changed = false; 
+	for( size_t i=0; i < rows.size(); i++ )
+	{
+		for( int k=0; k < components; k++ )
+		{
+			U a = 0; 
+			U b = 0; 
+			if( v != NULL )
+			{ memcpy( &a , v + ( i*components + k )*sizeof(U) , sizeof(U) ); }
+			if( rows[i] > -1 )
+			{ memcpy( &b , r + ( rows[i]*components + k )*sizeof(U) , sizeof(U) ); }
+			a ^= b; 
+			changed = changed || ( a != 0 ); 
+			memcpy( o + ( i*components + k )*sizeof(U) , &a , sizeof(U) ); 
+		}
+	}
+	return changed; 
+}
+
+static bool snapshot_xor_column( Snapshot_Column* values , Snapshot_Column& reference , const std::vector<long>& rows , Snapshot_Column& output )
+{
+	const void* v = ( values == NULL ? NULL : values->data() ); 
+	if( output.type == PhysiCell_snapshot_int32 )
+	{ return snapshot_xor_rows<unsigned int>( v , reference.data() , rows , output.components , output.data() ); }
+	return snapshot_xor_rows<unsigned long long>( v , reference.data() , rows , output.components , output.data() ); 
+}
+
+// tables whose first column is an int32 ID (the cells) are matched by ID, 
+// the others row by row 
+static bool snapshot_keyed_by_ID( Snapshot_Table& T )
+{
+	return T.columns.size() > 0 && T.columns[0].name == "ID" 
+		&& T.columns[0].type == PhysiCell_snapshot_int32 && T.columns[0].components == 1; 
+}
+
+// rows[i]: the row of previous that matches row i of current, or -1 (a birth) 
+static void snapshot_row_map( Snapshot_Table& previous , Snapshot_Table& current , bool by_ID , std::vector<long>& rows )
+{
+	rows.resize( current.number_of_rows ); 
+	if( by_ID == false )
+	{
+		for( size_t i=0; i < rows.size(); i++ )
+		{ rows[i] = ( (long) i < previous.number_of_rows ? (long) i : -1 ); }
+		return; 
+	}
+	
+	std::vector<int>& previous_IDs = previous.columns[0].integers; 
+	std::vector<int>& current_IDs = current.columns[0].integers; 
+	int max_ID = -1; 
+	for( size_t i=0; i < previous_IDs.size(); i++ )
+	{
+		if( previous_IDs[i] > max_ID )
+		{ max_ID = previous_IDs[i]; }
+	}
+	std::vector<long> index( max_ID + 1 , -1 ); 
+	for( size_t i=0; i < previous_IDs.size(); i++ )
+	{
+		if( previous_IDs[i] > -1 )
+		{ index[ previous_IDs[i] ] = i; }
+	}
+	for( size_t i=0; i < rows.size(); i++ )
+	{
+		int ID = current_IDs[i]; 
+		rows[i] = ( ID > -1 && ID <= max_ID ? index[ID] : -1 ); 
+	}
+	return; 
+}
+
+static bool snapshot_same_columns( Snapshot_Table& A , Snapshot_Table& B )
+{
+	if( A.columns.size() != B.columns.size() )
+	{ return false; }
+	for( unsigned int c=0; c < A.columns.size(); c++ )
+	{
+		if( A.columns[c].name != B.columns[c].name || A.columns[c].type != B.columns[c].type 
+			|| A.columns[c].components != B.columns[c].components )
+		{ return false; }
+	}
+	return true; 
+}
+
+bool make_snapshot_delta( Columnar_Snapshot& previous , Columnar_Snapshot& current , Columnar_Snapshot& delta )
+{
+	if( previous.tables.size() != current.tables.size() )
+	{ return false; }
+	
+	delta.current_time = current.current_time; 
+	delta.tables.resize( current.tables.size() ); 
+	std::vector<long> rows; 
+	std::vector<long> rows_in_order; 
+	for( unsigned int t=0; t < current.tables.size(); t++ )
+	{
+		Snapshot_Table& P = previous.tables[t]; 
+		Snapshot_Table& C = current.tables[t]; 
+		bool by_ID = snapshot_keyed_by_ID( C ); 
+		if( P.name != C.name || !snapshot_same_columns( P , C ) 
+			|| ( by_ID == false && P.number_of_rows != C.number_of_rows ) )
+		{ return false; }
+		
+		snapshot_row_map( P , C , by_ID , rows ); 
+		
+		Snapshot_Table& D = delta.tables[t]; 
+		D.name = C.name; 
+		D.number_of_rows = C.number_of_rows; 
+		int n = 0; 
+		for( unsigned int c=0; c < C.columns.size(); c++ )
+		{
+			Snapshot_Column& column = D.set_column( n , C.columns[c].name , C.columns[c].units , 
+				C.columns[c].type , C.columns[c].components ); 
+			
+			bool changed = false; 
+			if( by_ID && c == 0 )
+			{
+				// the IDs themselves, row by row: this also gives the order, 
+				// the births, and the deaths 
+				snapshot_row_map( P , C , false , rows_in_order ); 
+				changed = snapshot_xor_column( &(C.columns[c]) , P.columns[c] , rows_in_order , column ); 
+			}
+			else
+			{ changed = snapshot_xor_column( &(C.columns[c]) , P.columns[c] , rows , column ); }
+			
+			// unchanged columns are left out 
+			if( changed )
+			{ n++; }
+		}
+		D.columns.resize( n ); 
+	}
+	return true; 
+}
+
+// each column holds number_of_rows rows (one read from a damaged file may not) 
+static bool snapshot_columns_fit( Snapshot_Table& T )
+{
+	for( unsigned int c=0; c < T.columns.size(); c++ )
+	{
+		Snapshot_Column& column = T.columns[c]; 
+		size_t element_size = ( column.type == PhysiCell_snapshot_int32 ? sizeof(int) : sizeof(double) ); 
+		if( T.number_of_rows < 0 || column.components < 0 
+			|| column.bytes() != (size_t) T.number_of_rows * column.components * element_size )
+		{ return false; }
+	}
+	return true; 
+}
+
+bool apply_snapshot_delta( Columnar_Snapshot& previous , Columnar_Snapshot& delta , Columnar_Snapshot& current )
+{
+	if( previous.tables.size() != delta.tables.size() )
+	{ return false; }
+	
+	current.current_time = delta.current_time; 
+	current.tables.resize( delta.tables.size() ); 
+	std::vector<long> rows; 
+	for( unsigned int t=0; t < delta.tables.size(); t++ )
+	{
+		Snapshot_Table& P = previous.tables[t]; 
+		Snapshot_Table& D = delta.tables[t]; 
+		bool by_ID = snapshot_keyed_by_ID( P ); 
+		if( P.name != D.name || ( by_ID == false && P.number_of_rows != D.number_of_rows ) )
+		{ return false; }
+		if( !snapshot_columns_fit( P ) || !snapshot_columns_fit( D ) )
+		{ return false; }
+		
+		Snapshot_Table& C = current.tables[t]; 
+		C.name = P.name; 
+		C.number_of_rows = D.number_of_rows; 
+		C.columns.resize( P.columns.size() ); 
+		for( unsigned int c=0; c < P.columns.size(); c++ )
+		{ C.set_column( c , P.columns[c].name , P.columns[c].units , P.columns[c].type , P.columns[c].components ); }
+		
+		// each delta column must match its column 
+		std::vector<Snapshot_Column*> changes( P.columns.size() , (Snapshot_Column*) NULL ); 
+		for( unsigned int d=0; d < D.columns.size(); d++ )
+		{
+			int c = P.find_column( D.columns[d].name ); 
+			if( c < 0 || D.columns[d].type != P.columns[c].type || D.columns[d].components != P.columns[c].components )
+			{ return false; }
+			changes[c] = &(D.columns[d]); 
+		}
+		
+		int first = 0; 
+		if( by_ID )
+		{
+			snapshot_row_map( P , C , false , rows ); 
+			snapshot_xor_column( changes[0] , P.columns[0] , rows , C.columns[0] ); 
+			first = 1; 
+		}
+		snapshot_row_map( P , C , by_ID , rows ); 
+		for( unsigned int c=first; c < P.columns.size(); c++ )
+		{ snapshot_xor_column( changes[c] , P.columns[c] , rows , C.columns[c] ); }
+	}
+	return true; 
+}
+
+// streams 
+
+Snapshot_Stream_Frame::Snapshot_Stream_Frame()
+{
+	name = ""; 
+	time = 0.0; 
+	type = PhysiCell_stream_keyframe; 
+	image_bytes = 0; 
+	number_of_chunks = 0; 
+	payload_position = 0; 
+	payload_bytes = 0; 
+	return; 
+}
+
+// declared before the background writer, so that it is closed after the 
+// writer thread stops at exit 
+Snapshot_Stream PhysiCell_snapshot_stream; 
+
+Snapshot_Stream::Snapshot_Stream()
+{
+	fp = NULL; 
+	writing = false; 
+	filename = ""; 
+	keyframe_interval = 1; 
+	reference_frame = -1; 
+	frames_since_keyframe = 0; 
+	image_bytes = 0; 
+	stored_bytes = 0; 
+	return; 
+}
+
+Snapshot_Stream::~Snapshot_Stream()
+{
+	close(); 
+	return; 
+}
+
+void Snapshot_Stream::close( void )
+{
+	if( fp != NULL )
+	{ fclose( fp ); }
+	fp = NULL; 
+	writing = false; 
+	return; 
+}
+
+bool Snapshot_Stream::open_for_writing( std::string filename_in )
+{
+	close(); 
+	filename = filename_in; 
+	frames.clear(); 
+	reference_frame = -1; 
+	frames_since_keyframe = 0; 
+	image_bytes = 0; 
+	stored_bytes = 0; 
+	
+	fp = fopen( filename.c_str() , "wb" ); 
+	if( fp == NULL )
+	{
+		std::cout << "Error: Failed to open " << filename << " for snapshot stream writing." << std::endl; 
+		return false; 
+	}
+	writing = true; 
+	
+	std::vector<char> buffer; 
+	snapshot_append( buffer , PhysiCell_stream_magic , 8 ); 
+	snapshot_append_uint32( buffer , PhysiCell_snapshot_endian_marker ); 
+	snapshot_append_uint32( buffer , PhysiCell_stream_version ); 
+	bool success = ( fwrite( buffer.data() , 1 , buffer.size() , fp ) == buffer.size() ) && fflush( fp ) == 0; 
+	if( !success )
+	{
+		std::cout << "Error: Failed to write " << filename << std::endl; 
+		close(); 
+	}
+	return success; 
+}
+
+bool Snapshot_Stream::open_for_appending( std::string filename_in , double before_time )
+{
+	// a missing (or older) stream is started over 
+	char start [16]; 
+	unsigned int version = 0; 
+	FILE* fp_in = fopen( filename_in.c_str() , "rb" ); 
+	if( fp_in != NULL )
+	{
+		if( fread( start , 1 , 16 , fp_in ) == 16 )
+		{ memcpy( &version , start + 12 , 4 ); }
+		fclose( fp_in ); 
+	}
+	if( version != PhysiCell_stream_version || !open_for_reading( filename_in ) )
+	{ return open_for_writing( filename_in ); }
+	
+	unsigned int number_kept = 0; 
+	while( number_kept < frames.size() && frames[number_kept].time < before_time )
+	{ number_kept++; }
+	frames.resize( number_kept ); 
+	
+	// the next delta is from the last frame kept 
+	Columnar_Snapshot last; 
+	if( keyframe_interval > 1 && number_kept > 0 && !read_frame( number_kept-1 , last ) )
+	{
+		close(); 
+		return false; 
+	}
+	long long kept_bytes = 16; 
+	image_bytes = 0; 
+	frames_since_keyframe = 0; 
+	for( unsigned int n=0; n < number_kept; n++ )
+	{
+		kept_bytes = frames[n].payload_position + frames[n].payload_bytes; 
+		image_bytes += frames[n].image_bytes; 
+		frames_since_keyframe = ( frames[n].type == PhysiCell_stream_keyframe ? 0 : frames_since_keyframe + 1 ); 
+	}
+	stored_bytes = kept_bytes - 16; 
+	
+	// copy the frames kept to a new file, which then replaces the stream 
+	std::string temporary = filename + ".tmp"; 
+	FILE* fp_out = fopen( temporary.c_str() , "wb" ); 
+	bool success = ( fp_out != NULL ) && fseek( fp , 0 , SEEK_SET ) == 0; 
+	std::vector<char> buffer( 1 << 20 ); 
+	for( long long copied = 0; success && copied < kept_bytes; )
+	{
+		size_t bytes = buffer.size(); 
+		if( bytes > (size_t) ( kept_bytes - copied ) )
+		{ bytes = kept_bytes - copied; }
+		success = ( fread( buffer.data() , 1 , bytes , fp ) == bytes ) 
+			&& ( fwrite( buffer.data() , 1 , bytes , fp_out ) == bytes ); 
+		copied += bytes; 
+	}
+	if( fp_out != NULL )
+	{ success = ( fclose( fp_out ) == 0 ) && success; }
+	close(); 
+	success = success && rename( temporary.c_str() , filename.c_str() ) == 0; 
+	if( success )
+	{
+		fp = fopen( filename.c_str() , "ab" ); 
+		success = ( fp != NULL ); 
+	}
+	if( !success )
+	{
+		std::cout << "Error: Failed to continue the snapshot stream " << filename << std::endl; 
+		close(); 
+		return false; 
+	}
+	writing = true; 
+	
+	reference_frame = -1; 
+	if( keyframe_interval > 1 && number_kept > 0 )
+	{
+		reference = last; 
+		reference_frame = number_kept - 1; 
+	}
+	return true; 
+}
+
+void Snapshot_Stream::add_chunk( const unsigned char* data , size_t bytes , unsigned long long offset , int element_size )
+{
+	const unsigned char* input = data; 
+	if( element_size > 1 )
+	{
+		shuffled.resize( bytes ); 
+		shuffle_bytes( data , bytes , element_size , shuffled.data() ); 
+		input = shuffled.data(); 
+	}
+	compressed.clear(); 
+	compress_block( input , bytes , compressed ); 
+	
+	// incompressible chunks are stored as they are 
+	unsigned int method = PhysiCell_stream_compressed; 
+	if( compressed.size() >= bytes )
+	{
+		method = PhysiCell_stream_stored; 
+		element_size = 1; 
+		input = data; 
+	}
+	else
+	{ input = compressed.data(); }
+	size_t stored = ( method == PhysiCell_stream_compressed ? compressed.size() : bytes ); 
+	
+	unsigned int values [4] = { (unsigned int) bytes , (unsigned int) stored , (unsigned int) element_size , method }; 
+	const unsigned char* p = (const unsigned char*) &offset; 
+	payload.insert( payload.end() , p , p + 8 ); 
+	p = (const unsigned char*) values; 
+	payload.insert( payload.end() , p , p + 16 ); 
+	payload.insert( payload.end() , input , input + stored ); 
+	return; 
+}
+
+bool Snapshot_Stream::append( Columnar_Snapshot& S , std::string name )
+{
+	if( fp == NULL || writing == false )
+	{ return false; }
+	
+	// a keyframe every keyframe_interval frames, or when the tables change 
+	// in structure 
+	int type = PhysiCell_stream_keyframe; 
+	if( keyframe_interval > 1 && reference_frame > -1 && frames_since_keyframe + 1 < keyframe_interval 
+		&& make_snapshot_delta( reference , S , delta ) )
+	{ type = PhysiCell_stream_delta; }
+	Columnar_Snapshot& F = ( type == PhysiCell_stream_delta ? delta : S ); 
+	
+	F.layout( header , offsets ); 
+	
+	// the chunks: the header, then each column (padding is left out, and 
+	// restored as zeros by the reader) 
+	
+	payload.clear(); 
+	unsigned int number_of_chunks = 0; 
+	add_chunk( (const unsigned char*) header.data() , header.size() , 0 , 1 ); 
+	number_of_chunks++; 
+	
+	unsigned long long total_bytes = header.size(); 
+	int n = 0; 
+	for( unsigned int t=0; t < F.tables.size(); t++ )
+	{
+		for( unsigned int c=0; c < F.tables[t].columns.size(); c++ )
+		{
+			Snapshot_Column& C = F.tables[t].columns[c]; 
+			const unsigned char* data = (const unsigned char*) C.data(); 
+			size_t bytes = C.bytes(); 
+			int element_size = ( C.type == PhysiCell_snapshot_int32 ? 4 : 8 ); 
+			for( size_t start = 0; start < bytes; start += PhysiCell_stream_chunk_bytes )
+			{
+				size_t chunk_bytes = bytes - start; 
+				if( chunk_bytes > PhysiCell_stream_chunk_bytes )
+				{ chunk_bytes = PhysiCell_stream_chunk_bytes; }
+				add_chunk( data + start , chunk_bytes , offsets[n] + start , element_size ); 
+				number_of_chunks++; 
+			}
+			total_bytes = offsets[n] + bytes; 
+			n++; 
+		}
+	}
+	
+	std::vector<char> buffer; 
+	snapshot_append( buffer , PhysiCell_stream_frame_magic , 4 ); 
+	snapshot_append_string( buffer , name ); 
+	snapshot_append( buffer , &(S.current_time) , 8 ); 
+	snapshot_append_uint32( buffer , type ); 
+	snapshot_append_uint64( buffer , total_bytes ); 
+	snapshot_append_uint32( buffer , number_of_chunks ); 
+	snapshot_append_uint64( buffer , payload.size() ); 
+	
+	Snapshot_Stream_Frame frame; 
+	frame.name = name; 
+	frame.time = S.current_time; 
+	frame.type = type; 
+	frame.image_bytes = total_bytes; 
+	frame.number_of_chunks = number_of_chunks; 
+	frame.payload_position = ftell( fp ) + buffer.size(); 
+	frame.payload_bytes = payload.size(); 
+	
+	// flushed, so that the frames written so far survive a crash 
+	bool success = ( fwrite( buffer.data() , 1 , buffer.size() , fp ) == buffer.size() ) 
+		&& ( fwrite( payload.data() , 1 , payload.size() , fp ) == payload.size() ) 
+		&& fflush( fp ) == 0; 
+	if( !success )
+	{
+		std::cout << "Error: Failed to write " << filename << std::endl; 
+		return false; 
+	}
+	frames.push_back( frame ); 
+	image_bytes += total_bytes; 
+	stored_bytes += buffer.size() + payload.size(); 
+	
+	// the next delta is from this frame 
+	if( keyframe_interval > 1 )
+	{
+		reference = S; 
+		reference_frame = frames.size() - 1; 
+	}
+	frames_since_keyframe = ( type == PhysiCell_stream_keyframe ? 0 : frames_since_keyframe + 1 ); 
+	return true; 
+}
+
+bool Snapshot_Stream::open_for_reading( std::string filename_in )
+{
+	close(); 
+	filename = filename_in; 
+	frames.clear(); 
+	reference_frame = -1; 
+	
+	fp = fopen( filename.c_str() , "rb" ); 
+	if( fp == NULL )
+	{
+		std::cout << "Error: Failed to open " << filename << " for snapshot stream reading." << std::endl; 
+		return false; 
+	}
+	
+	char magic [8]; 
+	unsigned int marker = 0; 
+	unsigned int version = 0; 
+	bool success = fread( magic , 1 , 8 , fp ) == 8 && memcmp( magic , PhysiCell_stream_magic , 8 ) == 0 
+		&& fread( &marker , 4 , 1 , fp ) == 1 && marker == PhysiCell_snapshot_endian_marker 
+		&& fread( &version , 4 , 1 , fp ) == 1 && version >= 1 && version <= PhysiCell_stream_version; 
+	if( !success )
+	{
+		std::cout << "Error: " << filename << " is not a PhysiCell snapshot stream." << std::endl; 
+		close(); 
+		return false; 
+	}
+	
+	fseek( fp , 0 , SEEK_END ); 
+	long long file_bytes = ftell( fp ); 
+	fseek( fp , 16 , SEEK_SET ); 
+	
+	// step through the frame headers 
+	while( true )
+	{
+		Snapshot_Stream_Frame frame; 
+		char frame_magic [4]; 
+		unsigned int length = 0; 
+		if( fread( frame_magic , 1 , 4 , fp ) != 4 || memcmp( frame_magic , PhysiCell_stream_frame_magic , 4 ) != 0 
+			|| fread( &length , 4 , 1 , fp ) != 1 || length > 65536 )
+		{ break; }
+		frame.name.resize( length ); 
+		unsigned int type = PhysiCell_stream_keyframe; 
+		if( ( length > 0 && fread( &(frame.name[0]) , 1 , length , fp ) != length ) 
+			|| fread( &(frame.time) , 8 , 1 , fp ) != 1 
+			|| ( version > 1 && fread( &type , 4 , 1 , fp ) != 1 ) || fread( &(frame.image_bytes) , 8 , 1 , fp ) != 1 
+			|| fread( &(frame.number_of_chunks) , 4 , 1 , fp ) != 1 || fread( &(frame.payload_bytes) , 8 , 1 , fp ) != 1 )
+		{ break; }
+		frame.type = type; 
+		frame.payload_position = ftell( fp ); 
+		if( frame.payload_bytes > (unsigned long long) ( file_bytes - frame.payload_position ) )
+		{ break; }
+		frames.push_back( frame ); 
+		fseek( fp , frame.payload_position + frame.payload_bytes , SEEK_SET ); 
+	}
+	return true; 
+}
+
+int Snapshot_Stream::find_frame( std::string name )
+{
+	for( unsigned int n=0; n < frames.size(); n++ )
+	{
+		if( frames[n].name == name )
+		{ return n; }
+	}
+	return -1; 
+}
+
+bool Snapshot_Stream::read_frame_image( int n , std::vector<char>& image )
+{
+	if( fp == NULL || writing == true || n < 0 || n >= (int) frames.size() )
+	{ return false; }
+	Snapshot_Stream_Frame& frame = frames[n]; 
+	
+	payload.resize( frame.payload_bytes ); 
+	if( fseek( fp , frame.payload_position , SEEK_SET ) != 0 
+		|| fread( payload.data() , 1 , payload.size() , fp ) != payload.size() )
+	{ return false; }
+	
+	image.assign( frame.image_bytes , 0 ); 
+	size_t position = 0; 
+	for( unsigned int k=0; k < frame.number_of_chunks; k++ )
+	{
+		unsigned long long offset; 
+		unsigned int values [4]; // raw bytes , stored bytes , element size , method 
+		if( payload.size() - position < 24 )
+		{ return false; }
+		memcpy( &offset , payload.data() + position , 8 ); 
+		memcpy( values , payload.data() + position + 8 , 16 ); 
+		position += 24; 
+		
+		size_t bytes = values[0]; 
+		size_t stored = values[1]; 
+		int element_size = values[2]; 
+		if( stored > payload.size() - position || offset > image.size() || bytes > image.size() - offset || element_size < 1 )
+		{ return false; }
+		
+		unsigned char* destination = (unsigned char*) image.data() + offset; 
+		const unsigned char* source = payload.data() + position; 
+		if( values[3] == PhysiCell_stream_stored )
+		{
+			if( stored != bytes )
+			{ return false; }
+			memcpy( destination , source , bytes ); 
+		}
+		else if( values[3] == PhysiCell_stream_compressed )
+		{
+			unsigned char* output = destination; 
+			if( element_size > 1 )
+			{
+				shuffled.resize( bytes ); 
+				output = shuffled.data(); 
+			}
+			if( !decompress_block( source , stored , output , bytes ) )
+			{ return false; }
+			if( element_size > 1 )
+			{ unshuffle_bytes( output , bytes , element_size , destination ); }
+		}
+		else
+		{ return false; }
+		position += stored; 
+	}
+	return true; 
+}
+
+bool Snapshot_Stream::read_frame( int n , Columnar_Snapshot& S )
+{
+	// start from the keyframe before n, or from the last frame read if it 
+	// is on the way (reading the frames in order applies one delta each) 
+	int keyframe = n; 
+	while( keyframe > 0 && keyframe < (int) frames.size() && frames[keyframe].type != PhysiCell_stream_keyframe )
+	{ keyframe--; }
+	
+	std::vector<char> image; 
+	bool success = ( n >= 0 && n < (int) frames.size() && frames[keyframe].type == PhysiCell_stream_keyframe ); 
+	if( success && ( reference_frame < keyframe || reference_frame > n ) )
+	{
+		reference_frame = -1; 
+		success = read_frame_image( keyframe , image ) && reference.read_image( image.data() , image.size() ); 
+		if( success )
+		{ reference_frame = keyframe; }
+	}
+	
+	Columnar_Snapshot next; 
+	while( success && reference_frame < n )
+	{
+		success = read_frame_image( reference_frame + 1 , image ) && delta.read_image( image.data() , image.size() ) 
+			&& apply_snapshot_delta( reference , delta , next ); 
+		if( success )
+		{
+			std::swap( reference , next ); 
+			reference_frame++; 
+		}
+		else
+		{ reference_frame = -1; }
+	}
+	
+	if( !success )
+	{
+		std::cout << "Error: Failed to read frame " << n << " of " << filename << std::endl; 
+		return false; 
+	}
+	S = reference; 
+	return true; 
+}
+
+void Snapshot_Stream::display_information( std::ostream& os )
+{
+	os << "Snapshot stream " << filename << ": " << frames.size() << " frames" << std::endl; 
+	for( unsigned int n=0; n < frames.size(); n++ )
+	{
+		os << "   " << n << ": " << frames[n].name << " (t = " << frames[n].time << "): " 
+			<< ( frames[n].type == PhysiCell_stream_keyframe ? "keyframe, " : "delta, " ) 
+			<< frames[n].image_bytes << " bytes in " << frames[n].payload_bytes << " bytes, " 
+			<< frames[n].number_of_chunks << " chunks" << std::endl; 
+	}
+	return; 
+}
+
+static std::string snapshot_stream_filename( std::string filename_base , std::string& frame_name )
+{
+	size_t slash = filename_base.find_last_of( "/\\" ); 
+	if( slash == std::string::npos )
+	{
+		frame_name = filename_base; 
+		return "snapshots.pcs"; 
+	}
+	frame_name = filename_base.substr( slash + 1 ); 
+	return filename_base.substr( 0 , slash + 1 ) + "snapshots.pcs"; 
+}
+
+// called from the writer thread or the simulation, never both 
+static bool snapshot_stream_append( std::string filename , Columnar_Snapshot& S , std::string frame_name )
+{
+	if( PhysiCell_snapshot_stream.filename != filename )
+	{
+		PhysiCell_snapshot_stream.keyframe_interval = PhysiCell_settings.full_save_keyframe_interval; 
+		// a restarted run continues the stream from its checkpoint 
+		bool success = false; 
+		if( PhysiCell_settings.restart_from.size() > 0 )
+		{ success = PhysiCell_snapshot_stream.open_for_appending( filename , S.current_time - 1e-9 ); }
+		else
+		{ success = PhysiCell_snapshot_stream.open_for_writing( filename ); }
+		if( !success )
+		{ return false; }
+	}
+	return PhysiCell_snapshot_stream.append( S , frame_name ); 
+}
+
+void save_PhysiCell_to_snapshot_stream( std::string filename_base , Microenvironment& M , double current_simulation_time )
+{
+	static Columnar_Snapshot snapshot; 
+	
+	snapshot.capture( M , current_simulation_time ); 
+	
+	std::string frame_name; 
+	std::string filename = snapshot_stream_filename( filename_base , frame_name ); 
+	if( !snapshot_stream_append( filename , snapshot , frame_name ) )
+	{
+		std::cout << std::endl << "Error: We're not writing data like we expect. " << std::endl
+		<< "Check to make sure your save directory exists. " << std::endl << std::endl
+		<< "I'm going to exit with a crash code of -1 now until " << std::endl 
+		<< "you fix your directory. Sorry!" << std::endl << std::endl; 
+		exit(-1); 
+	}
+	return; 
+}
+
+Output_Job::Output_Job()
+{
+	type = PhysiCell_output_snapshot; 
+	filename = ""; 
+	frame_name = ""; 
+	return; 
+}
+
+Background_Writer PhysiCell_background_writer; 
+
+Background_Writer::Background_Writer( int number_of_buffers )
+{
+	jobs.resize( number_of_buffers ); 
+	next_to_fill = 0; 
+	next_to_write = 0; 
+	number_queued = 0; 
+	stopping = false; 
+	failed = false; 
+	
+	wait_time = 0.0; 
+	number_of_waits = 0; 
+	number_of_jobs = 0; 
+	return; 
+}
+
+Background_Writer::~Background_Writer()
+{
+	finish(); 
+	return; 
+}
+
+void Background_Writer::run( void )
+{
+	std::unique_lock<std::mutex> lock( mutex ); 
+	while( true )
+	{
+		while( number_queued == 0 && !stopping )
+		{ job_queued.wait( lock ); }
+		if( number_queued == 0 )
+		{ return; }
+		
+		// write without the lock: the simulation only touches the other buffers 
+		Output_Job& job = jobs[next_to_write]; 
+		lock.unlock(); 
+		
+		bool success = true; 
+		if( job.type == PhysiCell_output_snapshot )
+		{ success = job.snapshot.write( job.filename ); }
+		else if( job.type == PhysiCell_output_stream )
+		{ success = snapshot_stream_append( job.filename , job.snapshot , job.frame_name ); }
+		else
+		{ success = SVG_plot( job.filename , job.SVG ); }
+		
+		lock.lock(); 
+		if( !success )
+		{ failed = true; }
+		next_to_write = ( next_to_write + 1 ) % jobs.size(); 
+		number_queued--; 
+		job_done.notify_all(); 
+	}
+	return; 
+}
+
+Output_Job& Background_Writer::acquire( void )
+{
+	std::unique_lock<std::mutex> lock( mutex ); 
+	
+	// exit without the lock: ~Background_Writer takes it to stop the thread 
+	if( failed )
+	{
+		lock.unlock(); 
+		std::cout << std::endl << "Error: We're not writing data like we expect. " << std::endl
+		<< "Check to make sure your save directory exists. " << std::endl << std::endl
+		<< "I'm going to exit with a crash code of -1 now until " << std::endl 
+		<< "you fix your directory. Sorry!" << std::endl << std::endl; 
+		exit(-1); 
+	}
+	
+	if( !writer_thread.joinable() )
+	{
+		stopping = false; 
+		writer_thread = std::thread( &Background_Writer::run , this ); 
+	}
+	
+	// back-pressure: wait for the writer to free a buffer 
+	if( number_queued == jobs.size() )
+	{
+		auto start = std::chrono::steady_clock::now(); 
+		while( number_queued == jobs.size() )
+		{ job_done.wait( lock ); }
+		wait_time += std::chrono::duration<double>( std::chrono::steady_clock::now() - start ).count(); 
+		number_of_waits++; 
+	}
+	return jobs[next_to_fill]; 
+}
+
+void Background_Writer::submit( void )
+{
+	std::lock_guard<std::mutex> lock( mutex ); 
+	next_to_fill = ( next_to_fill + 1 ) % jobs.size(); 
+	number_queued++; 
+	number_of_jobs++; 
+	job_queued.notify_one(); 
+	return; 
+}
+
+void Background_Writer::save_snapshot( std::string filename_base , Microenvironment& M , double current_simulation_time )
+{
+	Output_Job& job = acquire(); 
+	job.type = PhysiCell_output_snapshot; 
+	job.filename = filename_base + "_snapshot.bin"; 
+	job.snapshot.capture( M , current_simulation_time ); 
+	submit(); 
+	return; 
+}
+
+void Background_Writer::save_to_stream( std::string filename_base , Microenvironment& M , double current_simulation_time )
+{
+	Output_Job& job = acquire(); 
+	job.type = PhysiCell_output_stream; 
+	job.filename = snapshot_stream_filename( filename_base , job.frame_name ); 
+	job.snapshot.capture( M , current_simulation_time ); 
+	submit(); 
+	return; 
+}
+
+void Background_Writer::save_SVG( std::string filename , Microenvironment& M, double z_slice , double time, std::vector<std::string> (*cell_coloring_function)(Cell*) )
+{
+	Output_Job& job = acquire(); 
+	job.type = PhysiCell_output_SVG; 
+	job.filename = filename; 
+	job.SVG.capture( M , z_slice , time , cell_coloring_function ); 
+	submit(); 
+	return; 
+}
+
+void Background_Writer::finish( void )
+{
+	if( !writer_thread.joinable() )
+	{ return; }
+	
+	{
+		std::lock_guard<std::mutex> lock( mutex ); 
+		stopping = true; 
+		job_queued.notify_one(); 
+	}
+	writer_thread.join(); 
+	return; 
+}
+
+void Background_Writer::display_information( std::ostream& os )
+{
+	os << "Background writer: " << number_of_jobs << " saves, " << number_of_waits 
+		<< " waits for a free buffer (" << wait_time << " s in total)" << std::endl; 
+	return; 
+}
+
+void save_PhysiCell_full_data( std::string filename_base , Microenvironment& M , double current_simulation_time )
+{
+	if( PhysiCell_settings.full_save_format == "compressed" )
+	{
+		if( PhysiCell_settings.enable_background_writer == true )
+		{ PhysiCell_background_writer.save_to_stream( filename_base , M , current_simulation_time ); }
+		else
+		{ save_PhysiCell_to_snapshot_stream( filename_base , M , current_simulation_time ); }
+		return; 
+	}
+	
+	if( PhysiCell_settings.full_save_format != "columnar" )
+	{
+		save_PhysiCell_to_MultiCellDS_xml_pugi( filename_base , M , current_simulation_time ); 
+		return; 
+	}
+	
+	if( PhysiCell_settings.enable_background_writer == true )
+	{ PhysiCell_background_writer.save_snapshot( filename_base , M , current_simulation_time ); }
+	else
+	{ save_PhysiCell_to_columnar_snapshot( filename_base , M , current_simulation_time ); }
+	return; 
+}
+
+void save_PhysiCell_SVG( std::string filename , Microenvironment& M, double z_slice , double time, std::vector<std::string> (*cell_coloring_function)(Cell*) )
+{
+	if( PhysiCell_settings.enable_background_writer == true )
+	{ PhysiCell_background_writer.save_SVG( filename , M , z_slice , time , cell_coloring_function ); }
+	else
+	{ SVG_plot( filename , M , z_slice , time , cell_coloring_function ); }
+	return; 
+}
+
+};
@@ -0,0 +1,335 @@
+/*
+###############################################################################
+# If you use PhysiCell in your project, please cite PhysiCell and the version #
+# number, such as below:                                                      #
+#                                                                             #
+# We implemented and solved the model using PhysiCell (Version x.y.z) [1].    #
+#                                                                             #
+# [1] A Ghaffarizadeh, R Heiland, SH Friedman, SM Mumenthaler, and P Macklin, #
+#     PhysiCell: an Open Source Physics-Based Cell Simulator for Multicellu-  #
+#     lar Systems, PLoS Comput. Biol. 14(2): e1005991, 2018                   #
+#     DOI: 10.1371/journal.pcbi.1005991                                       #
+#                                                                             #
+# See VERSION.txt or call get_PhysiCell_version() to get the current version  #
+#     x.y.z. Call display_citations() to get detailed information on all cite-#
+#     able software used in your PhysiCell application.                       #
+#                                                                             #
+# Because PhysiCell extensively uses BioFVM, we suggest you also cite BioFVM  #
+#     as below:                                                               #
+#                                                                             #
+# We implemented and solved the model using PhysiCell (Version x.y.z) [1],    #
+# with BioFVM [2] to solve the transport equations.                           #
+#                                                                             #
+# [1] A Ghaffarizadeh, R Heiland, SH Friedman, SM Mumenthaler, and P Macklin, #
+#     PhysiCell: an Open Source Physics-Based Cell Simulator for Multicellu-  #
+#     lar Systems, PLoS Comput. Biol. 14(2): e1005991, 2018                   #
+#     DOI: 10.1371/journal.pcbi.1005991                                       #
+#                                                                             #
+# [2] A Ghaffarizadeh, SH Friedman, and P Macklin, BioFVM: an efficient para- #
+#     llelized diffusive transport solver for 3-D biological simulations,     #
+#     Bioinformatics 32(8): 1256-8, 2016. DOI: 10.1093/bioinformatics/btv730  #
+#                                                                             #
+###############################################################################
+#                                                                             #
+# BSD 3-Clause License (see https://opensource.org/licenses/BSD-3-Clause)     #
+#                                                                             #
+# Copyright (c) 2015-2018, Paul Macklin and the PhysiCell Project             #
+# All rights reserved.                                                        #
+#                                                                             #
+# Redistribution and use in source and binary forms, with or without          #
+# modification, are permitted provided that the following conditions are met: #
+#                                                                             #
+# 1. Redistributions of source code must retain the above copyright notice,   #
+# this list of conditions and the following disclaimer.                       #
+#                                                                             #
+# 2. Redistributions in binary form must reproduce the above copyright        #
+# notice, this list of conditions and the following disclaimer in the         #
+# documentation and/or other materials provided with the distribution.        #
+#                                                                             #
+# 3. Neither the name of the copyright holder nor the names of its            #
+# contributors may be used to endorse or promote products derived from this   #
+# software without specific prior written permission.                         #
+#                                                                             #
+# THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" #
+# AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE   #
+# IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE  #
+# ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE   #
+# LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR         #
+# CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF        #
+# SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS    #
+# INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN     #
+# CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)     #
+# ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE  #
+# POSSIBILITY OF SUCH DAMAGE.                                                 #
+#                                                                             #
+###############################################################################
+*/
+
+#ifndef __PhysiCell_snapshot_h__
+#define __PhysiCell_snapshot_h__
+
+#include <iostream>
+#include <cstdio>
+#include <string>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+#include "../core/PhysiCell.h"
+#include "./PhysiCell_pathology.h"
+
+namespace PhysiCell{
+
+// Columnar binary snapshots: one contiguous array per field instead of one 
+// record per cell, so that a full save is a handful of large writes. 
+// 
+// File layout (native byte order, checked by the endian marker): 
+//   "PCSNAP01" , uint32 endian marker 0x01020304 , uint32 version , 
+//   double current time , uint32 number of tables , 
+//   then for each table: string name , uint64 rows , uint32 columns , 
+//     and for each column: string name , string units , uint32 type , 
+//     uint32 components , uint64 file offset , uint64 bytes 
+//   then the column data, each starting on an 8-byte boundary. 
+// Strings are a uint32 length followed by the characters. Entry ( row, 
+// component ) of a column is at [ row*components + component ]. 
+
+static const int PhysiCell_snapshot_int32 = 1; 
+static const int PhysiCell_snapshot_float64 = 2; 
+
+class Snapshot_Column
+{
+ private:
+ public:
+	std::string name; 
+	std::string units; 
+	int type; 
+	int components; 
+	
+	std::vector<int> integers; // type PhysiCell_snapshot_int32 
+	std::vector<double> values; // type PhysiCell_snapshot_float64 
+	
+	Snapshot_Column(); 
+	
+	void resize( long rows ); 
+	size_t bytes( void ); 
+	void* data( void ); 
+}; 
+
+class Snapshot_Table
+{
+ private:
+ public:
+	std::string name; 
+	long number_of_rows; 
+	std::vector<Snapshot_Column> columns; 
+	
+	Snapshot_Table(); 
+	
+	// sets column i (adding columns as needed), keeping its storage 
+	Snapshot_Column& set_column( int i , std::string name , std::string units , int type , int components ); 
+	int find_column( std::string name ); // -1 if not found 
+	void resize( long rows ); 
+}; 
+
+class Columnar_Snapshot
+{
+ private:
+ public:
+	double current_time; 
+	std::vector<Snapshot_Table> tables; 
+	
+	Columnar_Snapshot(); 
+	
+	Snapshot_Table& table( std::string name ); // adds it if needed 
+	int find_table( std::string name ); // -1 if not found 
+	
+	// copies the cells (all_cells) and the densities of M into the tables 
+	// "cells" and "microenvironment". The column storage is reused from 
+	// one capture to the next. 
+	void capture( Microenvironment& M , double current_simulation_time ); 
+	
+	// the file image: the header, and the offset of each column (in table 
+	// order) within the file 
+	void layout( std::vector<char>& header , std::vector<unsigned long long>& offsets ); 
+	
+	bool write( std::string filename ); 
+	bool read( std::string filename ); 
+	bool read_image( const char* image , size_t bytes ); // a file image in memory 
+	
+	void display_information( std::ostream& os ); 
+}; 
+
+// writes <filename_base>_snapshot.bin 
+void save_PhysiCell_to_columnar_snapshot( std::string filename_base , Microenvironment& M , double current_simulation_time ); 
+
+// Compressed snapshot streams: each full save is appended as one frame to a 
+// single file. A frame is the image of a columnar snapshot file, cut into 
+// chunks (at most 1 MB) that are byte shuffled by element size and then 
+// compressed independently (see PhysiCell_compression). 
+// 
+// With keyframe_interval N > 1, every Nth frame is a keyframe (the full 
+// snapshot), and the frames in between are deltas from the frame before: 
+// the same tables and columns, where each value is XORed with the previous 
+// value of the same cell (matched by ID) or voxel, and unchanged columns 
+// are left out. Cells that barely moved differ only in their low bytes, and 
+// births (no previous value) are stored as they are; deaths are the IDs 
+// missing from the new ID column. Deltas are lossless: read_frame() 
+// reconstructs any frame from the keyframe before it. 
+// 
+// File layout: 
+//   "PCSTRM01" , uint32 endian marker 0x01020304 , uint32 version , 
+//   then for each frame: "PCFR" , string name , double time , 
+//     uint32 type (0: keyframe, 1: delta; version 2 and up) , 
+//     uint64 image bytes , uint32 chunks , uint64 payload bytes , 
+//     then the payload, chunk by chunk: uint64 offset in the image , 
+//     uint32 raw bytes , uint32 stored bytes , uint32 element size , 
+//     uint32 method (0: stored, 1: compressed) , data 
+// The frame headers give the payload sizes, so a reader steps from frame to 
+// frame without decompressing, and decompresses only the timestep it needs. 
+// A frame cut short (e.g., by a crash during a save) ends the stream. 
+
+static const int PhysiCell_stream_keyframe = 0; 
+static const int PhysiCell_stream_delta = 1; 
+
+// delta = current - previous (as above), or false if the tables of the two 
+// differ in structure (and a keyframe is needed), and the inverse 
+bool make_snapshot_delta( Columnar_Snapshot& previous , Columnar_Snapshot& current , Columnar_Snapshot& delta ); 
+bool apply_snapshot_delta( Columnar_Snapshot& previous , Columnar_Snapshot& delta , Columnar_Snapshot& current ); 
+
+class Snapshot_Stream_Frame
+{
+ private:
+ public:
+	std::string name; // e.g., output00000012 
+	double time; 
+	int type; // PhysiCell_stream_keyframe or PhysiCell_stream_delta 
+	unsigned long long image_bytes; 
+	unsigned int number_of_chunks; 
+	long long payload_position; // in the file 
+	unsigned long long payload_bytes; 
+	
+	Snapshot_Stream_Frame(); 
+}; 
+
+class Snapshot_Stream
+{
+ private:
+	FILE* fp; 
+	bool writing; 
+	
+	// kept between frames 
+	std::vector<char> header; 
+	std::vector<unsigned long long> offsets; 
+	std::vector<unsigned char> shuffled; 
+	std::vector<unsigned char> compressed; 
+	std::vector<unsigned char> payload; 
+	
+	// the last frame written (or reconstructed), and the delta to the next 
+	Columnar_Snapshot reference; 
+	int reference_frame; 
+	Columnar_Snapshot delta; 
+	int frames_since_keyframe; 
+	
+	void add_chunk( const unsigned char* data , size_t bytes , unsigned long long offset , int element_size ); 
+ public:
+	std::string filename; 
+	std::vector<Snapshot_Stream_Frame> frames; 
+	int keyframe_interval; // 1: every frame is a keyframe 
+	
+	unsigned long long image_bytes; // totals over the frames written 
+	unsigned long long stored_bytes; 
+	
+	Snapshot_Stream(); 
+	~Snapshot_Stream(); 
+	
+	bool open_for_writing( std::string filename ); // starts a new stream 
+	// continues a stream, after dropping its frames at time >= before_time 
+	// (e.g., those written after the checkpoint a run resumes from) 
+	bool open_for_appending( std::string filename , double before_time ); 
+	bool append( Columnar_Snapshot& S , std::string name ); 
+	
+	bool open_for_reading( std::string filename ); // reads the frame headers 
+	int find_frame( std::string name ); // -1 if not found 
+	bool read_frame_image( int n , std::vector<char>& image ); // the stored image (a keyframe or a delta) 
+	bool read_frame( int n , Columnar_Snapshot& S ); // the full snapshot 
+	
+	void close( void ); 
+	void display_information( std::ostream& os ); 
+}; 
+
+extern Snapshot_Stream PhysiCell_snapshot_stream; 
+
+// appends the save as frame <name> to <folder>/snapshots.pcs, where 
+// filename_base is <folder>/<name>. The stream is started on the first save. 
+void save_PhysiCell_to_snapshot_stream( std::string filename_base , Microenvironment& M , double current_simulation_time ); 
+
+// The background writer: saves are captured on the calling thread (cheap 
+// copies of the cells and densities), then formatted and written by a 
+// dedicated thread while the simulation continues. The jobs are a ring of 
+// number_of_buffers (default 2: one being written, one being filled). When 
+// the writer falls behind, the next capture waits for a free buffer. 
+
+static const int PhysiCell_output_snapshot = 1; 
+static const int PhysiCell_output_SVG = 2; 
+static const int PhysiCell_output_stream = 3; 
+
+class Output_Job
+{
+ private:
+ public:
+	int type; // PhysiCell_output_snapshot, PhysiCell_output_SVG, or PhysiCell_output_stream 
+	std::string filename; 
+	std::string frame_name; // for PhysiCell_output_stream 
+	Columnar_Snapshot snapshot; 
+	SVG_Snapshot SVG; 
+	
+	Output_Job(); 
+}; 
+
+class Background_Writer
+{
+ private:
+	std::vector<Output_Job> jobs; 
+	unsigned int next_to_fill; 
+	unsigned int next_to_write; 
+	unsigned int number_queued; // including the one being written 
+	bool stopping; 
+	bool failed; 
+	
+	std::thread writer_thread; 
+	std::mutex mutex; 
+	std::condition_variable job_queued; 
+	std::condition_variable job_done; 
+	
+	void run( void ); 
+	Output_Job& acquire( void ); 
+	void submit( void ); 
+ public:
+	double wait_time; // total time spent waiting for a free buffer 
+	int number_of_waits; 
+	int number_of_jobs; 
+	
+	Background_Writer( int number_of_buffers = 2 ); 
+	~Background_Writer(); 
+	
+	void save_snapshot( std::string filename_base , Microenvironment& M , double current_simulation_time ); 
+	void save_to_stream( std::string filename_base , Microenvironment& M , double current_simulation_time ); 
+	void save_SVG( std::string filename , Microenvironment& M, double z_slice , double time, std::vector<std::string> (*cell_coloring_function)(Cell*) ); 
+	
+	// waits until every queued job is written, then stops the thread 
+	void finish( void ); 
+	void display_information( std::ostream& os ); 
+}; 
+
+extern Background_Writer PhysiCell_background_writer; 
+
+// full saves and SVG plots as selected in PhysiCell_settings: MultiCellDS, 
+// columnar, or compressed (a snapshot stream), and in the background (all 
+// but MultiCellDS) or not 
+void save_PhysiCell_full_data( std::string filename_base , Microenvironment& M , double current_simulation_time ); 
+void save_PhysiCell_SVG( std::string filename , Microenvironment& M, double z_slice , double time, std::vector<std::string> (*cell_coloring_function)(Cell*) ); 
+
+};
+
+#endif
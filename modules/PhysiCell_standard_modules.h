@@ -74,6 +74,8 @@
 #include "./PhysiCell_SVG.h"
 #include "./PhysiCell_pathology.h"
 #include "./PhysiCell_MultiCellDS.h"
+#include "./PhysiCell_snapshot.h"
+#include "./PhysiCell_checkpoint.h"
 #include "./PhysiCell_various_outputs.h"
 
 #include "./PhysiCell_pugixml.h"
@@ -163,7 +163,7 @@ void display_simulation_status( std::ostream& os )
 	return;
 }
 
-void log_output(double t, int output_index, Microenvironment microenvironment, std::ofstream& report_file)
+void log_output(double t, int output_index, Microenvironment& microenvironment, std::ofstream& report_file)
 {
 	double scale=1000;
 	int num_new_cells= 0;
@@ -69,6 +69,8 @@
 #include <string>
 #include "PhysiCell_standard_models.h" 
 #include "PhysiCell_cell.h" 
+#include "../../modules/PhysiCell_compression.h"
+#include "../../modules/PhysiCell_snapshot.h"
 
 //using namespace PhysiCell;   // bad practice
 
@@ -96,10 +98,406 @@ int custom_vars1()
     return 1;
 }
 
+// a 800 x 800 x 320 micron mesh (20 micron voxels) with one substrate, 
+// starting from a smooth bump, optionally with Dirichlet nodes on its faces 
+static void setup_amr_test_microenvironment( BioFVM::Microenvironment& M , double diffusion_coefficient , double decay_rate , bool dirichlet )
+{
+    M.set_density( 0 , "substrate" , "dimensionless" , diffusion_coefficient , decay_rate );
+    M.resize_space_uniform( -400 , 400 , -400 , 400 , -160 , 160 , 20 );
+    M.agent_container = new BioFVM::Agent_Container;
+    M.amr_refinement_ratio = 4;
+    M.amr_buffer_distance = 100.0;
+
+    int nx = M.mesh.x_coordinates.size();
+    int ny = M.mesh.y_coordinates.size();
+    int nz = M.mesh.z_coordinates.size();
+    std::vector<double> boundary_value( 1 , 38.0 );
+    for( int n=0; n < M.number_of_voxels(); n++ )
+    {
+        std::vector<double>& center = M.mesh.voxels[n].center;
+        double r2 = center[0]*center[0] + center[1]*center[1] + center[2]*center[2];
+        M.density_vector(n)[0] = 20.0 + 18.0 * exp( -r2 / ( 2.0 * 150.0 * 150.0 ) );
+
+        int i = n % nx;
+        int j = ( n / nx ) % ny;
+        int k = n / ( nx*ny );
+        if( dirichlet && ( i == 0 || i == nx-1 || j == 0 || j == ny-1 || k == 0 || k == nz-1 ) )
+        { M.add_dirichlet_node( n , boundary_value ); }
+    }
+    M.set_substrate_dirichlet_activation( 0 , true );
+    return;
+}
+
+static double total_amount( BioFVM::Microenvironment& M )
+{
+    double total = 0.0;
+    for( int n=0; n < M.number_of_voxels(); n++ )
+    { total += M.density_vector(n)[0] * M.mesh.voxels[n].volume; }
+    return total;
+}
+
+// runs the adaptive mesh refinement solver and the uniform LOD solver side 
+// by side for 30 min, with one agent (so the patch) at the center 
+static void run_amr_test( BioFVM::Microenvironment& amr , BioFVM::Microenvironment& uniform )
+{
+    amr.diffusion_decay_solver = BioFVM::diffusion_decay_solver__adaptive_mesh_refinement;
+    uniform.diffusion_decay_solver = BioFVM::diffusion_decay_solver__constant_coefficients_LOD_3D;
+
+    BioFVM::Basic_Agent* pAgent = BioFVM::create_basic_agent();
+    pAgent->register_microenvironment( &amr );
+    pAgent->assign_position( 10.0 , 10.0 , 10.0 );
+
+    double dt = 0.01;
+    for( int step=0; step < 3000; step++ )
+    {
+        amr.simulate_diffusion_decay( dt );
+        uniform.simulate_diffusion_decay( dt );
+    }
+
+    BioFVM::delete_basic_agent( pAgent->index );
+    return;
+}
+
+// without Dirichlet nodes or decay, the total amount is conserved 
+int amr_conservation()
+{
+    std::cout << "--------------  " << __FUNCTION__ << " -------------- " << std::endl;
+    BioFVM::Microenvironment amr;
+    BioFVM::Microenvironment uniform;
+    setup_amr_test_microenvironment( amr , 1e5 , 0.0 , false );
+    setup_amr_test_microenvironment( uniform , 1e5 , 0.0 , false );
+    double initial = total_amount( amr );
+
+    run_amr_test( amr , uniform );
+
+    double error = fabs( total_amount( amr ) - initial ) / initial;
+    double uniform_error = fabs( total_amount( uniform ) - initial ) / initial;
+    std::cout << "relative change in the total: " << error << " (uniform solver: " << uniform_error << ")" << std::endl;
+    bool passed = ( error < 1e-10 );
+    std::cout << ( passed ? "PASSED" : "FAILED" ) << std::endl;
+    return passed;
+}
+
+// with decay and Dirichlet faces, the field agrees with the uniform solver's: 
+// voxel by voxel near the agent (in the refined patch), and as coarse voxel 
+// averages elsewhere 
+int amr_accuracy()
+{
+    std::cout << "--------------  " << __FUNCTION__ << " -------------- " << std::endl;
+    BioFVM::Microenvironment amr;
+    BioFVM::Microenvironment uniform;
+    setup_amr_test_microenvironment( amr , 1000.0 , 0.1 , true );
+    setup_amr_test_microenvironment( uniform , 1000.0 , 0.1 , true );
+
+    run_amr_test( amr , uniform );
+
+    int ratio = amr.amr_refinement_ratio; // divides 40 x 40 x 16 voxels
+    int size[3] = { (int) amr.mesh.x_coordinates.size() , (int) amr.mesh.y_coordinates.size() , (int) amr.mesh.z_coordinates.size() };
+    int coarse_size[3] = { size[0] / ratio , size[1] / ratio , size[2] / ratio };
+    std::vector<double> coarse_difference( coarse_size[0] * coarse_size[1] * coarse_size[2] , 0.0 );
+    double max_patch_difference = 0.0;
+    double max_value = 0.0;
+    for( int k=0; k < size[2]; k++ )
+    {
+        for( int j=0; j < size[1]; j++ )
+        {
+            for( int i=0; i < size[0]; i++ )
+            {
+                int n = amr.voxel_index( i , j , k );
+                double difference = amr.density_vector(n)[0] - uniform.density_vector(n)[0];
+                coarse_difference[ i / ratio + coarse_size[0]*( j / ratio + coarse_size[1]*( k / ratio ) ) ]
+                    += difference / ( ratio * ratio * ratio );
+                std::vector<double>& center = amr.mesh.voxels[n].center;
+                double r2 = 0.0;
+                for( int d=0; d < 3; d++ )
+                { r2 += ( center[d] - 10.0 ) * ( center[d] - 10.0 ); }
+                if( r2 <= amr.amr_buffer_distance * amr.amr_buffer_distance )
+                { max_patch_difference = std::max( max_patch_difference , fabs( difference ) ); }
+                max_value = std::max( max_value , fabs( uniform.density_vector(n)[0] ) );
+            }
+        }
+    }
+    double max_coarse_difference = 0.0;
+    for( unsigned int c=0; c < coarse_difference.size(); c++ )
+    { max_coarse_difference = std::max( max_coarse_difference , fabs( coarse_difference[c] ) ); }
+    double total_difference = fabs( total_amount( amr ) - total_amount( uniform ) ) / total_amount( uniform );
+    std::cout << "largest difference near the agent: " << max_patch_difference << " (largest value: " << max_value << ")" << std::endl;
+    std::cout << "largest difference of coarse voxel averages: " << max_coarse_difference << std::endl;
+    std::cout << "relative difference in the total: " << total_difference << std::endl;
+    bool passed = ( max_patch_difference < 0.01 * max_value && max_coarse_difference < 0.02 * max_value
+        && total_difference < 0.01 );
+    std::cout << ( passed ? "PASSED" : "FAILED" ) << std::endl;
+    return passed;
+}
+
+// test blocks for the codec: empty, tiny, all literals (random), long runs, 
+// and a smooth field of doubles (byte shuffled, as in the snapshot streams) 
+static std::vector< std::vector<unsigned char> > compression_test_blocks( void )
+{
+    std::vector< std::vector<unsigned char> > blocks;
+    blocks.push_back( std::vector<unsigned char>() );
+    blocks.push_back( std::vector<unsigned char>( 1 , 42 ) );
+    blocks.push_back( std::vector<unsigned char>( 9 , 7 ) );
+
+    std::vector<unsigned char> random( 5000 );
+    unsigned int state = 12345;
+    for( unsigned int i=0; i < random.size(); i++ )
+    {
+        state = state * 1664525u + 1013904223u;
+        random[i] = (unsigned char) ( state >> 24 );
+    }
+    blocks.push_back( random );
+
+    std::vector<unsigned char> runs( 100000 );
+    for( unsigned int i=0; i < runs.size(); i++ )
+    { runs[i] = (unsigned char) ( ( i / 300 ) % 5 ); }
+    blocks.push_back( runs );
+
+    std::vector<double> field( 20000 );
+    for( unsigned int i=0; i < field.size(); i++ )
+    { field[i] = 20.0 + 18.0 * exp( -0.001 * i ); }
+    std::vector<unsigned char> shuffled( field.size() * sizeof(double) );
+    PhysiCell::shuffle_bytes( (const unsigned char*) field.data() , shuffled.size() , sizeof(double) , shuffled.data() );
+    blocks.push_back( shuffled );
+    return blocks;
+}
+
+// compress_block / decompress_block: every block comes back exactly, and 
+// compressible blocks shrink 
+int compression_round_trip()
+{
+    std::cout << "--------------  " << __FUNCTION__ << " -------------- " << std::endl;
+    std::vector< std::vector<unsigned char> > blocks = compression_test_blocks();
+    bool passed = true;
+    for( unsigned int b=0; b < blocks.size(); b++ )
+    {
+        std::vector<unsigned char>& input = blocks[b];
+        std::vector<unsigned char> compressed;
+        PhysiCell::compress_block( input.data() , input.size() , compressed );
+        std::vector<unsigned char> output( input.size() + 1 , 0 );
+        bool decoded = PhysiCell::decompress_block( compressed.data() , compressed.size() , output.data() , input.size() );
+        output.resize( input.size() );
+        std::cout << input.size() << " bytes -> " << compressed.size() << std::endl;
+        passed = passed && decoded && output == input;
+    }
+    // runs of 300 bytes, and the smooth field 
+    std::vector<unsigned char> compressed;
+    PhysiCell::compress_block( blocks[4].data() , blocks[4].size() , compressed );
+    passed = passed && compressed.size() < blocks[4].size() / 20;
+    compressed.clear();
+    PhysiCell::compress_block( blocks[5].data() , blocks[5].size() , compressed );
+    passed = passed && compressed.size() < blocks[5].size() * 3 / 4;
+    std::cout << ( passed ? "PASSED" : "FAILED" ) << std::endl;
+    return passed;
+}
+
+// damaged blocks are rejected (or decode to something else) without 
+// writing past the output: every truncation must fail, as must the wrong 
+// output size; for corrupted bytes, only the guard bytes after the output 
+// are checked 
+int compression_damaged_input()
+{
+    std::cout << "--------------  " << __FUNCTION__ << " -------------- " << std::endl;
+    std::vector< std::vector<unsigned char> > blocks = compression_test_blocks();
+    const int guard = 64;
+    bool passed = true;
+    int truncations = 0;
+    int corruptions = 0;
+    int rejected = 0;
+    for( unsigned int b=1; b < blocks.size(); b++ )
+    {
+        std::vector<unsigned char>& input = blocks[b];
+        std::vector<unsigned char> compressed;
+        PhysiCell::compress_block( input.data() , input.size() , compressed );
+        std::vector<unsigned char> output( input.size() + guard , 0xA5 );
+
+        int step = std::max( 1 , (int) compressed.size() / 200 );
+        for( unsigned int length=0; length < compressed.size(); length += step )
+        {
+            bool decoded = PhysiCell::decompress_block( compressed.data() , length , output.data() , input.size() );
+            passed = passed && !decoded;
+            truncations++;
+        }
+        passed = passed && !PhysiCell::decompress_block( compressed.data() , compressed.size() , output.data() , input.size() - 1 );
+        passed = passed && !PhysiCell::decompress_block( compressed.data() , compressed.size() , output.data() , input.size() + 1 );
+
+        unsigned int state = 777 + b;
+        for( int trial=0; trial < 2000; trial++ )
+        {
+            std::vector<unsigned char> damaged = compressed;
+            for( int flip=0; flip < 1 + trial % 3; flip++ )
+            {
+                state = state * 1664525u + 1013904223u;
+                damaged[ ( state >> 8 ) % damaged.size() ] ^= (unsigned char) ( 1 + ( state >> 24 ) % 255 );
+            }
+            std::fill( output.begin() + input.size() , output.end() , 0xA5 );
+            if( !PhysiCell::decompress_block( damaged.data() , damaged.size() , output.data() , input.size() ) )
+            { rejected++; }
+            for( int g=0; g < guard; g++ )
+            { passed = passed && output[ input.size() + g ] == 0xA5; }
+            corruptions++;
+        }
+    }
+    std::cout << truncations << " truncated blocks, " << corruptions << " corrupted blocks (" << rejected << " rejected)" << std::endl;
+    std::cout << ( passed ? "PASSED" : "FAILED" ) << std::endl;
+    return passed;
+}
+
+// a "cells" table (keyed by ID) whose positions move with time and whose 
+// volumes do not, and a "microenvironment" table (row by row) where only 
+// the oxygen changes 
+static PhysiCell::Columnar_Snapshot delta_test_snapshot( std::vector<int>& IDs , double time )
+{
+    PhysiCell::Columnar_Snapshot S;
+    S.current_time = time;
+    PhysiCell::Snapshot_Table& cells = S.table( "cells" );
+    cells.resize( IDs.size() );
+    cells.set_column( 0 , "ID" , "none" , PhysiCell::PhysiCell_snapshot_int32 , 1 );
+    cells.set_column( 1 , "position" , "micron" , PhysiCell::PhysiCell_snapshot_float64 , 3 );
+    cells.set_column( 2 , "volume" , "cubic micron" , PhysiCell::PhysiCell_snapshot_float64 , 1 );
+    for( unsigned int i=0; i < IDs.size(); i++ )
+    {
+        cells.columns[0].integers[i] = IDs[i];
+        for( int k=0; k < 3; k++ )
+        { cells.columns[1].values[3*i+k] = 10.0*IDs[i] + 0.01*time*(k+1); }
+        cells.columns[2].values[i] = 2494.0 + IDs[i];
+    }
+
+    PhysiCell::Snapshot_Table& microenvironment = S.table( "microenvironment" );
+    microenvironment.resize( 100 );
+    microenvironment.set_column( 0 , "oxygen" , "mmHg" , PhysiCell::PhysiCell_snapshot_float64 , 1 );
+    microenvironment.set_column( 1 , "drug" , "dimensionless" , PhysiCell::PhysiCell_snapshot_float64 , 1 );
+    for( int n=0; n < 100; n++ )
+    {
+        microenvironment.columns[0].values[n] = 38.0 - 0.1*n - ( n < 50 ? 0.001*time : 0.0 );
+        microenvironment.columns[1].values[n] = 0.5*n;
+    }
+    return S;
+}
+
+static bool same_snapshots( PhysiCell::Columnar_Snapshot& A , PhysiCell::Columnar_Snapshot& B )
+{
+    if( A.current_time != B.current_time || A.tables.size() != B.tables.size() )
+    { return false; }
+    for( unsigned int t=0; t < A.tables.size(); t++ )
+    {
+        PhysiCell::Snapshot_Table& a = A.tables[t];
+        PhysiCell::Snapshot_Table& b = B.tables[t];
+        if( a.name != b.name || a.number_of_rows != b.number_of_rows || a.columns.size() != b.columns.size() )
+        { return false; }
+        for( unsigned int c=0; c < a.columns.size(); c++ )
+        {
+            if( a.columns[c].name != b.columns[c].name || a.columns[c].bytes() != b.columns[c].bytes()
+                || memcmp( a.columns[c].data() , b.columns[c].data() , a.columns[c].bytes() ) != 0 )
+            { return false; }
+        }
+    }
+    return true;
+}
+
+// make_snapshot_delta / apply_snapshot_delta: deaths, births and a new 
+// order come back exactly, and deltas that do not fit the previous frame 
+// (or are cut short) are rejected 
+int snapshot_delta_round_trip()
+{
+    std::cout << "--------------  " << __FUNCTION__ << " -------------- " << std::endl;
+    std::vector<int> previous_IDs;
+    for( int i=0; i < 100; i++ )
+    { previous_IDs.push_back( i ); }
+    std::vector<int> current_IDs;
+    for( int i=99; i >= 0; i-- )
+    {
+        if( i != 3 && i != 17 && i != 50 )
+        { current_IDs.push_back( i ); }
+    }
+    current_IDs.push_back( 100 );
+    current_IDs.push_back( 101 );
+
+    PhysiCell::Columnar_Snapshot previous = delta_test_snapshot( previous_IDs , 60.0 );
+    PhysiCell::Columnar_Snapshot current = delta_test_snapshot( current_IDs , 66.0 );
+    PhysiCell::Columnar_Snapshot delta;
+    PhysiCell::Columnar_Snapshot reconstructed;
+    bool passed = PhysiCell::make_snapshot_delta( previous , current , delta );
+    passed = passed && delta.tables[1].find_column( "drug" ) < 0; // unchanged, so left out
+    passed = passed && PhysiCell::apply_snapshot_delta( previous , delta , reconstructed );
+    passed = passed && same_snapshots( reconstructed , current );
+    std::cout << "round trip: " << ( passed ? "exact" : "wrong" ) << std::endl;
+
+    std::vector<PhysiCell::Columnar_Snapshot> damaged( 8 , delta );
+    damaged[0].tables.pop_back();
+    damaged[1].tables[0].name = "other";
+    damaged[2].tables[1].resize( 101 );
+    damaged[3].tables[0].columns[1].components = 2;
+    damaged[4].tables[0].columns[1].name = "nonexistent";
+    damaged[5].tables[0].columns[1].values.resize( 50 );
+    damaged[6].tables[1].columns[0].values.clear();
+    damaged[7].tables[0].number_of_rows = -1;
+    int rejected = 0;
+    for( unsigned int n=0; n < damaged.size(); n++ )
+    {
+        if( !PhysiCell::apply_snapshot_delta( previous , damaged[n] , reconstructed ) )
+        { rejected++; }
+    }
+    PhysiCell::Columnar_Snapshot damaged_previous = previous;
+    damaged_previous.tables[0].columns[0].integers.resize( 10 );
+    if( !PhysiCell::apply_snapshot_delta( damaged_previous , delta , reconstructed ) )
+    { rejected++; }
+    std::cout << rejected << " of 9 damaged deltas rejected" << std::endl;
+    passed = passed && rejected == 9;
+    std::cout << ( passed ? "PASSED" : "FAILED" ) << std::endl;
+    return passed;
+}
+
+// Random_Stream against the Philox4x32-10 known-answer vectors of Random123 
+// (Salmon et al., SC '11): counter ( draw , stream_id , stream_type ) and 
+// key ( seed ) 
+int philox_known_answers()
+{
+    std::cout << "--------------  " << __FUNCTION__ << " -------------- " << std::endl;
+    static const unsigned int vectors [3][10] = {
+        { 0x00000000 , 0x00000000 , 0x00000000 , 0x00000000 , 0x00000000 , 0x00000000 ,
+          0x6627e8d5 , 0xe169c58d , 0xbc57ac4c , 0x9b00dbd8 } ,
+        { 0xffffffff , 0xffffffff , 0xffffffff , 0xffffffff , 0xffffffff , 0xffffffff ,
+          0x408f276d , 0x41c83b0e , 0xa20bc7c6 , 0x6d5451fd } ,
+        { 0x243f6a88 , 0x85a308d3 , 0x13198a2e , 0x03707344 , 0xa4093822 , 0x299f31d0 ,
+          0xd16cfe09 , 0x94fdcceb , 0x5001e420 , 0x24126ea1 } };
+    unsigned long long seed = PhysiCell::get_random_seed();
+    bool passed = true;
+    for( int v=0; v < 3; v++ )
+    {
+        const unsigned int* V = vectors[v];
+        PhysiCell::SeedRandom( (long) ( ( (unsigned long long) V[5] << 32 ) | V[4] ) );
+        PhysiCell::Random_Stream stream( V[2] , V[3] );
+        stream.counter = ( (unsigned long long) V[1] << 32 ) | V[0];
+        unsigned int block [4];
+        stream.next_block( block );
+        bool match = block[0] == V[6] && block[1] == V[7] && block[2] == V[8] && block[3] == V[9];
+        std::cout << "vector " << v << ( match ? ": match" : ": MISMATCH" ) << std::endl;
+        passed = passed && match;
+    }
+    PhysiCell::SeedRandom( (long) seed );
+    std::cout << ( passed ? "PASSED" : "FAILED" ) << std::endl;
+    return passed;
+}
+
 int main()
 {
     std::cout << ">>>>>>>>>  Unit tests" << std::endl;
     custom_vars1();
 
-    return 1;
+    int failures = 0;
+    if( !amr_conservation() )
+    { failures++; }
+    if( !amr_accuracy() )
+    { failures++; }
+    if( !compression_round_trip() )
+    { failures++; }
+    if( !compression_damaged_input() )
+    { failures++; }
+    if( !snapshot_delta_round_trip() )
+    { failures++; }
+    if( !philox_known_answers() )
+    { failures++; }
+
+    return failures;
 }
\ No newline at end of file
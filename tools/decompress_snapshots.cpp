@@ -0,0 +1,202 @@
+/*
+###############################################################################
+# If you use PhysiCell in your project, please cite PhysiCell and the version #
+# number, such as below:                                                      #
+#                                                                             #
+# We implemented and solved the model using PhysiCell (Version x.y.z) [1].    #
+#                                                                             #
+# [1] A Ghaffarizadeh, R Heiland, SH Friedman, SM Mumenthaler, and P Macklin, #
+#     PhysiCell: an Open Source Physics-Based Cell Simulator for Multicellu-  #
+#     lar Systems, PLoS Comput. Biol. 14(2): e1005991, 2018                   #
+#     DOI: 10.1371/journal.pcbi.1005991                                       #
+#                                                                             #
+# See VERSION.txt or call get_PhysiCell_version() to get the current version  #
+#     x.y.z. Call display_citations() to get detailed information on all cite-#
+#     able software used in your PhysiCell application.                       #
+#                                                                             #
+# Because PhysiCell extensively uses BioFVM, we suggest you also cite BioFVM  #
+#     as below:                                                               #
+#                                                                             #
+# We implemented and solved the model using PhysiCell (Version x.y.z) [1],    #
+# with BioFVM [2] to solve the transport equations.                           #
+#                                                                             #
+# [1] A Ghaffarizadeh, R Heiland, SH Friedman, SM Mumenthaler, and P Macklin, #
+#     PhysiCell: an Open Source Physics-Based Cell Simulator for Multicellu-  #
+#     lar Systems, PLoS Comput. Biol. 14(2): e1005991, 2018                   #
+#     DOI: 10.1371/journal.pcbi.1005991                                       #
+#                                                                             #
+# [2] A Ghaffarizadeh, SH Friedman, and P Macklin, BioFVM: an efficient para- #
+#     llelized diffusive transport solver for 3-D biological simulations,     #
+#     Bioinformatics 32(8): 1256-8, 2016. DOI: 10.1093/bioinformatics/btv730  #
+#                                                                             #
+###############################################################################
+#                                                                             #
+# BSD 3-Clause License (see https://opensource.org/licenses/BSD-3-Clause)     #
+#                                                                             #
+# Copyright (c) 2015-2018, Paul Macklin and the PhysiCell Project             #
+# All rights reserved.                                                        #
+#                                                                             #
+# Redistribution and use in source and binary forms, with or without          #
+# modification, are permitted provided that the following conditions are met: #
+#                                                                             #
+# 1. Redistributions of source code must retain the above copyright notice,   #
+# this list of conditions and the following disclaimer.                       #
+#                                                                             #
+# 2. Redistributions in binary form must reproduce the above copyright        #
+# notice, this list of conditions and the following disclaimer in the         #
+# documentation and/or other materials provided with the distribution.        #
+#                                                                             #
+# 3. Neither the name of the copyright holder nor the names of its            #
+# contributors may be used to endorse or promote products derived from this   #
+# software without specific prior written permission.                         #
+#                                                                             #
+# THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" #
+# AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE   #
+# IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE  #
+# ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE   #
+# LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR         #
+# CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF        #
+# SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS    #
+# INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN     #
+# CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)     #
+# ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE  #
+# POSSIBILITY OF SUCH DAMAGE.                                                 #
+#                                                                             #
+###############################################################################
+*/
+
+// decompress_snapshots: extracts frames of a compressed snapshot stream 
+// (<folder>/snapshots.pcs, written with <full_data><format>compressed</format>). 
+// 
+//   decompress_snapshots <stream>                    lists the frames 
+//   decompress_snapshots <stream> <frame> [...]      extracts the frames 
+// 
+// where each <frame> is a name (e.g., output00000012 or final), an index, or 
+// "all". Frame <name> is written next to the stream as 
+//   <name>_snapshot.bin                (read_PhysiCell_snapshot.m) 
+//   <name>_microenvironment0.mat       (read_microenvironment.m) 
+//   <name>_cells_physicell.mat         (the layout of the MultiCellDS saves) 
+
+#include <iostream>
+#include <string>
+#include <cstdlib>
+
+#include "../modules/PhysiCell_snapshot.h"
+
+using namespace BioFVM; 
+using namespace PhysiCell; 
+
+// writes every column of table T (as doubles, one column of the matrix per 
+// row of the table); the reserved column of the cell data follows 
+// persistence_time, as in the MultiCellDS saves 
+bool write_table_to_matlab( Snapshot_Table& T , std::string filename , std::string variable_name )
+{
+	int size_of_each_datum = 0; 
+	for( unsigned int c=0; c < T.columns.size(); c++ )
+	{
+		size_of_each_datum += T.columns[c].components; 
+		if( variable_name == "cells" && T.columns[c].name == "persistence_time" )
+		{ size_of_each_datum++; }
+	}
+	
+	FILE* fp = write_matlab_header( size_of_each_datum , T.number_of_rows , filename , variable_name ); 
+	if( fp == NULL )
+	{
+		std::cout << "Error: Failed to open " << filename << " for MAT writing." << std::endl; 
+		return false; 
+	}
+	
+	std::vector<double> datum( size_of_each_datum , 0.0 ); 
+	bool success = true; 
+	for( long i=0; i < T.number_of_rows; i++ )
+	{
+		int n = 0; 
+		for( unsigned int c=0; c < T.columns.size(); c++ )
+		{
+			Snapshot_Column& C = T.columns[c]; 
+			for( int k=0; k < C.components; k++ )
+			{
+				if( C.type == PhysiCell_snapshot_int32 )
+				{ datum[n] = C.integers[i*C.components+k]; }
+				else
+				{ datum[n] = C.values[i*C.components+k]; }
+				n++; 
+			}
+			if( variable_name == "cells" && C.name == "persistence_time" )
+			{ datum[n++] = 0.0; }
+		}
+		success = success && ( fwrite( datum.data() , sizeof(double) , datum.size() , fp ) == datum.size() ); 
+	}
+	
+	success = ( fclose( fp ) == 0 ) && success; 
+	return success; 
+}
+
+bool extract_frame( Snapshot_Stream& stream , int n , std::string folder )
+{
+	Columnar_Snapshot snapshot; 
+	if( !stream.read_frame( n , snapshot ) )
+	{ return false; }
+	
+	std::string filename_base = folder + stream.frames[n].name; 
+	bool success = snapshot.write( filename_base + "_snapshot.bin" ); 
+	
+	int t = snapshot.find_table( "microenvironment" ); 
+	if( t > -1 )
+	{ success = write_table_to_matlab( snapshot.tables[t] , filename_base + "_microenvironment0.mat" , "multiscale_microenvironment" ) && success; }
+	t = snapshot.find_table( "cells" ); 
+	if( t > -1 && snapshot.tables[t].number_of_rows > 0 )
+	{ success = write_table_to_matlab( snapshot.tables[t] , filename_base + "_cells_physicell.mat" , "cells" ) && success; }
+	
+	std::cout << stream.frames[n].name << " (t = " << snapshot.current_time << ")" 
+		<< ( success ? "" : ": failed" ) << std::endl; 
+	return success; 
+}
+
+int main( int argc , char* argv[] )
+{
+	if( argc < 2 )
+	{
+		std::cout << "Usage: " << argv[0] << " <stream> [ all | <frame name> | <frame index> ... ]" << std::endl; 
+		return -1; 
+	}
+	
+	Snapshot_Stream stream; 
+	if( !stream.open_for_reading( argv[1] ) )
+	{ return -1; }
+	
+	if( argc == 2 )
+	{
+		stream.display_information( std::cout ); 
+		return 0; 
+	}
+	
+	std::string folder = argv[1]; 
+	size_t slash = folder.find_last_of( "/\\" ); 
+	folder = ( slash == std::string::npos ? "" : folder.substr( 0 , slash + 1 ) ); 
+	
+	bool success = true; 
+	for( int i=2; i < argc; i++ )
+	{
+		std::string frame = argv[i]; 
+		if( frame == "all" )
+		{
+			for( unsigned int n=0; n < stream.frames.size(); n++ )
+			{ success = extract_frame( stream , n , folder ) && success; }
+			continue; 
+		}
+		
+		int n = stream.find_frame( frame ); 
+		if( n < 0 && frame.find_first_not_of( "0123456789" ) == std::string::npos )
+		{ n = atoi( frame.c_str() ); }
+		if( n < 0 || n >= (int) stream.frames.size() )
+		{
+			std::cout << "Error: " << frame << " is not a frame of " << argv[1] << std::endl; 
+			success = false; 
+			continue; 
+		}
+		success = extract_frame( stream , n , folder ) && success; 
+	}
+	
+	return success ? 0 : -1; 
+}
@@ -316,7 +316,7 @@ std::vector<double> integrate_total_substrates( void )
 	for( unsigned int n=0; n < (*all_cells).size(); n++ )
 	{
 		Cell* pC = (*all_cells)[n];
-		out += pC->phenotype.molecular.internalized_substrates;
+		out += pC->phenotype.molecular.internalized_total_substrates; 
 	}
 	
 	return out; 
@@ -165,6 +165,10 @@ int main( int argc, char* argv[] )
 	std::cout << "Unit test: conservation with individual agent substrate internalization " << std::endl 
 		<< "If this works, the total amount of each substrate should stay fixed at each output " << std::endl << std::endl ; 
 	
+	// substrates without decay should be conserved exactly; track how far they drift
+	std::vector<double> initial_totals = integrate_total_substrates(); 
+	std::vector<double> largest_relative_change( initial_totals.size() , 0.0 ); 
+	
 	try 
 	{		
 		while( PhysiCell_globals.current_time < PhysiCell_settings.max_time + 0.1*diffusion_dt )
@@ -201,7 +205,16 @@ int main( int argc, char* argv[] )
 					PhysiCell_globals.next_SVG_save_time  += PhysiCell_settings.SVG_save_interval;
 				}
 				
-				std::cout << "Total substrates " << integrate_total_substrates() << std::endl; 
+				std::vector<double> totals = integrate_total_substrates(); 
+				std::cout << "Total substrates " << totals << std::endl; 
+				for( unsigned int i=0; i < totals.size(); i++ )
+				{
+					if( initial_totals[i] != 0.0 )
+					{
+						double relative_change = fabs( totals[i] - initial_totals[i] ) / fabs( initial_totals[i] ); 
+						largest_relative_change[i] = std::max( largest_relative_change[i] , relative_change ); 
+					}
+				}
 			}
 
 			// update the microenvironment
@@ -236,6 +249,15 @@ int main( int argc, char* argv[] )
 	sprintf( filename , "%s/final.svg" , PhysiCell_settings.folder.c_str() ); 
 	SVG_plot( filename , microenvironment, 0.0 , PhysiCell_globals.current_time, cell_coloring_function );
 	
+	// conservation report
+	
+	std::cout << std::endl << "Largest relative change in the total of each conserved substrate: " << std::endl; 
+	for( unsigned int i=0; i < largest_relative_change.size(); i++ )
+	{
+		if( microenvironment.decay_rates[i] == 0.0 )
+		{ std::cout << "\t" << microenvironment.density_names[i] << ": " << largest_relative_change[i] << std::endl; }
+	}
+	
 	// timer 
 	
 	std::cout << std::endl << "Total simulation runtime: " << std::endl; 